@@ -0,0 +1,118 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       bench_camera.cpp
+/// \brief      Microbenchmarks for camera models and rotation conversions.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "bench_common.h"
+
+#include <benchmark/benchmark.h>
+
+enum { MODEL_RECTILINEAR, MODEL_FISHEYE, MODEL_EQUIAREA };
+
+///
+/// Camera models as used by FicTrac (source camera, ROI, and sphere map respectively).
+///
+static CameraModelPtr makeModel(int type, int w)
+{
+    switch (type) {
+    case MODEL_RECTILINEAR:
+        return CameraModel::createRectilinear(w, w * 3 / 4, 45 * CM_D2R);
+    case MODEL_FISHEYE:
+        return CameraModel::createFisheye(w, w, 0.5 / w, 0.5);
+    case MODEL_EQUIAREA:
+    default:
+        return CameraModel::createEquiArea(w, w / 2, CM_PI_2, -CM_PI, CM_PI, -2 * CM_PI);
+    }
+}
+
+static const char* modelName(int type)
+{
+    static const char* names[] = { "rectilinear", "fisheye", "equiarea" };
+    return names[type];
+}
+
+///
+/// CameraModel::pixelToVector over the full image. Args: model, image width.
+///
+static void BM_PixelToVector(benchmark::State& state)
+{
+    CameraModelPtr model = makeModel(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+    const int w = model->width(), h = model->height();
+    double v[3];
+    for (auto _ : state) {
+        for (int i = 0; i < h; i++) {
+            for (int j = 0; j < w; j++) {
+                benchmark::DoNotOptimize(model->pixelToVector(j + 0.5, i + 0.5, v));
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * w * h);
+    state.SetLabel(modelName(static_cast<int>(state.range(0))));
+}
+BENCHMARK(BM_PixelToVector)->ArgsProduct({ { MODEL_RECTILINEAR, MODEL_FISHEYE, MODEL_EQUIAREA }, { 60, 360 } });
+
+///
+/// CameraModel::vectorToPixel for the view vectors of every pixel. Args: model, image width.
+///
+static void BM_VectorToPixel(benchmark::State& state)
+{
+    CameraModelPtr model = makeModel(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+    const int w = model->width(), h = model->height();
+    std::vector<double> vecs;
+    for (int i = 0; i < h; i++) {
+        for (int j = 0; j < w; j++) {
+            double v[3];
+            if (model->pixelToVector(j + 0.5, i + 0.5, v)) { vecs.insert(vecs.end(), v, v + 3); }
+        }
+    }
+    double x, y;
+    for (auto _ : state) {
+        for (size_t k = 0; k < vecs.size(); k += 3) {
+            benchmark::DoNotOptimize(model->vectorToPixel(&vecs[k], x, y));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * (vecs.size() / 3));
+    state.SetLabel(modelName(static_cast<int>(state.range(0))));
+}
+BENCHMARK(BM_VectorToPixel)->ArgsProduct({ { MODEL_RECTILINEAR, MODEL_FISHEYE, MODEL_EQUIAREA }, { 60, 360 } });
+
+///
+/// CmPoint64f::omegaToMatrix (cv::Mat_ result, as used per frame by Trackball).
+///
+static void BM_OmegaToMatrix(benchmark::State& state)
+{
+    CmPoint64f w(0.01, -0.02, 0.03);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CmPoint64f::omegaToMatrix(w));
+        w[0] += 1e-6;
+    }
+}
+BENCHMARK(BM_OmegaToMatrix);
+
+///
+/// CmPoint64f::omegaToMatrix into a raw array (as used per evaluation by Localiser).
+///
+static void BM_OmegaToMatrixRaw(benchmark::State& state)
+{
+    CmPoint64f w(0.01, -0.02, 0.03);
+    double R[9];
+    for (auto _ : state) {
+        w.omegaToMatrix(R);
+        benchmark::DoNotOptimize(R);
+        w[0] += 1e-6;
+    }
+}
+BENCHMARK(BM_OmegaToMatrixRaw);
+
+///
+/// CmPoint64f::matrixToOmega.
+///
+static void BM_MatrixToOmega(benchmark::State& state)
+{
+    cv::Mat_<double> R = CmPoint64f::omegaToMatrix(CmPoint64f(0.3, -0.2, 0.1));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CmPoint64f::matrixToOmega(R));
+    }
+}
+BENCHMARK(BM_MatrixToOmega);
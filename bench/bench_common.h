@@ -0,0 +1,104 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       bench_common.h
+/// \brief      Shared fixtures for the kernel microbenchmarks.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include "CameraModel.h"
+#include "CmPoint.h"
+#include "geometry.h"
+#include "typesvars.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <memory>   // shared_ptr
+#include <random>
+#include <vector>
+
+///
+/// Random image with blob-like structure, similar to a (remapped) view of the ball.
+///
+static cv::Mat randomImage(int w, int h, unsigned int seed = 0)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> u(0, 255);
+    cv::Mat img(h, w, CV_8UC1);
+    for (int i = 0; i < h; i++) {
+        uint8_t* p = img.ptr(i);
+        for (int j = 0; j < w; j++) { p[j] = static_cast<uint8_t>(u(rng)); }
+    }
+    int k = (std::max(3, w / 20)) | 0x01;
+    cv::GaussianBlur(img, img, cv::Size(k, k), 0);
+    return img;
+}
+
+///
+/// ROI, sphere map and view ray LUT set up the same way as Trackball, for an roi_w x roi_w ROI (roi_w = 10 * q_factor).
+///
+struct RoiFixture
+{
+    int roi_w, map_w, map_h;
+    double r_d_ratio;
+    CameraModelPtr roi_model, sphere_model;
+    cv::Mat roi_mask, roi_frame, sphere_map, R_roi;
+    std::shared_ptr<std::vector<double>> p1s_lut;
+
+    RoiFixture(int w, double sphere_rad = 0.25, unsigned int seed = 0)
+        : roi_w(w)
+    {
+        map_h = static_cast<int>(1.5 * roi_w);
+        map_w = 2 * map_h;
+        r_d_ratio = sin(sphere_rad);
+
+        roi_model = CameraModel::createFisheye(roi_w, roi_w, sphere_rad * 2.0 / roi_w, sphere_rad * 2.0);
+        sphere_model = CameraModel::createEquiArea(map_w, map_h, CM_PI_2, -CM_PI, CM_PI, -2 * CM_PI);
+
+        /// View rays and mask.
+        roi_mask.create(roi_w, roi_w, CV_8UC1);
+        roi_mask.setTo(cv::Scalar::all(255));
+        p1s_lut = std::make_shared<std::vector<double>>(roi_w * roi_w * 3, 0);
+        for (int i = 0; i < roi_w; i++) {
+            uint8_t* pmask = roi_mask.ptr(i);
+            for (int j = 0; j < roi_w; j++) {
+                double l[3] = { 0, 0, 0 };
+                roi_model->pixelIndexToVector(j, i, l);
+                vec3normalise(l);
+                double* s = &(*p1s_lut)[(i * roi_w + j) * 3];
+                if (!intersectSphere(r_d_ratio, l, s)) { pmask[j] = 128; }
+            }
+        }
+
+        /// Thresholded ROI frame and a partially explored sphere map.
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> u(0, 3);
+        roi_frame.create(roi_w, roi_w, CV_8UC1);
+        for (int i = 0; i < roi_w; i++) {
+            uint8_t* p = roi_frame.ptr(i);
+            const uint8_t* pmask = roi_mask.ptr(i);
+            for (int j = 0; j < roi_w; j++) { p[j] = (pmask[j] < 255) ? 128 : ((u(rng) & 1) ? 255 : 0); }
+        }
+        sphere_map.create(map_h, map_w, CV_8UC1);
+        for (int i = 0; i < map_h; i++) {
+            uint8_t* p = sphere_map.ptr(i);
+            for (int j = 0; j < map_w; j++) {
+                int r = u(rng);
+                p[j] = (r == 0) ? 128 : (r == 1) ? 64 : 192;
+            }
+        }
+
+        R_roi = CmPoint64f::omegaToMatrix(CmPoint64f(0.3, -0.2, 0.1));
+    }
+
+    /// Number of ROI pixels that see the sphere (i.e. are tested by the kernels).
+    int numPixels() const
+    {
+        int n = 0;
+        for (int i = 0; i < roi_mask.rows; i++) {
+            const uint8_t* pmask = roi_mask.ptr(i);
+            for (int j = 0; j < roi_mask.cols; j++) { n += (pmask[j] == 255) ? 1 : 0; }
+        }
+        return n;
+    }
+};
@@ -0,0 +1,50 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       bench_localiser.cpp
+/// \brief      Microbenchmarks for the sphere matching and map update kernels.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "bench_common.h"
+
+#include "Localiser.h"
+#include "Trackball.h"
+
+#include <benchmark/benchmark.h>
+
+///
+/// Localiser::testRotation (one optimiser evaluation). Arg: q_factor.
+///
+static void BM_TestRotation(benchmark::State& state)
+{
+    RoiFixture fx(10 * static_cast<int>(state.range(0)));
+    Localiser loc(NLOPT_LN_BOBYQA, 0.35, 1e-3, 50, fx.sphere_model, fx.sphere_map, fx.roi_mask, fx.p1s_lut);
+    CmPoint64f dr(0.01, 0.02, -0.015);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(loc.evaluate(fx.roi_frame, fx.R_roi, dr));
+    }
+    state.SetItemsProcessed(state.iterations() * fx.numPixels());
+}
+BENCHMARK(BM_TestRotation)->Arg(4)->Arg(6)->Arg(10)->Arg(20);
+
+///
+/// Trackball::updateSphere (sphere map accumulation). Arg: q_factor.
+///
+static void BM_UpdateSphereMap(benchmark::State& state)
+{
+    RoiFixture fx(10 * static_cast<int>(state.range(0)));
+    const cv::Mat map0 = fx.sphere_map.clone();
+
+    for (auto _ : state) {
+        /// Each update starts from the same map, rather than one already saturated by earlier iterations.
+        state.PauseTiming();
+        map0.copyTo(fx.sphere_map);
+        state.ResumeTiming();
+
+        int good = 0;
+        benchmark::DoNotOptimize(Trackball::updateSphereMap(fx.roi_frame, fx.roi_mask, *fx.p1s_lut, fx.R_roi, fx.sphere_model, fx.sphere_map, good));
+        benchmark::DoNotOptimize(good);
+    }
+    state.SetItemsProcessed(state.iterations() * fx.numPixels());
+}
+BENCHMARK(BM_UpdateSphereMap)->Arg(4)->Arg(6)->Arg(10)->Arg(20);
@@ -0,0 +1,59 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       bench_remap.cpp
+/// \brief      Microbenchmarks for camera image remapping.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "bench_common.h"
+
+#include "CameraRemap.h"
+
+#include <benchmark/benchmark.h>
+
+///
+/// Source camera (rectilinear, 4:3, 45 deg vertical FoV) and ROI (fisheye) models, as set up by Trackball.
+///
+static CameraRemapPtr makeRemap(int src_w, int roi_w)
+{
+    int src_h = src_w * 3 / 4;
+    CameraModelPtr src_model = CameraModel::createRectilinear(src_w, src_h, 45 * CM_D2R);
+    double sphere_rad = 0.25;
+    CameraModelPtr roi_model = CameraModel::createFisheye(roi_w, roi_w, sphere_rad * 2.0 / roi_w, sphere_rad * 2.0);
+    CmPoint64f roi_c(0.05, -0.02, 1);
+    CmPoint64f roi_to_cam_r = roi_c.getNormalised().getRotationTo(CmPoint64f(0, 0, 1));
+    return CameraRemapPtr(new CameraRemap(src_model, roi_model, MatrixRemapTransform::createFromOmega(-roi_to_cam_r)));
+}
+
+///
+/// CameraRemap::apply. Args: source image width, ROI width.
+///
+static void BM_CameraRemapApply(benchmark::State& state)
+{
+    int src_w = static_cast<int>(state.range(0)), roi_w = static_cast<int>(state.range(1));
+    CameraRemapPtr remap = makeRemap(src_w, roi_w);
+    cv::Mat src = randomImage(src_w, src_w * 3 / 4);
+    cv::Mat dst(roi_w, roi_w, CV_8UC1);
+
+    for (auto _ : state) {
+        remap->apply(src, dst);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * roi_w * roi_w);
+}
+BENCHMARK(BM_CameraRemapApply)->ArgsProduct({ { 640, 1280 }, { 60, 120, 200 } });
+
+///
+/// CameraRemap::setTransform (recompute remap tables). Arg: ROI width.
+///
+static void BM_CameraRemapSetTransform(benchmark::State& state)
+{
+    int roi_w = static_cast<int>(state.range(0));
+    CameraRemapPtr remap = makeRemap(640, roi_w);
+    int i = 0;
+    for (auto _ : state) {
+        remap->setTransform(MatrixRemapTransform::createFromOmega(CmPoint(0.001 * (i % 100), 0.02, -0.01)));
+        i++;
+    }
+    state.SetItemsProcessed(state.iterations() * roi_w * roi_w);
+}
+BENCHMARK(BM_CameraRemapSetTransform)->Arg(60)->Arg(120)->Arg(200);
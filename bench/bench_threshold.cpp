@@ -0,0 +1,32 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       bench_threshold.cpp
+/// \brief      Microbenchmarks for the adaptive threshold stage of frame preprocessing.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "bench_common.h"
+
+#include "AdaptiveThreshold.h"
+
+#include <benchmark/benchmark.h>
+
+///
+/// AdaptiveThreshold::apply. Args: ROI width, window size (% of ROI width, as thr_win_pc), mode.
+///
+static void BM_Threshold(benchmark::State& state)
+{
+    RoiFixture fx(static_cast<int>(state.range(0)));
+    int win = static_cast<int>(round(state.range(1) / 100. * fx.roi_w)) | 0x01;     // as FrameGrabber
+    AdaptiveThreshold::Mode mode = static_cast<AdaptiveThreshold::Mode>(state.range(2));
+    AdaptiveThreshold thresh(fx.roi_mask, 1.25, win, mode);
+
+    cv::Mat grey = randomImage(fx.roi_w, fx.roi_w), work;
+    for (auto _ : state) {
+        grey.copyTo(work);  // threshold works in place (copy cost is negligible)
+        thresh.apply(work);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * fx.roi_w * fx.roi_w);
+    state.SetLabel(mode == AdaptiveThreshold::MEAN ? "mean" : "minmax");
+}
+BENCHMARK(BM_Threshold)->ArgsProduct({ { 60, 120, 200 }, { 10, 25, 50 }, { AdaptiveThreshold::MINMAX, AdaptiveThreshold::MEAN } });
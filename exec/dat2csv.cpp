@@ -0,0 +1,134 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       dat2csv.cpp
+/// \brief      Convert binary FicTrac data (.bin) to the text (.dat) format.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "DataRecord.h"
+
+#include <cstring>  // memcpy
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    if ((argc < 2) || (argc > 3)) {
+        cerr << "///" << endl;
+        cerr << "/// dat2csv:\tConvert binary FicTrac data (out_fmt : bin) to the text data format.\n///" << endl;
+        cerr << "/// Usage:\tdat2csv IN_FN [OUT_FN]\n///" << endl;
+        cerr << "/// \tIN_FN\tBinary data file (*.bin, or *.bin.gz)." << endl;
+        cerr << "/// \tOUT_FN\t[Optional] Output text data file (defaults to IN_FN with .dat extension, '-' for stdout)." << endl;
+        cerr << "///" << endl;
+        return -1;
+    }
+
+    string in_fn = argv[1];
+    bool gz = (in_fn.size() > 3) && (in_fn.compare(in_fn.size() - 3, 3, ".gz") == 0);
+    string out_fn;
+    if (argc > 2) {
+        out_fn = argv[2];
+    }
+    else {
+        string base = gz ? in_fn.substr(0, in_fn.size() - 3) : in_fn;
+        size_t ext = base.find_last_of('.');
+        out_fn = ((ext != string::npos) && (base.find_first_of("/\\", ext) == string::npos) ? base.substr(0, ext) : base) + ".dat";
+    }
+
+    /// Reads up to len bytes, returning the number read.
+    function<size_t(char*, size_t)> read;
+    ifstream in;
+#ifdef WITH_ZLIB
+    gzFile gzin = nullptr;
+#endif
+    if (gz) {
+#ifdef WITH_ZLIB
+        gzin = gzopen(in_fn.c_str(), "rb");
+        if (!gzin) {
+            cerr << "Error! Unable to open input file (" << in_fn << ")." << endl;
+            return -1;
+        }
+        read = [&](char* buf, size_t len) {
+            int n = gzread(gzin, buf, static_cast<unsigned>(len));
+            return static_cast<size_t>(n > 0 ? n : 0);
+        };
+#else
+        cerr << "Error! This build of dat2csv does not support compressed input (zlib not found)." << endl;
+        return -1;
+#endif
+    }
+    else {
+        in.open(in_fn, ios::in | ios::binary);
+        if (!in.is_open()) {
+            cerr << "Error! Unable to open input file (" << in_fn << ")." << endl;
+            return -1;
+        }
+        read = [&](char* buf, size_t len) {
+            in.read(buf, len);
+            return static_cast<size_t>(in.gcount());
+        };
+    }
+
+    /// Header.
+    string hdr(sizeof(DataHeader), '\0');
+    hdr.resize(read(&hdr[0], hdr.size()));
+    bool lat_cols = false;
+    size_t header_size = 0;
+    string err;
+    if (!parseDataFileHeader(hdr, lat_cols, header_size, err)) {
+        cerr << "Error! Unable to read " << in_fn << " (" << err << ")." << endl;
+        return -1;
+    }
+    /// Skip the rest of the header (column table).
+    vector<char> skip(header_size > hdr.size() ? header_size - hdr.size() : 0);
+    if (read(skip.data(), skip.size()) != skip.size()) {
+        cerr << "Error! Unable to read " << in_fn << " (file too short)." << endl;
+        return -1;
+    }
+
+    ofstream out_file;
+    if (out_fn != "-") {
+        out_file.open(out_fn);
+        if (!out_file.is_open()) {
+            cerr << "Error! Unable to open output file (" << out_fn << ")." << endl;
+            return -1;
+        }
+    }
+    ostream& out = (out_fn != "-") ? out_file : cout;
+
+    /// Records.
+    const size_t BATCH = 4096;
+    vector<DataRecord> recs(BATCH);
+    size_t nrecs = 0;
+    while (true) {
+        size_t nbytes = read(reinterpret_cast<char*>(recs.data()), BATCH * sizeof(DataRecord));
+        if (nbytes == 0) { break; }
+        size_t n = nbytes / sizeof(DataRecord);
+        for (size_t i = 0; i < n; i++) {
+            out << recs[i].toText(lat_cols);
+        }
+        nrecs += n;
+        if (nbytes % sizeof(DataRecord) != 0) {
+            cerr << "Warning! Ignoring truncated record at end of file." << endl;
+        }
+    }
+
+#ifdef WITH_ZLIB
+    if (gzin) { gzclose(gzin); }
+#endif
+
+    if (!out) {
+        cerr << "Error! Failed writing output (" << out_fn << ")." << endl;
+        return -1;
+    }
+    cerr << "Converted " << nrecs << " records from " << in_fn << " to " << out_fn << "." << endl;
+    return 0;
+}
@@ -0,0 +1,561 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       fictrac-batch.cpp
+/// \brief      Offline processing of many config/video pairs in parallel, with a benchmark-style report.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "Logger.h"
+#include "Trackball.h"
+#include "CVSource.h"
+#include "ConfigParser.h"
+#include "FileRecorder.h"
+#include "SegmentStitcher.h"
+#include "Trace.h"
+#include "timing.h"
+#include "misc.h"
+#include "fictrac_version.h"
+
+#include <algorithm>    // min, max
+#include <atomic>
+#include <csignal>
+#include <cstdio>       // remove
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/// How often progress is printed.
+const int PROGRESS_MS = 5000;
+
+/// Frames each segment tracks before taking over from the previous segment (see --overlap).
+const int OVERLAP_DEFAULT = 250;
+
+/// Ctrl-c handling (read by the job threads)
+atomic<bool> _active(true);
+void ctrlcHandler(int /*signum*/) { _active = false; }
+
+///
+/// One config/video pair.
+///
+struct Job
+{
+    enum State { QUEUED, RUNNING, DONE, FAILED, CANCELLED };
+
+    string config_fn, src_fn, name;
+    map<string, string> cfg;        // job-specific config overrides (on top of the batch's)
+    State state = QUEUED;
+    Trackball* tracker = nullptr;   // while running
+    Trackball::Timing timing;
+    double wall_ms = 0;
+};
+
+const char* const JobStateStrings[] = { "queued", "running", "ok", "failed", "cancelled" };
+
+///
+/// One video split into segment jobs, to be stitched back into a single data file.
+///
+struct Stitch
+{
+    string name, out_fn;
+    bool binary = false;
+    vector<SegmentStitcher::Segment> segs;
+    vector<size_t> jobs;            // segment jobs, in order
+    bool ok = false;
+    SegmentStitcher::Stats stats;
+};
+
+///
+/// Summary statistics of a histogram as a JSON object.
+///
+string histJson(const LatencyHist& h)
+{
+    ostringstream ss;
+    ss.precision(6);
+    ss << "{ \"mean\": " << h.mean() << ", \"p50\": " << h.percentile(50) << ", \"p99\": " << h.percentile(99) << ", \"max\": " << h.max() << " }";
+    return ss.str();
+}
+
+///
+/// Escape string for JSON output.
+///
+string jsonStr(const string& s)
+{
+    string out = "\"";
+    for (char c : s) {
+        if ((c == '"') || (c == '\\')) { out += '\\'; }
+        out += c;
+    }
+    return out + "\"";
+}
+
+///
+/// Read jobs from a list file: one "CONFIG_FN [SRC_FN]" per line (SRC_FN is the rest of the line, so it may
+/// contain spaces). Blank lines and lines starting with # are ignored.
+///
+bool readJobList(const string& fn, vector<Job>& jobs)
+{
+    ifstream f(fn);
+    if (!f.is_open()) {
+        LOG_ERR("Error! Unable to open job list (%s).", fn.c_str());
+        return false;
+    }
+    string line;
+    while (getline(f, line)) {
+        if (!line.empty() && (line.back() == '\r')) { line.pop_back(); }
+        size_t b = line.find_first_not_of(" \t");
+        if ((b == string::npos) || (line[b] == '#')) { continue; }
+        size_t e = line.find_first_of(" \t", b);
+
+        Job job;
+        job.config_fn = line.substr(b, e - b);
+        if (e != string::npos) {
+            size_t sb = line.find_first_not_of(" \t", e);
+            size_t se = line.find_last_not_of(" \t");
+            if (sb != string::npos) { job.src_fn = line.substr(sb, se - sb + 1); }
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+///
+/// Base name of a job's output files, as the tracker will choose it (see Trackball).
+///
+string outputBase(const Job& job, const map<string, string>& cfg_override)
+{
+    ConfigParser cfg;
+    cfg.read(job.config_fn);    // errors are reported when the job runs
+    for (auto& kv : cfg_override) {
+        cfg.add(kv.first, kv.second);
+    }
+    for (auto& kv : job.cfg) {
+        cfg.add(kv.first, kv.second);
+    }
+
+    string base_fn = cfg("output_fn");
+    if (!base_fn.empty()) { return base_fn; }
+    string src_fn = job.src_fn.empty() ? cfg("src_fn") : job.src_fn;
+    if (src_fn == "synth") {
+        base_fn = "fictrac-synth";
+    }
+    else if ((src_fn.size() <= 2) && (src_fn.find_first_not_of("0123456789") == string::npos)) {
+        base_fn = "fictrac";    // camera id
+    }
+    else {
+        base_fn = src_fn.substr(0, src_fn.length() - 4);
+    }
+    if (!cfg("rig_name").empty()) { base_fn += "-" + cfg("rig_name"); }
+    return base_fn;
+}
+
+///
+/// Split a job into nsegs segment jobs that each track an overlapping part of the video.
+/// Jobs whose length can't be determined (e.g. cameras, synthetic sources) are run whole.
+///
+void splitJob(const Job& job, int nsegs, int overlap, const map<string, string>& cfg_override, vector<Job>& out, vector<Stitch>& stitches)
+{
+    Logger::ScopedTag tag(job.name);
+
+    ConfigParser cfg;
+    if (cfg.read(job.config_fn) <= 0) {
+        out.push_back(job);     // fails (and is reported) when run
+        return;
+    }
+    for (auto& kv : cfg_override) {
+        cfg.add(kv.first, kv.second);
+    }
+    for (auto& kv : job.cfg) {
+        cfg.add(kv.first, kv.second);
+    }
+
+    /// Work out which frames the job would track.
+    string src_fn = job.src_fn.empty() ? cfg("src_fn") : job.src_fn;
+    long nframes = -1;
+    {
+        CVSource source(src_fn);
+        nframes = source.getFrameCount();
+    }
+    int start = 0, max_frame_cnt = -1;
+    if (!cfg.getInt("src_start", start) || (start < 0)) { start = 0; }
+    if (nframes > 0) { nframes -= start; }
+    if (cfg.getInt("max_frame_cnt", max_frame_cnt) && (max_frame_cnt > 0) && ((nframes < 0) || (nframes > max_frame_cnt))) {
+        nframes = max_frame_cnt;
+    }
+    if (nframes < 2 * nsegs) {
+        LOG_WRN("Warning! Unable to split %s into segments (unknown or too few frames). Running it whole.", src_fn.c_str());
+        out.push_back(job);
+        return;
+    }
+
+    /// Output file names as the tracker would choose them.
+    string base_fn = cfg("output_fn");
+    if (base_fn.empty()) {
+        base_fn = src_fn.substr(0, src_fn.length() - 4);
+        if (!cfg("rig_name").empty()) { base_fn += "-" + cfg("rig_name"); }
+    }
+    bool out_gz = false;
+    cfg.getBool("out_gz", out_gz);
+    out_gz &= FileRecorder::gzipSupported();
+
+    Stitch st;
+    st.name = job.name;
+    st.binary = (cfg("out_fmt") == "bin");
+    st.out_fn = base_fn + "-" + execTime() + (st.binary ? ".bin" : ".dat") + (out_gz ? ".gz" : "");
+
+    LOG("Splitting %s into %d segments (%ld frames, %d frames overlap)", src_fn.c_str(), nsegs, nframes, overlap);
+    for (int i = 0; i < nsegs; i++) {
+        long end = start + (i + 1) * nframes / nsegs;
+        long seg_start = start + i * nframes / nsegs;
+        if (i > 0) { seg_start = max<long>(seg_start - overlap, start); }
+
+        Job seg = job;
+        seg.name = job.name + ".s" + to_string(i + 1);
+        seg.cfg["src_start"] = to_string(seg_start);
+        seg.cfg["max_frame_cnt"] = to_string(end - seg_start);
+        seg.cfg["output_fn"] = base_fn + "-seg" + to_string(i + 1);
+        seg.cfg["out_fmt"] = "bin";
+        seg.cfg["out_gz"] = "n";
+        seg.cfg["out_decim"] = "1";
+        seg.cfg["frame_policy"] = "bounded";    // stitching relies on every frame being tracked
+        seg.cfg["out_overflow"] = "block";
+
+        st.segs.push_back({ seg.cfg["output_fn"] + "-" + execTime() + ".bin", seg_start });
+        st.jobs.push_back(out.size());
+        out.push_back(seg);
+    }
+    stitches.push_back(st);
+}
+
+///
+/// Job thread: run queued jobs one after another until there are none left.
+///
+void runJobs(vector<Job>& jobs, atomic<size_t>& next, mutex& jobs_mutex, const map<string, string>& cfg_override)
+{
+    while (_active) {
+        size_t i = next++;
+        if (i >= jobs.size()) { break; }
+        Job& job = jobs[i];
+
+        Logger::ScopedTag tag(job.name);
+        double t0 = ts_ms();
+
+        map<string, string> cfg = cfg_override;
+        for (auto& kv : job.cfg) {
+            cfg[kv.first] = kv.second;
+        }
+        unique_ptr<Trackball> tracker = make_unique<Trackball>(job.config_fn, job.src_fn, cfg);
+        {
+            lock_guard<mutex> l(jobs_mutex);
+            job.tracker = tracker.get();
+            job.state = Job::RUNNING;
+        }
+
+        bool killed = false;
+        while (tracker->isActive()) {
+            if (!_active && !killed) {
+                tracker->terminate();
+                killed = true;
+            }
+            ficsleep(50);
+        }
+
+        {
+            lock_guard<mutex> l(jobs_mutex);
+            job.tracker = nullptr;
+            job.timing = tracker->getTiming();
+            job.state = killed ? Job::CANCELLED : (job.timing.nframes > 0) ? Job::DONE : Job::FAILED;
+        }
+        tracker.reset();    // flushes and closes outputs
+        job.wall_ms = ts_ms() - t0;
+
+        if (job.state == Job::FAILED) {
+            LOG_ERR("Error! Job failed (%s %s).", job.config_fn.c_str(), job.src_fn.c_str());
+        }
+        else {
+            PRINT("Job %s: %lu frames in %.1f s (%s)", JobStateStrings[job.state], job.timing.nframes, job.wall_ms / 1000,
+                job.src_fn.empty() ? job.config_fn.c_str() : job.src_fn.c_str());
+        }
+    }
+}
+
+///
+/// Print one line per running job, and overall counts.
+///
+void printProgress(vector<Job>& jobs, mutex& jobs_mutex)
+{
+    lock_guard<mutex> l(jobs_mutex);
+    size_t nstate[5] = {};
+    for (auto& job : jobs) {
+        nstate[job.state]++;
+        if (!job.tracker) { continue; }
+
+        Trackball::Timing t = job.tracker->getTiming();
+        double fps = (t.elapsed_ms > 0) ? 1000. * (t.nframes - 1) / t.elapsed_ms : 0;
+        if (t.src_frames > 0) {
+            PRINT("[%s] %5.1f%% (%lu / %ld frames, %.1f fps) %s", job.name.c_str(), 100. * t.nframes / t.src_frames,
+                t.nframes, t.src_frames, fps, job.src_fn.empty() ? job.config_fn.c_str() : job.src_fn.c_str());
+        }
+        else {
+            PRINT("[%s] %lu frames (%.1f fps) %s", job.name.c_str(), t.nframes, fps,
+                job.src_fn.empty() ? job.config_fn.c_str() : job.src_fn.c_str());
+        }
+    }
+    PRINT("Jobs: %zu done, %zu running, %zu queued, %zu failed\n",
+        nstate[Job::DONE], nstate[Job::RUNNING], nstate[Job::QUEUED], nstate[Job::FAILED]);
+}
+
+int main(int argc, char *argv[])
+{
+    PRINT("///");
+    PRINT("/// fictrac-batch:\tProcess many videos in parallel, as fast as possible.\n///");
+    PRINT("/// Usage:\tfictrac-batch JOB_LIST [JOB_LIST ...] [-j JOBS -v LOG_VERBOSITY -o REPORT_FN --set KEY=VAL]");
+    PRINT("///       \t\t[--segments N --overlap FRAMES --keep-segments]\n///");
+    PRINT("/// \tJOB_LIST\tText file with one job per line: CONFIG_FN [SRC_FN]. Config files are not modified.");
+    PRINT("/// \tJOBS\t\t[Optional] Number of jobs to run at once (defaults to the number of CPU cores).");
+    PRINT("/// \tLOG_VERBOSITY\t[Optional] One of DBG, INF, WRN (default), ERR.");
+    PRINT("/// \tREPORT_FN\t[Optional] JSON report file (defaults to fictrac-batch-TIME.json).");
+    PRINT("/// \tKEY=VAL\t\t[Optional, repeatable] Override any other config param for every job.");
+    PRINT("/// \tN\t\t[Optional] Split each video into N overlapping segments, tracked in parallel and stitched into one data file.");
+    PRINT("/// \tFRAMES\t\t[Optional] Frames each segment tracks before taking over from the previous one (default %d).", OVERLAP_DEFAULT);
+    PRINT("/// \t--keep-segments\t[Optional] Keep the per-segment data files after stitching.");
+    PRINT("///");
+    PRINT("/// Version: %d.%d.%d (build date: %s)", FICTRAC_VERSION_MAJOR, FICTRAC_VERSION_MIDDLE, FICTRAC_VERSION_MINOR, __DATE__);
+    PRINT("///\n");
+
+    /// Jobs run unpaced, headless and offline. Parallelism comes from running many jobs, so each job
+    /// preprocesses its frames serially.
+    map<string, string> cfg_override = {
+        {"do_display", "n"},
+        {"save_raw", "n"},
+        {"save_debug", "n"},
+        {"src_fps", "-1"},
+        {"synth_realtime", "n"},
+        {"proc_threads", "1"},
+        {"sock_port", "-1"},
+        {"com_port", ""},
+        {"shm_name", ""},
+        {"metrics_port", "-1"},
+        {"trace", "y"},
+    };
+
+    /// Parse args.
+    string log_level = "warn";
+    int njobs = max<int>(thread::hardware_concurrency(), 1);
+    string report_fn = "fictrac-batch-" + execTime() + ".json";
+    int nsegs = 1, overlap = OVERLAP_DEFAULT;
+    bool keep_segs = false;
+    vector<Job> jobs;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--keep-segments") {
+            keep_segs = true;
+        }
+        else if ((arg == "--verbosity") || (arg == "-v") || (arg == "--jobs") || (arg == "-j") ||
+            (arg == "--out") || (arg == "-o") || (arg == "--set") || (arg == "--segments") || (arg == "--overlap")) {
+            if (++i >= argc) {
+                LOG_ERR("%s requires one argument!", arg.c_str());
+                return -1;
+            }
+            string val = argv[i];
+            if ((arg == "--verbosity") || (arg == "-v")) { log_level = val; }
+            else if ((arg == "--jobs") || (arg == "-j")) { njobs = max(atoi(val.c_str()), 1); }
+            else if ((arg == "--out") || (arg == "-o")) { report_fn = val; }
+            else if (arg == "--segments") { nsegs = max(atoi(val.c_str()), 1); }
+            else if (arg == "--overlap") { overlap = max(atoi(val.c_str()), 0); }
+            else {
+                size_t eq = val.find('=');
+                if ((eq == string::npos) || (eq == 0)) {
+                    LOG_ERR("--set requires an argument of the form KEY=VAL!");
+                    return -1;
+                }
+                cfg_override[val.substr(0, eq)] = val.substr(eq + 1);
+            }
+        }
+        else if (!readJobList(arg, jobs)) {
+            return -1;
+        }
+    }
+    if (jobs.empty()) {
+        LOG_ERR("Error! No jobs to run (pass one or more job list files).");
+        return -1;
+    }
+    for (size_t i = 0; i < jobs.size(); i++) {
+        jobs[i].name = "job" + to_string(i + 1);
+    }
+
+    /// Set logging level.
+    Logger::setVerbosity(log_level);
+
+    /// Output file names only differ by base name (the time stamp is the same for every job), so jobs that would
+    /// write to the same files (e.g. one video tracked with several configs, or a shared output_fn) are renamed.
+    map<string, vector<size_t>> by_base;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        by_base[outputBase(jobs[i], cfg_override)].push_back(i);
+    }
+    for (auto& b : by_base) {
+        if (b.second.size() < 2) { continue; }
+        for (size_t i : b.second) {
+            jobs[i].cfg["output_fn"] = b.first + "-" + jobs[i].name;
+            LOG_WRN("Warning! %zu jobs would write to %s, so %s writes to %s instead.", b.second.size(), b.first.c_str(),
+                jobs[i].name.c_str(), jobs[i].cfg["output_fn"].c_str());
+        }
+    }
+
+    /// Long videos can be split into segments, so a single video also uses every core.
+    vector<Stitch> stitches;
+    if (nsegs > 1) {
+        vector<Job> split;
+        for (auto& job : jobs) {
+            splitJob(job, nsegs, overlap, cfg_override, split, stitches);
+        }
+        jobs.swap(split);
+    }
+    njobs = min<int>(njobs, static_cast<int>(jobs.size()));
+
+    // Catch cntl-c
+    signal(SIGINT, ctrlcHandler);
+
+    /// Stage timing is collected across all jobs (jobs don't enable tracing themselves while it's on).
+    Trace::enable();
+
+    PRINT("Running %zu jobs, %d at a time\n", jobs.size(), njobs);
+    double t0 = ts_ms();
+
+    atomic<size_t> next_job(0);
+    mutex jobs_mutex;
+    vector<unique_ptr<thread>> threads;
+    for (int i = 0; i < njobs; i++) {
+        threads.push_back(make_unique<thread>(runJobs, ref(jobs), ref(next_job), ref(jobs_mutex), cref(cfg_override)));
+    }
+
+    /// Report progress until every job has finished.
+    auto finished = [&] {
+        lock_guard<mutex> l(jobs_mutex);
+        for (auto& job : jobs) {
+            if ((job.state == Job::QUEUED && _active) || (job.state == Job::RUNNING)) { return false; }
+        }
+        return true;
+    };
+    double t_progress = ts_ms();
+    while (!finished()) {
+        ficsleep(100);
+        if (ts_ms() - t_progress >= PROGRESS_MS) {
+            printProgress(jobs, jobs_mutex);
+            t_progress = ts_ms();
+        }
+    }
+    for (auto& t : threads) {
+        t->join();
+    }
+    double wall_ms = ts_ms() - t0;
+
+    Trace::disable();
+    map<string, LatencyHist> zones = Trace::histograms();
+
+    /// Stitch segmented videos back together.
+    size_t nstitch_failed = 0;
+    for (auto& st : stitches) {
+        Logger::ScopedTag tag(st.name);
+        bool segs_ok = true;
+        for (size_t j : st.jobs) {
+            segs_ok &= (jobs[j].state == Job::DONE);
+        }
+        if (segs_ok) {
+            st.ok = SegmentStitcher::stitch(st.segs, st.out_fn, st.binary, st.stats);
+        }
+        if (!st.ok) {
+            LOG_ERR("Error! Unable to stitch segments into %s%s.", st.out_fn.c_str(), segs_ok ? "" : " (not every segment finished)");
+            nstitch_failed++;
+            continue;
+        }
+        PRINT("Stitched %zu segments into %s (%lu frames)", st.segs.size(), st.out_fn.c_str(), st.stats.nrecs);
+        if (!keep_segs) {
+            for (auto& seg : st.segs) {
+                remove(seg.fn.c_str());
+            }
+        }
+    }
+
+    /// Summarise.
+    size_t nstate[5] = {};
+    unsigned long frames = 0;
+    for (auto& job : jobs) {
+        nstate[job.state]++;
+        frames += job.timing.nframes;
+    }
+    double fps = (wall_ms > 0) ? 1000. * frames / wall_ms : 0;
+
+    /// Write report.
+    ostringstream ss;
+    ss.precision(6);
+    ss << "{\n";
+    ss << "  \"version\": \"" << FICTRAC_VERSION_MAJOR << "." << FICTRAC_VERSION_MIDDLE << "." << FICTRAC_VERSION_MINOR << "\",\n";
+    ss << "  \"parallel_jobs\": " << njobs << ",\n";
+    ss << "  \"jobs_ok\": " << nstate[Job::DONE] << ",\n";
+    ss << "  \"jobs_failed\": " << nstate[Job::FAILED] << ",\n";
+    ss << "  \"jobs_cancelled\": " << nstate[Job::CANCELLED] + nstate[Job::QUEUED] << ",\n";
+    ss << "  \"frames\": " << frames << ",\n";
+    ss << "  \"wall_ms\": " << wall_ms << ",\n";
+    ss << "  \"fps\": " << fps << ",\n";
+    ss << "  \"stages_ms\": {\n";
+    for (auto it = zones.begin(); it != zones.end(); ++it) {
+        ss << "    " << jsonStr(it->first) << ": " << histJson(it->second) << ((next(it) != zones.end()) ? ",\n" : "\n");
+    }
+    ss << "  },\n";
+    ss << "  \"trace_dropped\": " << Trace::dropped() << ",\n";
+    ss << "  \"peak_rss_bytes\": " << GetPeakRSS() << ",\n";
+    ss << "  \"jobs\": [\n";
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const Job& job = jobs[i];
+        const Trackball::Timing& t = job.timing;
+        double job_fps = (t.elapsed_ms > 0) ? 1000. * (t.nframes - 1) / t.elapsed_ms : 0;
+        ss << "    {\n";
+        ss << "      \"name\": " << jsonStr(job.name) << ",\n";
+        ss << "      \"config_fn\": " << jsonStr(job.config_fn) << ",\n";
+        ss << "      \"src_fn\": " << jsonStr(job.src_fn) << ",\n";
+        ss << "      \"output_fn\": " << jsonStr(job.cfg.count("output_fn") ? job.cfg.at("output_fn") : "") << ",\n";
+        ss << "      \"status\": \"" << JobStateStrings[job.state] << "\",\n";
+        ss << "      \"frames\": " << t.nframes << ",\n";
+        ss << "      \"bad_frames\": " << t.nbad << ",\n";
+        ss << "      \"elapsed_ms\": " << t.elapsed_ms << ",\n";
+        ss << "      \"wall_ms\": " << job.wall_ms << ",\n";
+        ss << "      \"fps\": " << job_fps << ",\n";
+        ss << "      \"evals_per_frame\": " << histJson(t.evals) << ",\n";
+        ss << "      \"latency_ms\": { \"dequeue\": " << histJson(t.lat_deq) << ", \"opt\": " << histJson(t.lat_opt) << " },\n";
+        ss << "      \"frames_grabbed\": " << t.grabber.grabbed << ",\n";
+        ss << "      \"frames_dropped\": " << t.grabber.dropped << "\n";
+        ss << "    }" << ((i + 1 < jobs.size()) ? ",\n" : "\n");
+    }
+    ss << "  ]";
+    if (!stitches.empty()) {
+        ss << ",\n";
+        ss << "  \"stitched\": [\n";
+        for (size_t i = 0; i < stitches.size(); i++) {
+            const Stitch& st = stitches[i];
+            ss << "    { \"name\": " << jsonStr(st.name) << ", \"out_fn\": " << jsonStr(st.out_fn) << ", \"status\": \"" << (st.ok ? "ok" : "failed")
+                << "\", \"segments\": " << st.segs.size() << ", \"frames\": " << st.stats.nrecs << ", \"resets\": " << st.stats.nresets
+                << ", \"unmatched_joins\": " << st.stats.nunmatched << " }" << ((i + 1 < stitches.size()) ? ",\n" : "\n");
+        }
+        ss << "  ]";
+    }
+    ss << "\n}\n";
+
+    ofstream f(report_fn);
+    if (!f.is_open() || !(f << ss.str())) {
+        LOG_ERR("Error! Unable to write batch report (%s).", report_fn.c_str());
+        return -1;
+    }
+    PRINT("\n%zu / %zu jobs ok (%zu failed), %lu frames in %.1f s (%.1f fps overall)",
+        nstate[Job::DONE], jobs.size(), nstate[Job::FAILED], frames, wall_ms / 1000, fps);
+    PRINT("Batch report written to %s", report_fn.c_str());
+
+    /// Wait a bit for async logging to finish...
+    ficsleep(250);
+    return ((nstate[Job::FAILED] > 0) || (nstitch_failed > 0)) ? 1 : 0;
+}
@@ -0,0 +1,179 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       fictrac-bench.cpp
+/// \brief      Headless FicTrac benchmark, with machine-readable timing report.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "Logger.h"
+#include "Trackball.h"
+#include "Trace.h"
+#include "timing.h"
+#include "misc.h"
+#include "fictrac_version.h"
+
+#include <string>
+#include <csignal>
+#include <memory>
+#include <map>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+/// Ctrl-c handling
+bool _active = true;
+void ctrlcHandler(int /*signum*/) { _active = false; }
+
+///
+/// Summary statistics of a histogram as a JSON object.
+///
+string histJson(const LatencyHist& h)
+{
+    ostringstream ss;
+    ss.precision(6);
+    ss << "{ \"mean\": " << h.mean() << ", \"p50\": " << h.percentile(50) << ", \"p99\": " << h.percentile(99) << ", \"max\": " << h.max() << " }";
+    return ss.str();
+}
+
+///
+/// Escape string for JSON output.
+///
+string jsonStr(const string& s)
+{
+    string out = "\"";
+    for (char c : s) {
+        if ((c == '"') || (c == '\\')) { out += '\\'; }
+        out += c;
+    }
+    return out + "\"";
+}
+
+int main(int argc, char *argv[])
+{
+    PRINT("///");
+    PRINT("/// fictrac-bench:\tRun FicTrac as fast as possible and report timing statistics.\n///");
+    PRINT("/// Usage:\tfictrac-bench CONFIG_FN [-v LOG_VERBOSITY -s SRC_FN -n MAX_FRAMES -o REPORT_FN --set KEY=VAL]\n///");
+    PRINT("/// \tCONFIG_FN\tPath to input config file (defaults to config.txt). The file is not modified.");
+    PRINT("/// \tLOG_VERBOSITY\t[Optional] One of DBG, INF, WRN (default), ERR.");
+    PRINT("/// \tSRC_FN\t\t[Optional] Override src_fn param in config file (use 'synth' for a synthetic sequence).");
+    PRINT("/// \tMAX_FRAMES\t[Optional] Stop after this many frames.");
+    PRINT("/// \tREPORT_FN\t[Optional] JSON report file (defaults to fictrac-bench-TIME.json).");
+    PRINT("/// \tKEY=VAL\t\t[Optional, repeatable] Override any other config param.");
+    PRINT("///");
+    PRINT("/// Version: %d.%d.%d (build date: %s)", FICTRAC_VERSION_MAJOR, FICTRAC_VERSION_MIDDLE, FICTRAC_VERSION_MINOR, __DATE__);
+    PRINT("///\n");
+
+    /// Benchmark runs unpaced and headless.
+    map<string, string> cfg_override = {
+        {"do_display", "n"},
+        {"save_raw", "n"},
+        {"save_debug", "n"},
+        {"src_fps", "-1"},
+        {"synth_realtime", "n"},
+        {"trace", "y"},
+    };
+
+    /// Parse args.
+    string log_level = "warn";
+    string config_fn = "config.txt";
+    string src_fn = "";
+    string report_fn = "fictrac-bench-" + execTime() + ".json";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if ((arg == "--verbosity") || (arg == "-v") || (arg == "--src") || (arg == "-s") ||
+            (arg == "--frames") || (arg == "-n") || (arg == "--out") || (arg == "-o") || (arg == "--set")) {
+            if (++i >= argc) {
+                LOG_ERR("%s requires one argument!", arg.c_str());
+                return -1;
+            }
+            string val = argv[i];
+            if ((arg == "--verbosity") || (arg == "-v")) { log_level = val; }
+            else if ((arg == "--src") || (arg == "-s")) { src_fn = val; }
+            else if ((arg == "--frames") || (arg == "-n")) { cfg_override["max_frame_cnt"] = val; }
+            else if ((arg == "--out") || (arg == "-o")) { report_fn = val; }
+            else {
+                size_t eq = val.find('=');
+                if ((eq == string::npos) || (eq == 0)) {
+                    LOG_ERR("--set requires an argument of the form KEY=VAL!");
+                    return -1;
+                }
+                cfg_override[val.substr(0, eq)] = val.substr(eq + 1);
+            }
+        }
+        else {
+            config_fn = arg;
+        }
+    }
+
+    /// Set logging level.
+    Logger::setVerbosity(log_level);
+
+    // Catch cntl-c
+    signal(SIGINT, ctrlcHandler);
+
+    unique_ptr<Trackball> tracker = make_unique<Trackball>(config_fn, src_fn, cfg_override);
+
+    /// Wait for tracking to finish.
+    while (tracker->isActive()) {
+        if (!_active) {
+            tracker->terminate();
+        }
+        ficsleep(50);
+    }
+
+    Trackball::Timing timing = tracker->getTiming();
+    tracker.reset();    // stops tracing
+    map<string, LatencyHist> zones = Trace::histograms();
+    if (timing.nframes < 2) {
+        LOG_ERR("Error! Too few frames were processed to benchmark (%lu).", timing.nframes);
+        return -1;
+    }
+    double fps = timing.elapsed_ms > 0 ? 1000. * (timing.nframes - 1) / timing.elapsed_ms : 0;
+
+    /// Write report.
+    ostringstream ss;
+    ss.precision(6);
+    ss << "{\n";
+    ss << "  \"version\": \"" << FICTRAC_VERSION_MAJOR << "." << FICTRAC_VERSION_MIDDLE << "." << FICTRAC_VERSION_MINOR << "\",\n";
+    ss << "  \"config_fn\": " << jsonStr(config_fn) << ",\n";
+    ss << "  \"src_fn\": " << jsonStr(src_fn) << ",\n";
+    ss << "  \"frames\": " << timing.nframes << ",\n";
+    ss << "  \"bad_frames\": " << timing.nbad << ",\n";
+    ss << "  \"elapsed_ms\": " << timing.elapsed_ms << ",\n";
+    ss << "  \"fps\": " << fps << ",\n";
+    ss << "  \"stages_ms\": {\n";
+    for (auto it = zones.begin(); it != zones.end(); ++it) {
+        ss << "    " << jsonStr(it->first) << ": " << histJson(it->second) << ((next(it) != zones.end()) ? ",\n" : "\n");
+    }
+    ss << "  },\n";
+    ss << "  \"trace_dropped\": " << Trace::dropped() << ",\n";
+    ss << "  \"evals_per_frame\": " << histJson(timing.evals) << ",\n";
+    ss << "  \"latency_ms\": {\n";
+    ss << "    \"dequeue\": " << histJson(timing.lat_deq) << ",\n";
+    ss << "    \"opt\": " << histJson(timing.lat_opt);
+    for (auto& w : timing.lat_write) {
+        ss << ",\n    " << jsonStr("write." + w.first) << ": " << histJson(w.second);
+    }
+    ss << "\n  },\n";
+    ss << "  \"latency_budget_exceeded\": " << timing.lat_over << ",\n";
+    ss << "  \"frames_grabbed\": " << timing.grabber.grabbed << ",\n";
+    ss << "  \"frames_dropped\": " << timing.grabber.dropped << ",\n";
+    ss << "  \"frame_q_depth_max\": " << timing.grabber.q_depth_max << ",\n";
+    ss << "  \"peak_rss_bytes\": " << GetPeakRSS() << "\n";
+    ss << "}\n";
+
+    ofstream f(report_fn);
+    if (!f.is_open() || !(f << ss.str())) {
+        LOG_ERR("Error! Unable to write benchmark report (%s).", report_fn.c_str());
+        return -1;
+    }
+    const LatencyHist& frame_ms = zones["track.frame"];
+    PRINT("\n%lu frames in %.1f s (%.1f fps), frame time p50/p99: %.2f / %.2f ms, %.1f evals/frame",
+        timing.nframes, timing.elapsed_ms / 1000, fps, frame_ms.percentile(50), frame_ms.percentile(99), timing.evals.mean());
+    PRINT("Latency grab->opt p50/p99: %.2f / %.2f ms", timing.lat_opt.percentile(50), timing.lat_opt.percentile(99));
+    PRINT("Benchmark report written to %s", report_fn.c_str());
+
+    /// Wait a bit for async logging to finish...
+    ficsleep(250);
+    return 0;
+}
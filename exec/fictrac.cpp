@@ -6,13 +6,20 @@
 
 #include "Logger.h"
 #include "Trackball.h"
+#include "ConfigParser.h"
+#include "ThreadPool.h"
+#include "Trace.h"
 #include "timing.h"
 #include "misc.h"
 #include "fictrac_version.h"
 
+#include <algorithm>    // any_of, max
 #include <string>
 #include <csignal>
 #include <memory>
+#include <set>
+#include <thread>
+#include <vector>
 
 using namespace std;
 
@@ -20,22 +27,61 @@ using namespace std;
 bool _active = true;
 void ctrlcHandler(int /*signum*/) { _active = false; }
 
+///
+/// Rig name for a config file: its rig_name parameter, or else the config file's name (which is saved as rig_name).
+///
+string rigName(const string& config_fn)
+{
+    ConfigParser cfg;
+    if (cfg.read(config_fn) <= 0) { return ""; }    // Trackball reports the error
+    string rig = cfg("rig_name");
+    if (rig.empty()) {
+        rig = config_fn.substr(config_fn.find_last_of("/\\") + 1);
+        rig = rig.substr(0, rig.find_last_of('.'));
+        LOG_WRN("Warning! Using default value for rig_name (%s) in %s.", rig.c_str(), config_fn.c_str());
+        cfg.add("rig_name", rig);
+        cfg.write();
+    }
+    return rig;
+}
+
+///
+/// Does a config file ask for timing zones (trace, trace_json)? Defaults match Trackball's.
+///
+void traceParams(const string& config_fn, bool& trace, bool& trace_json)
+{
+    trace = true;
+    trace_json = false;
+    ConfigParser cfg;
+    if (cfg.read(config_fn) <= 0) { return; }
+    cfg.getBool("trace", trace);
+    cfg.getBool("trace_json", trace_json);
+}
+
 
 int main(int argc, char *argv[])
 {
+    /// The log file is opened by the first message, so this can't wait for the other args.
+    for (int i = 1; i < argc; ++i) {
+        if (string(argv[i]) == "--log-gz") { Logger::setFileCompression(true); }
+    }
+
      PRINT("///");
      PRINT("/// FicTrac:\tA webcam-based method for generating fictive paths.\n///");
-     PRINT("/// Usage:\tfictrac CONFIG_FN [-v LOG_VERBOSITY -s SRC_FN]\n///");
-     PRINT("/// \tCONFIG_FN\tPath to input config file (defaults to config.txt).");
+     PRINT("/// Usage:\tfictrac CONFIG_FN [CONFIG_FN ...] [-v LOG_VERBOSITY -vf FILE_VERBOSITY --log-gz -s SRC_FN]\n///");
+     PRINT("/// \tCONFIG_FN\tPath to input config file (defaults to config.txt). Give one per rig to track several rigs at once.");
      PRINT("/// \tLOG_VERBOSITY\t[Optional] One of DBG, INF, WRN, ERR.");
-     PRINT("/// \tSRC_FN\t\t[Optional] Override src_fn param in config file.");
+     PRINT("/// \tFILE_VERBOSITY\t[Optional] Log file verbosity, one of DBG (default), INF, WRN, ERR.");
+     PRINT("/// \t--log-gz\t[Optional] Compress the log file with gzip (*.log.gz).");
+     PRINT("/// \tSRC_FN\t\t[Optional] Override src_fn param in config file (single config file only).");
      PRINT("///");
      PRINT("/// Version: %d.%d.%d (build date: %s)", FICTRAC_VERSION_MAJOR, FICTRAC_VERSION_MIDDLE, FICTRAC_VERSION_MINOR, __DATE__);
      PRINT("///\n");
 
 	/// Parse args.
 	string log_level = "info";
-	string config_fn = "config.txt";
+    string file_log_level = "debug";
+	vector<string> config_fns;
     string src_fn = "";
     bool do_stats = false;
 	for (int i = 1; i < argc; ++i) {
@@ -48,9 +94,21 @@ int main(int argc, char *argv[])
 				return -1;
 			}
         }
+        else if ((string(argv[i]) == "--file-verbosity") || (string(argv[i]) == "-vf")) {
+            if (++i < argc) {
+                file_log_level = argv[i];
+            }
+            else {
+                LOG_ERR("-vf/--file-verbosity requires one argument (debug (default) < info < warn < error)!");
+                return -1;
+            }
+        }
         else if (string(argv[i]) == "--stats") {
             do_stats = true;
         }
+        else if (string(argv[i]) == "--log-gz") {
+            // already applied
+        }
         else if ((string(argv[i]) == "--src") || (string(argv[i]) == "-s")) {
             if (++i < argc) {
 				src_fn = argv[i];
@@ -61,12 +119,20 @@ int main(int argc, char *argv[])
 			}
         }
         else {
-            config_fn = argv[i];
+            config_fns.push_back(argv[i]);
 		}
 	}
+    if (config_fns.empty()) {
+        config_fns.push_back("config.txt");
+    }
+    if ((config_fns.size() > 1) && !src_fn.empty()) {
+        LOG_ERR("-s/--src can only be used with a single config file!");
+        return -1;
+    }
 
     /// Set logging level.
     Logger::setVerbosity(log_level);
+    Logger::setFileVerbosity(file_log_level);
 
 	// Catch cntl-c
     signal(SIGINT, ctrlcHandler);
@@ -78,29 +144,85 @@ int main(int argc, char *argv[])
         LOG("Set process priority to HIGH!");
     }
 
-    unique_ptr<Trackball> tracker = make_unique<Trackball>(config_fn, src_fn);
+    /// Several config files are tracked side by side, sharing one preprocessing pool and the logger.
+    shared_ptr<ThreadPool> pool;
+    vector<unique_ptr<Trackball>> trackers;
+    if (config_fns.size() == 1) {
+        trackers.push_back(make_unique<Trackball>(config_fns[0], src_fn));
+    }
+    else {
+        set<string> rigs;
+        for (auto& fn : config_fns) {
+            string rig = rigName(fn);
+            if (!rig.empty() && !rigs.insert(rig).second) {
+                LOG_ERR("Error! Rig name %s is used by more than one config file (set rig_name in %s).", rig.c_str(), fn.c_str());
+                return -1;
+            }
+        }
+
+        /// Tracing is process-wide, so it is started here for all rigs (if any rig asks for it) and reported once at the end.
+        bool trace = false, trace_json = false;
+        for (auto& fn : config_fns) {
+            bool t, j;
+            traceParams(fn, t, j);
+            trace |= t;
+            trace_json |= t && j;
+        }
+        if (trace) {
+            Trace::enable(trace_json ? (string("fictrac-trace-") + execTime() + ".json") : "");
+        }
+
+        /// Only rigs reading video files preprocess on the pool (live sources are preprocessed serially by each
+        /// rig's grab thread), so its threads aren't started unless one of them registers.
+        pool = make_shared<ThreadPool>(max<int>(thread::hardware_concurrency() - 1, 1), false);
+        for (auto& fn : config_fns) {
+            trackers.push_back(make_unique<Trackball>(fn, "", map<string, string>(), pool));
+        }
+        if (pool->users() > 0) {
+            LOG("Tracking %zu rigs (%d shared preprocessing threads for %d video file rigs)", trackers.size(), pool->size(), pool->users());
+        } else {
+            LOG("Tracking %zu rigs", trackers.size());
+        }
+    }
 
     /// Now Trackball has spawned our worker threads, we set this thread to low priority.
     SetThreadNormalPriority();
 
     /// Wait for tracking to finish.
-    while (tracker->isActive()) {
+    auto active = [&] { return any_of(trackers.begin(), trackers.end(), [](const unique_ptr<Trackball>& t) { return t->isActive(); }); };
+    while (active()) {
         if (!_active) {
-            tracker->terminate();
+            for (auto& t : trackers) { t->terminate(); }
         }
         ficsleep(250);
     }
 
-    /// Save the eventual template to disk.
-    tracker->writeTemplate();
+    for (auto& t : trackers) {
+        Logger::ScopedTag tag(t->rigName());
+
+        /// Save the eventual template to disk.
+        t->writeTemplate();
 
-    /// If we're running in test mode, print some stats.
-    if (do_stats) {
-        tracker->dumpStats();
+        /// If we're running in test mode, print some stats.
+        if (do_stats) {
+            t->dumpStats();
+        }
     }
 
     /// Try to force release of all objects.
-    tracker.reset();
+    const bool multi_rig = (trackers.size() > 1);
+    while (!trackers.empty()) {
+        trackers.pop_back();
+    }
+    pool.reset();
+
+    /// Timing zones of all rigs together (a single rig reports its own).
+    if (multi_rig && Trace::enabled()) {
+        Trace::disable();
+        PRINT("\n----------------------------------------------------------------------------");
+        LOG("Timing (all rigs):");
+        Trace::report();
+    }
 
     /// Wait a bit before exiting...
     ficsleep(250);
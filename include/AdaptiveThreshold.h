@@ -0,0 +1,49 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       AdaptiveThreshold.h
+/// \brief      Local adaptive thresholding of the remapped ROI image.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <memory>   // unique_ptr
+#include <cstdint>
+
+///
+/// Thresholds each masked pixel against the statistics of its neighbourhood window.
+/// Holds its own scratch buffers, so use one instance per thread.
+///
+class AdaptiveThreshold
+{
+public:
+    enum Mode {
+        MINMAX,     // min/max of the (blurred) window, cost grows with window size
+        MEAN        // mean of the window from masked integral images, constant cost per pixel
+    };
+
+    AdaptiveThreshold(const cv::Mat& mask, double ratio, int win, Mode mode = MINMAX);
+
+    /// Threshold grey image in place (0 = background, 255 = foreground, 128 = outside mask).
+    void apply(cv::Mat& grey);
+
+private:
+    void applyMinMax(cv::Mat& grey);
+    void applyMean(cv::Mat& grey);
+
+private:
+    const cv::Mat _mask;
+    int _w, _h;
+
+    double _ratio;
+    int _win, _rad;
+    Mode _mode;
+
+    /// MINMAX
+    cv::Mat _blur, _thresh_min, _thresh_max;
+    std::unique_ptr<uint8_t[]> _win_max_hist, _win_min_hist;
+
+    /// MEAN
+    cv::Mat _valid, _masked, _sum, _cnt;
+};
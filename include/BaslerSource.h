@@ -24,7 +24,7 @@ public:
     bool setFPS(double);
 
     bool rewind() { return false; };
-    bool grab(cv::Mat& frame);
+    bool grabNative(cv::Mat& frame, PIXEL_FORMAT& fmt);
 
     private:
     Pylon::CPylonImage _pylonImg;
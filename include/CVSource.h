@@ -23,11 +23,16 @@ public:
     virtual double getFPS();
 	virtual bool setFPS(double fps);
 	virtual bool rewind();
-	virtual bool grab(cv::Mat& frame);
+    virtual long getFrameCount();
+    virtual bool seek(long frame);
+	virtual bool grabNative(cv::Mat& frame, PIXEL_FORMAT& fmt);
 
 private:
 	std::shared_ptr<cv::VideoCapture> _cap;
 	cv::Mat _frame_cap;
 
     bool _is_image;
+
+    /// Playback pacing state (file sources only).
+    double _pace_prev_ts, _pace_av_fps, _pace_sleep_ms;
 };
@@ -0,0 +1,39 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       DataDecimator.h
+/// \brief      Per-output rate reduction of the data stream (every Nth frame, or aggregated over N frames).
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include "DataRecord.h"
+
+#include <string>
+#include <string_view>
+
+///
+/// Runs on a Recorder's writer thread (see Recorder::setTransform). Each input message is one binary DataRecord;
+/// one output message (text line or binary record) is produced every n records. Messages that aren't a single
+/// DataRecord (e.g. the binary file header) are passed through unchanged.
+///
+class DataDecimator
+{
+public:
+    enum Mode {
+        SKIP,   // latest of every n frames
+        SUM     // relative rotations (dr_cam, dr_lab) and dts summed over the n frames, worst err, latest everything else
+    };
+
+    /// text: format output as a text line (after prefix), otherwise output binary records.
+    DataDecimator(int n, Mode mode, bool text, bool lat_cols, std::string prefix = "");
+
+    /// Returns false if nothing should be written for this message.
+    bool operator()(std::string_view in, std::string& out);
+
+private:
+    int _n, _count;
+    Mode _mode;
+    bool _text, _lat_cols;
+    std::string _prefix;
+    DataRecord _acc;
+};
@@ -0,0 +1,84 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       DataRecord.h
+/// \brief      Fixed-size output data record, with text and binary (.bin) serialisation.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Increment whenever the record layout changes.
+const uint32_t DATA_RECORD_VERSION = 1;
+
+///
+/// One frame of output data, with fields in the same order as the columns in doc/data_header.txt.
+/// Every field is 8 bytes, so the struct has no padding and can be written to disk or a socket as is
+/// (little-endian; all supported platforms are little-endian).
+///
+struct DataRecord
+{
+    uint64_t cnt;               // 1
+    double dr_cam[3];           // 2-4
+    double err;                 // 5
+    double dr_lab[3];           // 6-8
+    double r_cam[3];            // 9-11
+    double r_lab[3];            // 12-14
+    double posx, posy;          // 15-16
+    double heading;             // 17
+    double step_dir, step_mag;  // 18-19
+    double intx, inty;          // 20-21
+    double ts;                  // 22
+    uint64_t seq;               // 23
+    double dts;                 // 24
+    double ms;                  // 25
+    double lat_deq, lat_opt, lat_out;   // 26-28 (text output only includes these if latency columns are enabled)
+
+    /// Upper bound on the length of a formatted text line.
+    static const size_t TEXT_MAX = 1024;
+
+    /// Format as a line of the text (.dat) output, including the trailing newline.
+    /// Writes at most len bytes to buf (no terminating NUL) and returns the number of bytes written.
+    /// Doubles are printed as "%.14g" (latency columns as "%.6g"), identical to the previous stream output.
+    size_t formatText(char* buf, size_t len, bool lat_cols) const;
+    std::string toText(bool lat_cols) const;
+};
+static_assert(sizeof(DataRecord) == 28 * 8, "DataRecord must be tightly packed");
+
+///
+/// Binary file header. Followed by ncols DataColumn entries and then back-to-back DataRecords.
+///
+struct DataHeader
+{
+    char magic[8];              // DATA_MAGIC
+    uint32_t version;           // DATA_RECORD_VERSION
+    uint32_t header_size;       // bytes from start of file to first record
+    uint32_t record_size;       // sizeof(DataRecord)
+    uint32_t ncols;
+    uint32_t flags;             // DATA_FLAG_*
+    uint32_t reserved;
+};
+static_assert(sizeof(DataHeader) == 32, "DataHeader must be tightly packed");
+
+struct DataColumn
+{
+    char name[20];              // NUL-terminated
+    uint32_t offset;            // byte offset within record
+    char type[8];               // "u64" or "f64"
+};
+static_assert(sizeof(DataColumn) == 32, "DataColumn must be tightly packed");
+
+extern const char DATA_MAGIC[8];
+const uint32_t DATA_FLAG_LAT_COLS = 1;     // latency columns (26-28) were enabled
+
+/// Column table for the current DataRecord layout.
+const std::vector<DataColumn>& dataColumns();
+
+/// Complete binary file header (DataHeader plus column table).
+std::string dataFileHeader(bool lat_cols);
+
+/// Parse and validate a binary file header. On success, lat_cols is set and header_size is the offset of the first record.
+bool parseDataFileHeader(const std::string& buf, bool& lat_cols, size_t& header_size, std::string& err);
@@ -8,19 +8,47 @@
 
 #include "RecorderInterface.h"
 
+#include <chrono>
 #include <fstream>  // ofstream
+#include <vector>
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
 
 class FileRecorder : public RecorderInterface
 {
 public:
-    FileRecorder();
+    /// Binary files are written byte-for-byte (no newline translation).
+    /// If the file name ends in .gz, the output is gzip-compressed (requires zlib).
+    FileRecorder(bool binary = false);
     ~FileRecorder();
 
     /// Interface to be overridden by implementations.
     bool openRecord(std::string fn = "");
-    bool writeRecord(std::string s);
+    bool writeRecord(std::string_view s);
+    bool writeRecords(const std::vector<std::string_view>& recs);
     void closeRecord();
 
+    /// Is gzip output available in this build?
+    static bool gzipSupported();
+
+private:
+    bool write(const char* data, size_t len);
+#ifdef WITH_ZLIB
+    bool deflateChunk(const char* data, size_t len, int flush);
+#endif
+
 private:
     std::ofstream _file;
+    std::vector<char> _buf;     // stream buffer, large enough that a batch is usually a single write
+    bool _binary;
+
+    /// gzip output.
+    bool _gzip;
+#ifdef WITH_ZLIB
+    z_stream _zs;
+    std::vector<char> _zbuf;
+    std::chrono::steady_clock::time_point _last_sync;
+#endif
 };
@@ -9,15 +9,23 @@
 #include "CameraModel.h"
 #include "CameraRemap.h"
 #include "FrameSource.h"
+#include "SPSCRing.h"
+#include "TripleBuffer.h"
+#include "ThreadPool.h"
+#include "AdaptiveThreshold.h"
 
 #include <opencv2/opencv.hpp>
 
 #include <memory>	// shared_ptr, unique_ptr
 #include <thread>
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
-#include <atomic>
+#include <map>
 #include <deque>
+#include <vector>
+#include <cstddef>  // size_t
+#include <cstdint>  // int64_t
 
 ///
 /// 
@@ -25,30 +33,86 @@
 class FrameGrabber
 {
 public:
+    /// Frame delivery policies.
+    enum DeliveryPolicy {
+        LATEST,         // grabbing never waits, tracker always gets the newest frame and older frames are dropped
+        BOUNDED,        // lossless, grabbing waits while the frame queue is full
+        UNBOUNDED       // lossless, grabbing never waits and frames queue without limit
+    };
+
+    /// Frame delivery statistics.
+    struct Stats {
+        unsigned long grabbed, dropped;
+        size_t q_depth, q_depth_max;
+    };
+
     FrameGrabber(   std::shared_ptr<FrameSource>    source,
                     CameraRemapPtr                  remapper,
                     const cv::Mat&                  remap_mask,
                     double                          thresh_ratio,
                     double                          thresh_win_pc,
                     std::string                     thresh_rgb_transform = "grey",
+                    AdaptiveThreshold::Mode         thresh_mode = AdaptiveThreshold::MINMAX,
+                    DeliveryPolicy                  policy = BOUNDED,
                     int                             max_buf_len = 1,
-                    int                             max_frame_cnt = -1
+                    int                             max_frame_cnt = -1,
+                    WaitEvent::Policy               wait_policy = WaitEvent::SPIN_BLOCK,
+                    int                             proc_threads = 0,
+                    std::shared_ptr<ThreadPool>     pool = nullptr,
+                    long                            start_frame = 0
     );
     ~FrameGrabber();
 
+    /// Without a source, no grab thread is started and the caller preprocesses its own frames instead.
+    /// frame is only read (never copied or retained). Returns false if the frame is the wrong size.
+    bool preprocessFrame(const cv::Mat& frame, PIXEL_FORMAT fmt, cv::Mat& remap);
+
     void terminate();
     
-    bool getFrameSet(cv::Mat& frame, cv::Mat& remap, double& timestamp, double& ms_since_midnight, bool latest = true);
-    bool getLatestFrameSet(cv::Mat& frame, cv::Mat& remap, double& timestamp, double& ms_since_midnight) {
-        return getFrameSet(frame, remap, timestamp, ms_since_midnight, true);
-    }
-    bool getNextFrameSet(cv::Mat& frame, cv::Mat& remap, double& timestamp, double& ms_since_midnight) {
-        return getFrameSet(frame, remap, timestamp, ms_since_midnight, false);
-    }
+    /// Frames are returned in the source's native pixel format (see FrameSource::toBGR).
+    /// Returns false once the source has finished and all queued frames have been returned.
+    /// t_grab is the monotonic time (Trace::now, ns) at which the frame was captured.
+    bool getFrameSet(cv::Mat& frame, PIXEL_FORMAT& fmt, cv::Mat& remap, double& timestamp, double& ms_since_midnight, int64_t& t_grab);
+
+    Stats getStats();
+
+    /// Only pass full source frames downstream when something needs them (e.g. display, raw video).
+    /// Otherwise grab buffers are recycled and getFrameSet returns an empty frame.
+    void keepSourceFrames(bool keep) { _keep_src = keep; }
+
+    /// Pin the grab thread, and preprocessing threads unless the pool is shared, to the given CPUs.
+    bool setAffinity(const std::vector<int>& cpus);
 
 private:
+    /// Processed frame.
+    struct FrameSet {
+        cv::Mat frame, remap;
+        PIXEL_FORMAT fmt;
+        double ts, ms;
+        int64_t t_grab;     // monotonic capture time (ns)
+    };
+
+    /// Per-thread preprocessing scratch.
+    struct Worker {
+        cv::Mat frame_grey, frame_bgr;
+        std::unique_ptr<AdaptiveThreshold> thresh;
+    };
+
     /// Worker function.
     void process();
+    void preprocess(const cv::Mat& frame, PIXEL_FORMAT fmt, cv::Mat& remap_grey, Worker& worker);
+
+    /// Grab buffer recycling (when source frames aren't kept).
+    cv::Mat getGrabBuffer();
+    void recycleGrabBuffer(cv::Mat& frame);
+
+    /// Output queue helpers.
+    bool deliver(FrameSet&& fs);
+    bool deliverReady(std::unique_lock<std::mutex>& l);
+    bool nextReady() const { return !_reorder_buf.empty() && (_reorder_buf.begin()->first == _next_seq); }
+    int maxInflight() const;
+    void flushOverflow();
+    void closeQueue();
 
     std::shared_ptr<FrameSource> _source;
     CameraRemapPtr _remapper;
@@ -58,7 +122,8 @@ private:
     const cv::Mat _remap_mask;
 
     double _thresh_ratio;
-    int _thresh_win, _thresh_rad;
+    int _thresh_win;
+    AdaptiveThreshold::Mode _thresh_mode;
     enum {
         GREY,
         RED,
@@ -66,15 +131,35 @@ private:
         BLUE
     } _thresh_rgb_transform;
 
+    DeliveryPolicy _policy;
     int _max_buf_len, _max_frame_cnt;
+    long _start_frame;
 
     /// Thread stuff.
-    std::atomic_bool _active;
+    std::atomic_bool _active, _keep_src;
     std::unique_ptr<std::thread> _thread;
-    std::mutex _qMutex;
-    std::condition_variable _qCond;
 
-    /// Output queues.
-    std::deque<cv::Mat> _frame_q, _remap_q;
-    std::deque<double> _ts_q, _ms_q;
+    /// Output queue.
+    std::unique_ptr<SPSCRing<FrameSet>> _frame_q;         // BOUNDED/UNBOUNDED
+    std::unique_ptr<TripleBuffer<FrameSet>> _latest_q;    // LATEST
+    std::deque<FrameSet> _overflow_q;                     // UNBOUNDED, producer side only
+
+    /// Recycled grab buffers.
+    std::vector<cv::Mat> _grab_bufs;
+    std::mutex _grab_buf_mutex;
+
+    /// Statistics.
+    std::atomic<unsigned long> _ngrabbed, _ndropped;
+    std::atomic<size_t> _noverflow, _q_depth_max;
+
+    /// Parallel preprocessing (non-live sources only).
+    std::vector<Worker> _workers;
+    std::shared_ptr<ThreadPool> _pool;      // own pool, or one shared with other grabbers
+    bool _pool_shared;
+    std::map<unsigned int, FrameSet> _reorder_buf;
+    unsigned int _next_seq;
+    int _proc_threads;      // <= 0 for an even share of a shared pool
+    int _inflight;
+    std::mutex _reorder_mutex;
+    std::condition_variable _inflight_cond;
 };
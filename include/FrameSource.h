@@ -10,6 +10,9 @@
 
 enum BAYER_TYPE { BAYER_NONE, BAYER_RGGB, BAYER_GRBG, BAYER_GBRG, BAYER_BGGR };
 
+/// Native pixel formats delivered by grabNative().
+enum PIXEL_FORMAT { PIXEL_BGR8, PIXEL_MONO8, PIXEL_BAYER_RGGB, PIXEL_BAYER_GRBG, PIXEL_BAYER_GBRG, PIXEL_BAYER_BGGR };
+
 class FrameSource {
 public:
 	FrameSource() : _open(false), _bayerType(BAYER_NONE), _width(-1), _height(-1), _timestamp(-1), _fps(-1), _live(true) {}
@@ -21,7 +24,20 @@ public:
         return false;   // we haven't actually done anything
     }
 	virtual bool rewind()=0;
-	virtual bool grab(cv::Mat& frame)=0;
+
+    /// Number of frames the source will deliver, or -1 if unknown (e.g. cameras).
+    virtual long getFrameCount() { return -1; }
+
+    /// Position the source so the next grab returns the given (zero-based) frame.
+    /// Sources that can't seek only support going back to the start.
+    virtual bool seek(long frame) { return (frame == 0) && rewind(); }
+
+    /// Capture frame in the source's native pixel format (CV_8UC1 for mono/Bayer, CV_8UC3 for BGR).
+    /// frame should not share data with any other Mat, as sources may decode straight into it.
+    virtual bool grabNative(cv::Mat& frame, PIXEL_FORMAT& fmt)=0;
+
+    /// Capture frame and convert to BGR.
+    virtual bool grab(cv::Mat& frame);
 
 	bool isOpen() { return _open; }
 	int getWidth() { return _width; }
@@ -31,6 +47,14 @@ public:
 	void setBayerType(BAYER_TYPE bayer_type) { _bayerType = bayer_type; }
     bool isLive() { return _live; }
 
+    /// Pixel format conversions. dst may share data with src if no conversion is required.
+    static void toBGR(const cv::Mat& src, PIXEL_FORMAT fmt, cv::Mat& dst);
+    static void toGrey(const cv::Mat& src, PIXEL_FORMAT fmt, cv::Mat& dst);
+
+protected:
+    /// Format of single channel frames, according to the configured Bayer type.
+    PIXEL_FORMAT monoFormat() const;
+
 protected:
 	bool _open;
 	BAYER_TYPE _bayerType;
@@ -0,0 +1,44 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       LatencyHist.h
+/// \brief      Fixed-size log-linear histogram for timing statistics.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+///
+/// Histogram of non-negative values (typically ms) with ~3% relative resolution and constant-time insertion.
+/// Values are quantised to multiples of unit, then binned by their top 5 significant bits,
+/// so mean/min/max are exact and percentiles are accurate to within one bin.
+/// Not thread-safe; use one histogram per thread and merge().
+///
+class LatencyHist
+{
+public:
+    LatencyHist(double unit = 1e-3);
+
+    void add(double val);
+    void merge(const LatencyHist& other);
+    void reset();
+
+    uint64_t count() const { return _count; }
+    double mean() const { return _count > 0 ? _sum / _count : 0; }
+    double min() const { return _count > 0 ? _min : 0; }
+    double max() const { return _count > 0 ? _max : 0; }
+
+    /// Value below which pc percent of values fall (pc in [0,100]).
+    double percentile(double pc) const;
+
+private:
+    static unsigned int bin(uint64_t q);
+    double binValue(unsigned int b) const;
+
+private:
+    double _unit;
+    std::vector<uint64_t> _bins;
+    uint64_t _count;
+    double _sum, _min, _max;
+};
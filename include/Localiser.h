@@ -28,6 +28,9 @@ public:
 
     double search(cv::Mat& roi_frame, cv::Mat& R_roi, CmPoint64f& vx);
 
+    /// Match error for a single relative rotation, as tested during search().
+    double evaluate(const cv::Mat& roi_frame, const cv::Mat& R_roi, const CmPoint64f& vx);
+
 private:
     double testRotation(const double x[3]);
     virtual double objective(unsigned n, const double* x, double* grad) { return testRotation(x); }
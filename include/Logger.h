@@ -1,43 +1,61 @@
 /// FicTrac http://rjdmoore.net/fictrac/
 /// \file       Logger.h
-/// \brief      Simple thread-safe logger.
+/// \brief      Thread-safe logger with deferred formatting.
 /// \author     Richard Moore
 /// \copyright  CC BY-NC-SA 3.0
 
 #pragma once
 
-#include "Recorder.h"
-
-#include <mutex>
-#include <memory>   // unique_ptr
+#include <algorithm>    // min
+#include <cstdint>
+#include <cstdio>   // snprintf
+#include <cstring>  // memcpy, strlen
+#include <functional>
 #include <string>
-#include <fstream>  // ofstream
-
-#define LOG(fmt, ...) Logger::mprintf(Logger::INF, __FUNCTION__, fmt, ##__VA_ARGS__)    // ## required for gcc?
-#define LOG_DBG(fmt, ...) Logger::mprintf(Logger::DBG, __FUNCTION__, fmt, ##__VA_ARGS__)
-#define LOG_WRN(fmt, ...) Logger::mprintf(Logger::WRN, __FUNCTION__, fmt, ##__VA_ARGS__)
-#define LOG_ERR(fmt, ...) Logger::mprintf(Logger::ERR, __FUNCTION__, fmt, ##__VA_ARGS__)
-#define PRINT(fmt, ...) Logger::mprintf(Logger::PRT, __FUNCTION__, fmt, ##__VA_ARGS__)
+#include <tuple>
+#include <type_traits>
 
+/// The level is tested before the arguments are evaluated, so disabled messages cost a load and a branch.
+#define LOG_AT(lvl, fmt, ...) do { if (Logger::enabled(lvl)) { Logger::log(lvl, __FUNCTION__, fmt, ##__VA_ARGS__); } } while (0)
 
+#define LOG(fmt, ...) LOG_AT(Logger::INF, fmt, ##__VA_ARGS__)    // ## required for gcc?
+#define LOG_DBG(fmt, ...) LOG_AT(Logger::DBG, fmt, ##__VA_ARGS__)
+#define LOG_WRN(fmt, ...) LOG_AT(Logger::WRN, fmt, ##__VA_ARGS__)
+#define LOG_ERR(fmt, ...) LOG_AT(Logger::ERR, fmt, ##__VA_ARGS__)
+#define PRINT(fmt, ...) LOG_AT(Logger::PRT, fmt, ##__VA_ARGS__)
 
+///
+/// Messages are not formatted on the calling thread. Instead, log() copies the format string pointer and the raw
+/// arguments into a fixed-size record on a per-thread ring, and a background thread formats and writes them.
+/// Format strings passed to the LOG macros must therefore be string literals (anything else is formatted
+/// immediately). String arguments (char*) are copied; all other pointers are logged by value.
+///
 class Logger
 {
 public:
     // logger verbosity level
     enum LogLevel { DBG, INF, WRN, ERR, PRT };
-    const char * const LogLevelStrings[4] = { "DBG", "INF", "WRN", "ERR" };
+
+    /// Record sizes.
+    static const size_t ARG_BYTES = 448;        // raw arguments, including copied strings
+    static const size_t MSG_MAX = 1024;         // formatted message (longer messages are truncated)
 
     /// Delete the copy constructors we wish to block (public decs give better compiler error msgs)
     Logger(Logger const&) = delete;
     void operator=(Logger const&) = delete;
 
-    /// Get/set verbosity
+    /// Get/set verbosity (console)
     static LogLevel& verbosity() {
         static LogLevel v = INF;   // default to INF
         return v;
     };
 
+    /// Get/set verbosity of the log file (defaults to everything)
+    static LogLevel& fileVerbosity() {
+        static LogLevel v = DBG;
+        return v;
+    };
+
     /// Verbosity helper functions
     static void setVerbosity(LogLevel v) {
         verbosity() = v;
@@ -45,16 +63,216 @@ public:
 
     static void setVerbosity(std::string v);
 
-    /// Thread-safe printf wrapper
-    static void mprintf(LogLevel lvl, std::string func, std::string format, ...);
+    static void setFileVerbosity(LogLevel v) {
+        fileVerbosity() = v;
+    }
 
-private:
-    /// Hidden constructor to prevent direct instantiation
-    Logger();
-    ~Logger();
+    static void setFileVerbosity(std::string v);
+
+    /// Get/set gzip compression of the log file (requires zlib). The log file is opened by the first message,
+    /// so this must be set before anything is logged.
+    static bool& fileCompression() {
+        static bool gz = false;
+        return gz;
+    };
+
+    static void setFileCompression(bool gz) {
+        fileCompression() = gz;
+    }
+
+    /// Direct mode (e.g. when embedded in another application): no log file or writer thread is ever created.
+    /// Messages at or above the console verbosity are formatted on the calling thread and passed to sink
+    /// (or written to cout if there is none). The sink is called from whichever thread logs. Must be set before
+    /// anything is logged.
+    typedef std::function<void(LogLevel lvl, const char* msg)> Sink;
+    static bool& direct() {
+        static bool d = false;
+        return d;
+    };
+
+    static void setDirect(Sink sink = nullptr);
+
+    /// Would a message at this level be written anywhere?
+    static bool enabled(LogLevel lvl) {
+        return (lvl == PRT) || (lvl >= verbosity()) || (!direct() && (lvl >= fileVerbosity()));
+    }
+
+    /// Queue a message for formatting (see LOG macros)
+    template<typename F, typename... Args>
+    static void log(LogLevel lvl, const char* func, const F& fmt, Args... args);
+
+    /// Block until all messages logged so far have been written.
+    static void flush();
+
+    /// Name shown in front of every message logged from the calling thread (e.g. the rig name when several
+    /// trackers share this process). New threads start untagged, so pass threadTag() on to threads you start.
+    static void setThreadTag(const std::string& tag);
+    static std::string threadTag();
+
+    /// Tags the calling thread until it goes out of scope, then restores the previous tag.
+    class ScopedTag
+    {
+    public:
+        ScopedTag(const std::string& tag) : _prev(threadTag()) { setThreadTag(tag); }
+        ~ScopedTag() { setThreadTag(_prev); }
+
+        ScopedTag(ScopedTag const&) = delete;
+        void operator=(ScopedTag const&) = delete;
+
+    private:
+        std::string _prev;
+    };
+
+public:
+    typedef int (*FormatFn)(char* buf, size_t len, const char* fmt, const char* args);
+
+    /// One queued message.
+    struct Record {
+        double t;               // elapsed_secs() when logged
+        LogLevel lvl;
+        bool to_cout, to_file;
+        const char* func;       // __FUNCTION__ (static storage)
+        const char* tag;        // "[tag] " prefix, or empty (owned by the logger)
+        const char* fmt;        // string literal
+        FormatFn format;        // decodes args for this call's argument types
+        alignas(8) char args[ARG_BYTES];
+    };
 
 private:
-    std::unique_ptr<Recorder> _log;
-    std::unique_ptr<Recorder> _cout;
-    std::mutex _pMutex;
+    /// Static interface only
+    Logger() = delete;
+
+    /// Stamp rec and hand it to the logging thread.
+    static void push(Record& rec);
 };
+
+///
+/// Argument encoding. Arguments are stored as their printf-promoted types, packed in call order.
+/// Strings are stored as a 16-bit offset to a copy at the end of the args block.
+///
+namespace logger_detail {
+
+struct Str {};
+
+template<typename T>
+auto promote(T v)
+{
+    if constexpr (std::is_enum_v<T>) { return promote(static_cast<std::underlying_type_t<T>>(v)); }
+    else if constexpr (std::is_same_v<T, bool> || (std::is_integral_v<T> && (sizeof(T) < sizeof(int)))) { return static_cast<int>(v); }
+    else if constexpr (std::is_floating_point_v<T>) { return static_cast<double>(v); }
+    else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>) { return static_cast<const void*>(v); }
+    else {
+        static_assert(std::is_arithmetic_v<T>, "LOG arguments must be arithmetic, enums, strings (char*) or pointers");
+        return v;
+    }
+}
+
+template<typename T>
+using Stored = std::conditional_t<
+    std::is_same_v<std::decay_t<T>, char*> || std::is_same_v<std::decay_t<T>, const char*>,
+    Str, decltype(promote(std::declval<std::decay_t<T>>()))>;
+
+/// Argument as passed to printf when formatting immediately.
+template<typename T>
+auto vararg(T v)
+{
+    if constexpr (std::is_same_v<Stored<T>, Str>) { return static_cast<const char*>(v); }
+    else { return promote(v); }
+}
+
+template<typename S> constexpr size_t fixedSize() { return sizeof(S); }
+template<> constexpr size_t fixedSize<Str>() { return sizeof(uint16_t); }
+
+const uint16_t NO_STR = 0xFFFF;
+
+template<typename S, typename T>
+inline void put(char*& p, char*& strs, char* end, T v)
+{
+    if constexpr (std::is_same_v<S, Str>) {
+        const char* s = v ? v : "(null)";
+        uint16_t off = NO_STR;
+        size_t room = end - strs;
+        if (room > 0) {
+            size_t n = std::min(strlen(s), room - 1);
+            memcpy(strs, s, n);
+            strs[n] = '\0';
+            off = static_cast<uint16_t>(strs - (end - Logger::ARG_BYTES));
+            strs += n + 1;
+        }
+        memcpy(p, &off, sizeof(off));
+        p += sizeof(off);
+    }
+    else {
+        S s = promote(v);
+        memcpy(p, &s, sizeof(s));
+        p += sizeof(s);
+    }
+}
+
+template<typename S>
+inline auto get(const char*& p, const char* args)
+{
+    if constexpr (std::is_same_v<S, Str>) {
+        uint16_t off;
+        memcpy(&off, p, sizeof(off));
+        p += sizeof(off);
+        return (off == NO_STR) ? "" : args + off;
+    }
+    else {
+        S s;
+        memcpy(&s, p, sizeof(s));
+        p += sizeof(s);
+        return s;
+    }
+}
+
+template<typename... S>
+int format(char* buf, size_t len, const char* fmt, const char* args)
+{
+    if constexpr (sizeof...(S) == 0) {
+        return snprintf(buf, len, fmt);
+    }
+    else {
+        const char* p = args;
+        std::tuple<decltype(get<S>(p, args))...> vals{ get<S>(p, args)... };   // braced init is evaluated in order
+        return std::apply([&](auto... v) { return snprintf(buf, len, fmt, v...); }, vals);
+    }
+}
+
+}   // namespace logger_detail
+
+template<typename F, typename... Args>
+void Logger::log(LogLevel lvl, const char* func, const F& fmt, Args... args)
+{
+    using namespace logger_detail;
+
+    Record rec;
+    rec.lvl = lvl;
+    rec.func = func;
+
+    if constexpr (std::is_array_v<F>) {
+        constexpr size_t fixed = (size_t(0) + ... + fixedSize<Stored<Args>>());
+        static_assert(fixed <= ARG_BYTES, "Too many LOG arguments");
+
+        char* p = rec.args;
+        char* strs = rec.args + fixed;
+        char* end = rec.args + ARG_BYTES;
+        (put<Stored<Args>>(p, strs, end, args), ...);
+        rec.fmt = fmt;
+        rec.format = &format<Stored<Args>...>;
+    }
+    else {
+        /// Not a literal, so it may not outlive this call: format now and queue the result as a string.
+        char buf[MSG_MAX];
+        const std::string f(fmt);
+        if constexpr (sizeof...(Args) == 0) { snprintf(buf, sizeof(buf), f.c_str()); }
+        else { snprintf(buf, sizeof(buf), f.c_str(), vararg(args)...); }
+        char* p = rec.args;
+        char* strs = rec.args + fixedSize<Str>();
+        put<Str>(p, strs, rec.args + ARG_BYTES, static_cast<const char*>(buf));
+        rec.fmt = "%s";
+        rec.format = &format<Str>;
+    }
+
+    push(rec);
+}
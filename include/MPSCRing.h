@@ -0,0 +1,139 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       MPSCRing.h
+/// \brief      Lock-free bounded multi-producer/single-consumer ring buffer.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include "WaitEvent.h"
+
+#include <atomic>
+#include <cstddef>  // size_t, ptrdiff_t
+#include <memory>   // unique_ptr
+#include <utility>  // move
+
+///
+/// Bounded ring buffer for handing items from any number of producer threads to exactly one consumer thread.
+/// Each slot carries a sequence number, so producers claim slots with a single CAS and never wait on each other
+/// while a slot is being filled (D. Vyukov's bounded queue). Slots are allocated up front.
+/// After close(), push fails immediately and pop keeps returning items until the ring is empty.
+///
+template<typename T>
+class MPSCRing
+{
+public:
+    MPSCRing(size_t capacity, WaitEvent::Policy policy = WaitEvent::BLOCK)
+        : _tail(0), _head(0), _closed(false), _not_empty(policy), _not_full(policy)
+    {
+        size_t n = 2;
+        while (n < capacity) { n <<= 1; }
+        _slots.reset(new Slot[n]);
+        for (size_t i = 0; i < n; i++) { _slots[i].seq.store(i, std::memory_order_relaxed); }
+        _mask = n - 1;
+    }
+
+    /// Delete the copy constructors we wish to block (public decs give better compiler error msgs)
+    MPSCRing(MPSCRing const&) = delete;
+    void operator=(MPSCRing const&) = delete;
+
+    size_t capacity() const { return _mask + 1; }
+    size_t size() const { return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire); }
+    bool closed() const { return _closed.load(std::memory_order_acquire); }
+
+    ///
+    /// Producer: add item if there is space. item is only moved from on success.
+    ///
+    bool tryPush(T&& item)
+    {
+        if (closed()) { return false; }
+        size_t pos = _tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &_slots[pos & _mask];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            ptrdiff_t dif = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos);
+            if (dif == 0) {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            }
+            else if (dif < 0) {
+                return false;   // full
+            }
+            else {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+        slot->item = std::move(item);
+        slot->seq.store(pos + 1, std::memory_order_release);
+        _not_empty.notify();
+        return true;
+    }
+
+    ///
+    /// Producer: wait for space, then add item. Returns false if the ring was closed.
+    ///
+    bool push(T&& item)
+    {
+        while (!tryPush(std::move(item))) {
+            if (closed()) { return false; }
+            _not_full.wait([&] { return closed() || (size() < capacity()); });
+        }
+        return true;
+    }
+
+    ///
+    /// Consumer: take the oldest item, if any.
+    ///
+    bool tryPop(T& item)
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        Slot& slot = _slots[head & _mask];
+        if (slot.seq.load(std::memory_order_acquire) != head + 1) { return false; }
+        item = std::move(slot.item);
+        slot.item = T();    // release slot resources now rather than when overwritten
+        slot.seq.store(head + _mask + 1, std::memory_order_release);
+        _head.store(head + 1, std::memory_order_release);
+        _not_full.notify();
+        return true;
+    }
+
+    ///
+    /// Consumer: wait up to timeout_ms (< 0 waits forever) for an item.
+    /// Returns true if an item is ready, false on timeout or once closed and drained.
+    ///
+    bool waitNotEmpty(long timeout_ms = -1)
+    {
+        auto ready = [&] {
+            const size_t head = _head.load(std::memory_order_relaxed);
+            return _slots[head & _mask].seq.load(std::memory_order_acquire) == head + 1;
+        };
+        _not_empty.wait([&] { return ready() || closed(); }, timeout_ms);
+        return ready();
+    }
+
+    ///
+    /// Either side: refuse further pushes and wake any waiting threads.
+    ///
+    void close()
+    {
+        _closed.store(true, std::memory_order_release);
+        _not_empty.notify();
+        _not_full.notify();
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> seq;
+        T item;
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask;
+
+    /// Keep producer and consumer indices on separate cache lines.
+    alignas(64) std::atomic<size_t> _tail;      // producers
+    alignas(64) std::atomic<size_t> _head;      // consumer
+    alignas(64) std::atomic<bool> _closed;
+
+    WaitEvent _not_empty, _not_full;
+};
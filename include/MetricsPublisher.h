@@ -0,0 +1,78 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       MetricsPublisher.h
+/// \brief      Periodic metrics snapshots over UDP, or served over TCP, as Prometheus text or JSON.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include <boost/asio.hpp>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>   // unique_ptr
+#include <string>
+#include <utility>  // pair
+#include <vector>
+
+///
+/// Publishes a snapshot of named values on its own thread.
+/// UDP: a snapshot datagram is sent to host:port every period.
+/// TCP: listens on host:port and answers each connection (e.g. curl or a Prometheus scrape) with a fresh snapshot
+/// wrapped in a minimal HTTP response.
+///
+class MetricsPublisher
+{
+public:
+    enum Transport { UDP, TCP };
+    enum Format { PROMETHEUS, JSON };
+
+    struct Metric {
+        std::string name;
+        std::vector<std::pair<std::string, std::string>> labels;
+        double value;
+    };
+    typedef std::vector<Metric> Metrics;
+
+    MetricsPublisher(std::function<Metrics()> snapshot, Transport transport, std::string host, int port,
+        Format format = PROMETHEUS, int period_ms = 1000, std::string prefix = "fictrac_");
+    ~MetricsPublisher();
+
+    /// Delete the copy constructors we wish to block (public decs give better compiler error msgs)
+    MetricsPublisher(MetricsPublisher const&) = delete;
+    void operator=(MetricsPublisher const&) = delete;
+
+    bool is_active() { return _active; }
+
+    /// Prometheus text exposition: one `<prefix><name>{label="value",...} <value>` line per metric.
+    static std::string formatPrometheus(const Metrics& metrics, const std::string& prefix);
+
+    /// Single-line JSON object, nested by metric name and then by label values.
+    static std::string formatJSON(const Metrics& metrics);
+
+private:
+    void run();
+    std::string snapshot();
+    void sendDatagram();
+    void serveClients();
+
+private:
+    std::function<Metrics()> _snapshot;
+    Transport _transport;
+    Format _format;
+    std::string _host, _prefix;
+    int _port, _period_ms;
+
+    boost::asio::io_service _io_service;
+    std::unique_ptr<boost::asio::ip::udp::socket> _udp;
+    boost::asio::ip::udp::endpoint _endpoint;
+    std::unique_ptr<boost::asio::ip::tcp::acceptor> _acceptor;
+
+    std::atomic_bool _active;
+    std::unique_ptr<std::thread> _thread;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+};
@@ -27,7 +27,7 @@ public:
     virtual double getFPS();
 	virtual bool setFPS(double fps);
     virtual bool rewind() { return false; };
-	virtual bool grab(cv::Mat& frame);
+	virtual bool grabNative(cv::Mat& frame, PIXEL_FORMAT& fmt);
 
 private:
 #if defined(PGR_USB3)
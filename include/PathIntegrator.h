@@ -0,0 +1,40 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       PathIntegrator.h
+/// \brief      Integrate per-frame ball rotations into heading and fictive path.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include "CmPoint.h"
+
+///
+/// Accumulates lab-frame rotations (one per frame) into running speed/direction, integrated x/y ("optical mouse"
+/// style), heading and heading-corrected 2D position. Used by the tracker, and to re-integrate stitched data.
+///
+class PathIntegrator
+{
+public:
+    struct State {
+        double velx = 0, vely = 0;          // running speed (rad/frame)
+        double step_mag = 0, step_dir = 0;  // magnitude and direction of running speed, excluding turning
+        double intx = 0, inty = 0;          // integrated x/y
+        double heading = 0;                 // integrated heading [0,2pi)
+        double posx = 0, posy = 0;          // integrated 2D position
+        double ang_dist = 0;                // total heading rotation
+    };
+
+    PathIntegrator() : _prev_heading(0) {}
+
+    /// Restart heading and position at zero. Integrated x/y carry on (they don't depend on heading).
+    void reset();
+
+    /// Integrate the lab-frame rotation (angle-axis, rad) from the previous frame to this one.
+    const State& update(const CmPoint64f& dr_lab);
+
+    const State& state() const { return _s; }
+
+private:
+    State _s;
+    double _prev_heading;
+};
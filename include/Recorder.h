@@ -7,38 +7,93 @@
 #pragma once
 
 #include "RecorderInterface.h"
+#include "LatencyHist.h"
+#include "MPSCRing.h"
 
 #include <thread>
 #include <mutex>
-#include <condition_variable>
 #include <atomic>
-#include <memory>   // unique_ptr
-#include <deque>
+#include <cstdint>  // int64_t
+#include <functional>
+#include <memory>   // unique_ptr, shared_ptr
 #include <string>
+#include <string_view>
+#include <vector>
 
 
+///
+/// Asynchronous writer. Messages are queued on a bounded lock-free ring by any number of threads, and a writer
+/// thread drains everything pending into a single batched write (one buffered write/flush for files and serial,
+/// one sendmmsg for UDP sockets).
+///
 class Recorder
 {
 public:
-    Recorder(RecorderInterface::RecordType type, std::string fn = "");
+    /// What addMsg does when the message ring is full.
+    enum Overflow {
+        BLOCK,      // wait for the writer to catch up (lossless)
+        DROP        // discard the message and count it (never stalls the caller)
+    };
+
+    /// binary only applies to FILE recorders. For SHM recorders, q_len is also the length of the shared ring,
+    /// and for SOCK_SERVER recorders it is also the length of each client's queue.
+    Recorder(RecorderInterface::RecordType type, std::string fn = "", bool binary = false,
+        size_t q_len = 4096, Overflow overflow = BLOCK);
     ~Recorder();
 
     bool is_active() { return _active; }
     RecorderInterface::RecordType type() { return _record->type(); }
 
     /// Add msg to msgQ for async writing.
-    bool addMsg(std::string msg);
+    /// If t_ref (Trace::now, ns) is given, the time from t_ref until msg has been written (for socket servers, until it
+    /// has been sent to each client) is added to the latency histogram.
+    bool addMsg(std::string msg, int64_t t_ref = -1);
+
+    /// Add a shared buffer to msgQ without copying it (the same buffer may be queued on several recorders).
+    /// Only the bytes from offset onwards are written. The buffer must not be modified while it is still referenced.
+    bool addMsg(std::shared_ptr<const std::string> buf, size_t offset = 0, int64_t t_ref = -1);
+
+    /// Minimum interval between writes (ms). Messages arriving in the meantime are written in one batch.
+    /// 0 (default) writes as soon as messages arrive.
+    void setFlushInterval(int ms) { _flush_ms = ms; }
+
+    /// Rewrite each message on the writer thread before it is written (e.g. DataDecimator).
+    /// Return false to write nothing for that message. Must be set before the first addMsg.
+    typedef std::function<bool(std::string_view in, std::string& out)> Transform;
+    void setTransform(Transform transform) { _transform = transform; }
+
+    /// Number of messages discarded because the ring was full (DROP only).
+    unsigned long dropped() const { return _ndropped; }
+
+    /// Copy of the write latency histogram (ms).
+    LatencyHist getLatency();
+
+    /// Pin the writer thread to the given CPUs.
+    bool setAffinity(const std::vector<int>& cpus);
 
 private:
+    struct Msg {
+        std::shared_ptr<const std::string> buf;
+        size_t offset;
+        int64_t t_ref;
+    };
+
     void processMsgQ();
 
 private:
     std::atomic<bool> _active;
+    std::atomic<int> _flush_ms;
+    Transform _transform;
+    Overflow _overflow;
+    std::atomic<unsigned long> _ndropped;
 
     std::unique_ptr<RecorderInterface> _record;
 
     std::unique_ptr<std::thread> _thread;
-    std::deque<std::string> _msgQ;
-    std::mutex _qMutex;
-    std::condition_variable _qCond;
+    MPSCRing<Msg> _msgQ;
+    WaitEvent _stop;
+
+    LatencyHist _latency;
+    std::mutex _latMutex;
+    bool _async_latency;    // latency is reported by _record once sent
 };
@@ -6,7 +6,12 @@
 
 #pragma once
 
+#include <cstdint>  // int64_t
+#include <functional>
+#include <memory>   // shared_ptr
 #include <string>
+#include <string_view>
+#include <vector>
 
 class RecorderInterface
 {
@@ -16,11 +21,13 @@ public:
         TERM,
         FILE,
         SOCK,
-        COM
+        COM,
+        SHM,
+        SOCK_SERVER
     };
 
     RecorderInterface() : _open(false), _type(CLOSED) {}
-    ~RecorderInterface() { _open = false; _type = CLOSED; } // just to make sure
+    virtual ~RecorderInterface() { _open = false; _type = CLOSED; } // just to make sure
 
     /// Delete the copy constructors we wish to block (public decs give better compiler error msgs)
     RecorderInterface(RecorderInterface const&) = delete;
@@ -31,9 +38,34 @@ public:
 
     /// Interface to be overridden by implementations.
     virtual bool openRecord(std::string f = "") = 0;
-    virtual bool writeRecord(std::string s) = 0;
+    virtual bool writeRecord(std::string_view s) = 0;
     virtual void closeRecord() = 0;
 
+    /// Write several records at once. Implementations override this to batch the underlying syscalls.
+    virtual bool writeRecords(const std::vector<std::string_view>& recs)
+    {
+        bool ret = true;
+        for (auto& s : recs) { ret &= writeRecord(s); }
+        return ret;
+    }
+
+    /// As writeRecords, where each record lies within a shared buffer (bufs[i], or null if it doesn't).
+    /// Implementations that hold on to records after returning (e.g. to send asynchronously) can keep the buffer
+    /// instead of copying the record. t_refs[i] (Trace::now, ns, or -1) is passed to the sent handler once recs[i]
+    /// has actually been sent.
+    typedef std::shared_ptr<const std::string> Buffer;
+    virtual bool writeSharedRecords(const std::vector<std::string_view>& recs, const std::vector<Buffer>& /*bufs*/,
+        const std::vector<int64_t>& /*t_refs*/)
+    {
+        return writeRecords(recs);
+    }
+
+    /// Implementations that send records after writeSharedRecords returns call the handler (from their own thread)
+    /// with the t_refs of each batch once it has been sent, and return true here. Others return false, and records
+    /// count as written when writeSharedRecords returns.
+    typedef std::function<void(const std::vector<int64_t>& t_refs, int64_t t_sent)> SentHandler;
+    virtual bool setSentHandler(SentHandler /*handler*/) { return false; }
+
 protected:
     bool _open;
     RecordType _type;
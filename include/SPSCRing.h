@@ -0,0 +1,172 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       SPSCRing.h
+/// \brief      Wait-free single-producer/single-consumer ring buffer.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include "WaitEvent.h"
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <utility>  // move
+#include <vector>
+
+///
+/// Bounded ring buffer for handing items from exactly one producer thread to exactly one consumer thread.
+/// tryPush/tryPop never block and never take a lock; the blocking variants spin and/or sleep on a WaitEvent
+/// and only cost the other side a syscall when it is actually asleep.
+/// After close(), push fails immediately and pop keeps returning items until the ring is empty.
+///
+template<typename T>
+class SPSCRing
+{
+public:
+    SPSCRing(size_t capacity, WaitEvent::Policy policy = WaitEvent::SPIN_BLOCK)
+        : _head(0), _tail(0), _closed(false), _head_cache(0), _tail_cache(0),
+        _not_empty(policy), _not_full(policy)
+    {
+        _limit = capacity > 0 ? capacity : 1;
+        size_t n = 1;
+        while (n < _limit) { n <<= 1; }
+        _buf.resize(n);
+        _mask = n - 1;
+    }
+
+    /// Delete the copy constructors we wish to block (public decs give better compiler error msgs)
+    SPSCRing(SPSCRing const&) = delete;
+    void operator=(SPSCRing const&) = delete;
+
+    size_t capacity() const { return _limit; }
+    size_t size() const { return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+    bool closed() const { return _closed.load(std::memory_order_acquire); }
+
+    void setWaitPolicy(WaitEvent::Policy policy)
+    {
+        _not_empty.setPolicy(policy);
+        _not_full.setPolicy(policy);
+    }
+
+    ///
+    /// Producer: add item if there is space.
+    ///
+    bool tryPush(T&& item)
+    {
+        if (closed()) { return false; }
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if ((tail - _head_cache) >= _limit) {
+            _head_cache = _head.load(std::memory_order_acquire);
+            if ((tail - _head_cache) >= _limit) { return false; }
+        }
+        _buf[tail & _mask] = std::move(item);
+        _tail.store(tail + 1, std::memory_order_release);
+        _not_empty.notify();
+        return true;
+    }
+
+    ///
+    /// Producer: wait for space, then add item. Returns false if the ring was closed.
+    ///
+    bool push(T&& item)
+    {
+        waitForSpace();
+        return tryPush(std::move(item));
+    }
+
+    ///
+    /// Producer: wait until there is space for another item. Returns false if the ring was closed.
+    ///
+    bool waitForSpace()
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        _not_full.wait([&] {
+            return closed() || ((tail - _head.load(std::memory_order_acquire)) < _limit);
+        });
+        return !closed();
+    }
+
+    ///
+    /// Consumer: take the oldest item, if any.
+    ///
+    bool tryPop(T& item)
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail_cache) {
+            _tail_cache = _tail.load(std::memory_order_acquire);
+            if (head == _tail_cache) { return false; }
+        }
+        item = std::move(_buf[head & _mask]);
+        _buf[head & _mask] = T();   // release slot resources now rather than when overwritten
+        _head.store(head + 1, std::memory_order_release);
+        _not_full.notify();
+        return true;
+    }
+
+    ///
+    /// Consumer: wait for an item, then take the oldest. Returns false once closed and drained.
+    ///
+    bool pop(T& item)
+    {
+        waitNotEmpty();
+        return tryPop(item);
+    }
+
+    ///
+    /// Consumer: wait for an item, then take the newest and discard any older items.
+    /// Returns false once closed and drained. ndropped is set to the number of discarded items.
+    ///
+    bool popLatest(T& item, size_t& ndropped)
+    {
+        ndropped = 0;
+        waitNotEmpty();
+
+        size_t head = _head.load(std::memory_order_relaxed);
+        _tail_cache = _tail.load(std::memory_order_acquire);
+        if (head == _tail_cache) { return false; }
+
+        for (; head + 1 < _tail_cache; head++, ndropped++) {
+            _buf[head & _mask] = T();
+        }
+        item = std::move(_buf[head & _mask]);
+        _buf[head & _mask] = T();
+        _head.store(head + 1, std::memory_order_release);
+        _not_full.notify();
+        return true;
+    }
+
+    ///
+    /// Either side: refuse further pushes and wake any waiting threads.
+    ///
+    void close()
+    {
+        _closed.store(true, std::memory_order_release);
+        _not_empty.notify();
+        _not_full.notify();
+    }
+
+private:
+    void waitNotEmpty()
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        _not_empty.wait([&] {
+            return (_tail.load(std::memory_order_acquire) != head) || closed();
+        });
+    }
+
+private:
+    std::vector<T> _buf;
+    size_t _mask, _limit;
+
+    /// Keep producer and consumer indices on separate cache lines.
+    alignas(64) std::atomic<size_t> _head;
+    alignas(64) std::atomic<size_t> _tail;
+    alignas(64) std::atomic<bool> _closed;
+
+    /// Cached copies of the other side's index (each only touched by one thread).
+    alignas(64) size_t _head_cache;     // producer
+    alignas(64) size_t _tail_cache;     // consumer
+
+    WaitEvent _not_empty, _not_full;
+};
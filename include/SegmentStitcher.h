@@ -0,0 +1,36 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       SegmentStitcher.h
+/// \brief      Join data tracked from overlapping segments of one video into a single data file.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+///
+/// Joins binary data files (out_fmt : bin) tracked from overlapping segments of the same video.
+/// Where segments overlap, the earlier segment's frames are kept and the later segment takes over after the
+/// earlier segment's last frame. The later segment's absolute orientations are re-referenced so they agree at
+/// the last frame both segments tracked, and heading and fictive path are re-integrated across the whole
+/// output, so the result reads like a single run over the video. Tracking resets within a segment are
+/// carried through as they would have been in a single run.
+///
+class SegmentStitcher
+{
+public:
+    struct Segment {
+        std::string fn;             // uncompressed binary data file
+        long start;                 // video frame tracked as the segment's frame 0 (src_start)
+    };
+
+    struct Stats {
+        unsigned long nrecs = 0;        // records written
+        unsigned long nresets = 0;      // tracking resets carried through from the segments
+        unsigned long nunmatched = 0;   // joins with no frame tracked by both segments (orientation may jump there)
+    };
+
+    /// Segments must be in order of start frame. Output is binary or text, and gzip-compressed if out_fn ends in .gz.
+    static bool stitch(const std::vector<Segment>& segs, const std::string& out_fn, bool binary, Stats& stats);
+};
@@ -15,6 +15,7 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 
 class SerialRecorder : public RecorderInterface
 {
@@ -24,10 +25,12 @@ public:
 
     /// Interface to be overridden by implementations.
     bool openRecord(std::string port_baud);
-    bool writeRecord(std::string s);
+    bool writeRecord(std::string_view s);
+    bool writeRecords(const std::vector<std::string_view>& recs);
     void closeRecord();
 
 private:
     std::string _port_name;
     std::shared_ptr<boost::asio::serial_port> _port;
+    std::vector<boost::asio::const_buffer> _bufs;
 };
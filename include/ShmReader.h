@@ -0,0 +1,162 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       ShmReader.h
+/// \brief      Shared-memory output layout, and a header-only reader for local consumers.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include "DataRecord.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>  // memcpy, memcmp
+#include <string>
+
+#if !defined(_WIN32)
+#include <fcntl.h>      // O_RDONLY
+#include <sys/mman.h>   // shm_open, mmap
+#include <sys/stat.h>   // fstat
+#include <unistd.h>     // close
+#endif
+
+///
+/// Layout of the shared-memory segment: a ShmHeader, then capacity ShmSlots (capacity is a power of two).
+/// Record n (counting from 0) is written to slot n % capacity. Each slot has its own sequence counter
+/// (seqlock): it is odd while the slot is being written and 2 * (n + 1) once record n is complete, so
+/// readers never block the writer and can always tell whether the copy they took is consistent.
+///
+const char SHM_MAGIC[8] = { 'F', 'I', 'C', 'T', 'R', 'A', 'C', 'S' };
+const uint32_t SHM_VERSION = 1;
+
+struct alignas(64) ShmHeader
+{
+    char magic[8];                  // SHM_MAGIC
+    uint32_t version;               // SHM_VERSION
+    uint32_t record_version;        // DATA_RECORD_VERSION
+    uint32_t header_size;           // bytes from start of segment to first slot
+    uint32_t slot_size;             // sizeof(ShmSlot)
+    uint32_t capacity;              // number of slots
+    uint32_t reserved;
+    std::atomic<uint32_t> live;     // 1 while FicTrac is writing, 0 once it has closed the output
+
+    alignas(64) std::atomic<uint64_t> count;    // records published so far
+};
+
+struct alignas(64) ShmSlot
+{
+    std::atomic<uint64_t> seq;
+    uint64_t reserved;
+    DataRecord rec;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared-memory output requires lock-free 64-bit atomics");
+
+///
+/// Read-only view of a FicTrac shared-memory output (see shm_name). No locks, no syscalls after open().
+///
+class ShmReader
+{
+public:
+    ShmReader() : _hdr(nullptr), _slots(nullptr), _size(0) {}
+    ~ShmReader() { close(); }
+
+    /// Delete the copy constructors we wish to block (public decs give better compiler error msgs)
+    ShmReader(ShmReader const&) = delete;
+    void operator=(ShmReader const&) = delete;
+
+    ///
+    /// Map the named segment (same name as the shm_name config parameter). Returns false if it doesn't
+    /// exist (yet) or isn't a compatible FicTrac output.
+    ///
+    bool open(std::string name)
+    {
+        close();
+#if defined(_WIN32)
+        return false;
+#else
+        if (name.empty() || (name[0] != '/')) { name = "/" + name; }
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) { return false; }
+
+        struct stat st;
+        void* p = MAP_FAILED;
+        if ((fstat(fd, &st) == 0) && (static_cast<size_t>(st.st_size) >= sizeof(ShmHeader))) {
+            _size = static_cast<size_t>(st.st_size);
+            p = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (p == MAP_FAILED) { return false; }
+
+        _hdr = static_cast<const ShmHeader*>(p);
+        if ((memcmp(_hdr->magic, SHM_MAGIC, sizeof(SHM_MAGIC)) != 0) || (_hdr->version != SHM_VERSION) ||
+            (_hdr->record_version != DATA_RECORD_VERSION) || (_hdr->slot_size != sizeof(ShmSlot)) ||
+            (_hdr->capacity == 0) || ((_hdr->capacity & (_hdr->capacity - 1)) != 0) ||
+            (_hdr->header_size + static_cast<size_t>(_hdr->capacity) * sizeof(ShmSlot) > _size))
+        {
+            close();
+            return false;
+        }
+        _slots = reinterpret_cast<const ShmSlot*>(reinterpret_cast<const char*>(p) + _hdr->header_size);
+        return true;
+#endif
+    }
+
+    void close()
+    {
+#if !defined(_WIN32)
+        if (_hdr) { munmap(const_cast<ShmHeader*>(_hdr), _size); }
+#endif
+        _hdr = nullptr;
+        _slots = nullptr;
+        _size = 0;
+    }
+
+    bool is_open() const { return _hdr != nullptr; }
+
+    /// False once FicTrac has closed this output (a new run creates a new segment, so re-open to follow it).
+    bool live() const { return _hdr && (_hdr->live.load(std::memory_order_acquire) != 0); }
+
+    /// Number of records published so far. The newest is count() - 1.
+    uint64_t count() const { return _hdr ? _hdr->count.load(std::memory_order_acquire) : 0; }
+
+    /// Number of most recent records that are kept.
+    uint32_t capacity() const { return _hdr ? _hdr->capacity : 0; }
+
+    ///
+    /// Copy record idx. Returns false if it hasn't been written yet or has already been overwritten.
+    ///
+    bool read(uint64_t idx, DataRecord& rec) const
+    {
+        if (!_hdr) { return false; }
+        const ShmSlot& slot = _slots[idx & (_hdr->capacity - 1)];
+        const uint64_t want = 2 * (idx + 1);
+        uint64_t s1 = slot.seq.load(std::memory_order_acquire);
+        if (s1 != want) { return false; }
+        memcpy(&rec, &slot.rec, sizeof(rec));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.seq.load(std::memory_order_relaxed) == s1;
+    }
+
+    ///
+    /// Copy the newest record. Returns false if nothing has been published yet.
+    ///
+    bool latest(DataRecord& rec, uint64_t* idx = nullptr) const
+    {
+        for (int attempt = 0; attempt < 8; attempt++) {
+            uint64_t n = count();
+            if (n == 0) { return false; }
+            if (read(n - 1, rec)) {
+                if (idx) { *idx = n - 1; }
+                return true;
+            }
+            // only fails if the writer lapped us mid-copy, so the next attempt sees a newer count
+        }
+        return false;
+    }
+
+private:
+    const ShmHeader* _hdr;
+    const ShmSlot* _slots;
+    size_t _size;
+};
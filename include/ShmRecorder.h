@@ -0,0 +1,37 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       ShmRecorder.h
+/// \brief      Implementation of shared-memory recorder.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include "RecorderInterface.h"
+#include "ShmReader.h"
+
+#include <string>
+
+///
+/// Publishes binary DataRecords into a POSIX shared-memory ring (layout in ShmReader.h).
+/// Writes are wait-free (a memcpy and two atomic stores), so this can be called straight from the tracking thread.
+///
+class ShmRecorder : public RecorderInterface
+{
+public:
+    ShmRecorder(uint32_t capacity = 1024);
+    ~ShmRecorder();
+
+    /// Interface to be overridden by implementations.
+    /// name is the segment name, e.g. "fictrac" (a leading '/' is added if missing).
+    bool openRecord(std::string name);
+    /// s must be exactly one DataRecord.
+    bool writeRecord(std::string_view s);
+    void closeRecord();
+
+private:
+    std::string _name;
+    uint32_t _capacity;
+    ShmHeader* _hdr;
+    ShmSlot* _slots;
+    size_t _size;
+};
@@ -20,6 +20,13 @@
 
 #include <boost/asio.hpp>
 
+#ifdef __linux__
+#include <sys/socket.h> // mmsghdr
+#include <sys/uio.h>    // iovec
+#endif
+
+#include <vector>
+
 class SocketRecorder : public RecorderInterface
 {
 public:
@@ -28,7 +35,8 @@ public:
 
     /// Interface to be overridden by implementations.
     bool openRecord(std::string host_port);
-    bool writeRecord(std::string s);
+    bool writeRecord(std::string_view s);
+    bool writeRecords(const std::vector<std::string_view>& recs);
     void closeRecord();
 
 private:
@@ -38,6 +46,12 @@ private:
     boost::asio::io_service _io_service;
     boost::asio::ip::udp::socket _socket;
     boost::asio::ip::udp::endpoint _endpoint;
+
+#ifdef __linux__
+    /// sendmmsg scratch.
+    std::vector<mmsghdr> _msgs;
+    std::vector<iovec> _iovs;
+#endif
 };
 
 #endif
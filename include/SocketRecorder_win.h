@@ -19,7 +19,7 @@ public:
 
     /// Interface to be overridden by implementations.
     bool openRecord(std::string port);
-    bool writeRecord(std::string s);
+    bool writeRecord(std::string_view s);
     void closeRecord();
 
 private:
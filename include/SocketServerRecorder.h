@@ -0,0 +1,82 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       SocketServerRecorder.h
+/// \brief      Implementation of stream socket (TCP/Unix domain) server recorder based on boost::asio.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include "RecorderInterface.h"
+
+#include <boost/asio.hpp>
+
+#include <deque>
+#include <list>
+#include <memory>   // shared_ptr, unique_ptr
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+///
+/// Listens for any number of subscribers and streams every record to each of them.
+/// Each client has its own bounded queue: if a client can't keep up, its oldest records are dropped,
+/// so a slow client never holds up the other clients or the caller. All socket i/o runs asynchronously
+/// on the recorder's own io thread.
+///
+class SocketServerRecorder : public RecorderInterface
+{
+public:
+    SocketServerRecorder(size_t client_q_len = 256);
+    ~SocketServerRecorder();
+
+    /// Interface to be overridden by implementations.
+    /// addr is either "tcp://host:port" (host is the address to bind) or "unix://path".
+    bool openRecord(std::string addr);
+    bool writeRecord(std::string_view s);
+    bool writeRecords(const std::vector<std::string_view>& recs);
+    bool writeSharedRecords(const std::vector<std::string_view>& recs, const std::vector<Buffer>& bufs,
+        const std::vector<int64_t>& t_refs);
+    bool setSentHandler(SentHandler handler);
+    void closeRecord();
+
+private:
+    typedef boost::asio::generic::stream_protocol Protocol;
+    typedef boost::asio::basic_socket_acceptor<Protocol> Acceptor;
+
+    /// Queued record, sharing the caller's buffer.
+    struct Rec {
+        Buffer buf;                 // keeps data alive
+        std::string_view data;
+        int64_t t_ref;              // -1 if not timed
+    };
+
+    struct Client {
+        Client(boost::asio::io_service& io) : sock(io), writing(false), ndropped(0) {}
+        Protocol::socket sock;
+        std::string name;
+        std::deque<Rec> queue;      // waiting to be sent
+        std::vector<Rec> sending;   // held until the current write completes
+        bool writing;
+        unsigned long ndropped;
+    };
+    typedef std::shared_ptr<Client> ClientPtr;
+
+    void startAccept();
+    void startWrite(ClientPtr c);
+    void dropClient(ClientPtr c, std::string why);
+
+private:
+    std::string _addr, _unix_path;
+    size_t _client_q_len;
+
+    boost::asio::io_service _io_service;
+    std::unique_ptr<boost::asio::io_service::work> _work;
+    std::unique_ptr<Acceptor> _acceptor;
+    std::unique_ptr<std::thread> _thread;
+    SentHandler _sent;
+
+    std::mutex _mutex;      // guards _clients and their queues
+    std::list<ClientPtr> _clients;
+    unsigned long _nclients;    // connections so far (for naming clients)
+};
@@ -0,0 +1,81 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       SyntheticSource.h
+/// \brief      Renders a textured, rotating sphere with known motion (for benchmarking without cameras).
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include "FrameSource.h"
+#include "CameraModel.h"
+#include "CmPoint.h"
+#include "Recorder.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <memory>   // unique_ptr
+#include <random>
+#include <string>
+#include <vector>
+
+///
+/// Frame source that renders a textured sphere through the same camera models used for tracking.
+/// The sphere is driven by a constant, random (Ornstein-Uhlenbeck) or scripted angular velocity profile, and the
+/// true rotation of every frame can be logged to file.
+/// Rotations are given in the tracker's camera frame (i.e. the same frame as data file columns 2-4).
+///
+class SyntheticSource : public FrameSource {
+public:
+    struct Params {
+        int width = 640, height = 480;
+        double vfov = 45 * CM_D2R;      // vertical field of view (rad)
+        bool fisheye = false;
+        CmPoint64f roi_c = CmPoint64f(0, 0, 1);     // sphere centre direction (camera coords)
+        double roi_r = 0.25;            // sphere angular radius (rad)
+        double fps = 100;               // frame rate used for timestamps and motion
+        int nframes = 1000;             // frames before end of stream (<= 0 for no limit)
+        unsigned int seed = 0;          // texture, noise, and motion seed
+        CmPoint64f omega = CmPoint64f(1.0, 3.0, 0.5);   // mean angular velocity (rad/s)
+        double omega_sd = 0;            // random angular velocity variation (rad/s)
+        std::string omega_fn;           // optional per-frame angular velocity profile (rad/s, one "x y z" line per frame)
+        double noise = 2;               // image noise std dev (grey levels)
+        bool realtime = false;          // pace frames to fps, like a camera
+    };
+
+    SyntheticSource(const Params& params);
+    virtual ~SyntheticSource();
+
+    virtual bool rewind();
+    virtual long getFrameCount() { return (_params.nframes > 0) ? _params.nframes : -1; }
+    virtual bool grabNative(cv::Mat& frame, PIXEL_FORMAT& fmt);
+
+    /// Log ground truth for every grabbed frame (frame, dr_cam[3], r_cam[3], timestamp).
+    bool openGroundTruthLog(std::string fn);
+
+private:
+    void makeTexture();
+    CmPoint64f nextOmega();
+
+private:
+    Params _params;
+    CameraModelPtr _model;
+
+    /// Pre-computed per-pixel sphere surface normals (tracker camera frame) and shading.
+    std::vector<int> _pix_idx;
+    std::vector<double> _pix_n;
+    std::vector<float> _pix_shade;
+
+    /// Sphere texture (equirectangular, sphere body coords).
+    cv::Mat _texture;
+    std::vector<float> _noise;
+
+    /// Motion state.
+    std::mt19937 _rng;
+    std::vector<CmPoint64f> _omega_profile;
+    CmPoint64f _omega;
+    double _R[9];
+    unsigned int _cnt;
+    double _t_start, _ms_start;
+
+    std::unique_ptr<Recorder> _gt_log;
+};
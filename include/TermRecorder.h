@@ -16,7 +16,8 @@ public:
 
     /// Interface to be overridden by implementations.
     bool openRecord(std::string ignore = "") { _open = true; return true; }
-    bool writeRecord(std::string s);
+    bool writeRecord(std::string_view s);
+    bool writeRecords(const std::vector<std::string_view>& recs);
     void closeRecord() { _open = false; };
 
 private:
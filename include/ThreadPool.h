@@ -0,0 +1,67 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       ThreadPool.h
+/// \brief      Fixed-size pool of worker threads.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>  // max
+#include <functional>
+#include <memory>   // unique_ptr
+#include <deque>
+#include <vector>
+
+///
+/// Runs queued tasks on a fixed set of worker threads.
+/// Each task is passed the index [0,size()) of the worker running it, so callers can keep per-worker scratch
+/// storage without any locking (a worker only ever runs one task at a time).
+///
+class ThreadPool
+{
+public:
+    typedef std::function<void(int)> Task;
+
+    /// If start is false, no threads are started (and queued tasks wait) until start() or the first addUser() is called.
+    ThreadPool(int nthreads, bool start = true);
+    ~ThreadPool();
+
+    /// Delete the copy constructors we wish to block (public decs give better compiler error msgs)
+    ThreadPool(ThreadPool const&) = delete;
+    void operator=(ThreadPool const&) = delete;
+
+    int size() const { return _nthreads; }
+
+    /// Start the worker threads (if they aren't already running).
+    void start();
+
+    /// Queue task for execution. Returns false if the pool is shutting down.
+    bool push(Task task);
+
+    /// Pin all workers to the given CPUs.
+    bool setAffinity(const std::vector<int>& cpus);
+
+    /// Users sharing the pool (e.g. several frame grabbers) register themselves, so each can default to an even share.
+    void addUser() { _users++; start(); }
+    void removeUser() { _users--; }
+    int users() const { return _users; }
+
+    /// Number of workers each registered user should keep busy (at least 1).
+    int share() const { return std::max(size() / std::max(_users.load(), 1), 1); }
+
+private:
+    void work(int id);
+
+private:
+    bool _active;
+    int _nthreads;
+    std::vector<std::unique_ptr<std::thread>> _threads;
+    std::deque<Task> _taskQ;
+    std::mutex _qMutex;
+    std::condition_variable _qCond;
+    std::atomic<int> _users;
+};
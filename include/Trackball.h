@@ -10,8 +10,13 @@
 #include "Localiser.h"
 #include "CameraModel.h"
 #include "Recorder.h"
+#include "ShmRecorder.h"
 #include "FrameGrabber.h"
 #include "ConfigParser.h"
+#include "LatencyHist.h"
+#include "MetricsPublisher.h"
+#include "PathIntegrator.h"
+#include "DataRecord.h"
 
 /// OpenCV individual includes required by gcc?
 #include <opencv2/highgui.hpp>
@@ -24,9 +29,14 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <cstdint>  // int64_t
 #include <deque>
+#include <map>
+#include <string>
 #include <vector>
 
+class SyntheticSource;
+
 ///
 /// Estimate track ball orientation and update surface map.
 ///
@@ -44,6 +54,7 @@ public:
         CmPoint64f dr_lab, r_lab;
         cv::Mat R_lab;
         double ts, ms;
+        int64_t t_grab, t_deq, t_opt;   // monotonic time (Trace::now, ns) of capture, dequeue, and optimisation end
 
         double velx, vely, step_mag, step_dir, intx, inty, heading, posx, posy;
 
@@ -56,7 +67,8 @@ public:
             dr_roi(CmPoint64f(0, 0, 0)), r_roi(CmPoint64f(0, 0, 0)),
             dr_cam(CmPoint64f(0, 0, 0)), r_cam(CmPoint64f(0, 0, 0)),
             dr_lab(CmPoint64f(0, 0, 0)), r_lab(CmPoint64f(0, 0, 0)),
-            ts(-1),
+            ts(-1), ms(-1),
+            t_grab(0), t_deq(0), t_opt(0),
             velx(0), vely(0),
             step_mag(0), step_dir(0),
             intx(0), inty(0),
@@ -75,7 +87,8 @@ public:
             dr_roi(d.dr_roi), r_roi(d.r_roi),
             dr_cam(d.dr_cam), r_cam(d.r_cam),
             dr_lab(d.dr_lab), r_lab(d.r_lab),
-            ts(d.ts),
+            ts(d.ts), ms(d.ms),
+            t_grab(d.t_grab), t_deq(d.t_deq), t_opt(d.t_opt),
             velx(d.velx), vely(d.vely),
             step_mag(d.step_mag), step_dir(d.step_dir),
             intx(d.intx), inty(d.inty),
@@ -90,20 +103,58 @@ public:
         }
     };
 
+    /// Tracking loop statistics (per-stage timing is recorded by Trace zones).
+    struct Timing {
+        LatencyHist evals = LatencyHist(1);     // optimiser evaluations per frame (first frame excluded)
+        unsigned long nframes = 0, nbad = 0;
+        long src_frames = -1;           // frames the source will deliver (and max_frame_cnt allows), if known
+        double elapsed_ms = 0;          // from end of first frame to end of last frame
+        double fps_in = 0, fps_out = 0; // most recent frame
+        double err = 0;                 // most recent optimiser error
+        FrameGrabber::Stats grabber = {};
+
+        /// End-to-end latency (ms) measured from frame capture.
+        LatencyHist lat_deq, lat_opt;                   // to dequeue by tracker, to end of optimisation
+        std::map<std::string, LatencyHist> lat_write;   // to written by each output (file/sock/com)
+        unsigned long lat_over = 0;                     // frames exceeding lat_budget_ms (grab to optimisation end)
+        std::map<std::string, unsigned long> out_dropped;   // lines dropped by each output (out_overflow : drop)
+    };
+
 public:
-    Trackball(std::string cfg_fn, std::string src_override = "");
+    /// cfg_override values replace those in the config file, and the config file is then left unmodified.
+    /// Several instances can run side by side; pass the same pool to each to share frame preprocessing threads.
+    Trackball(std::string cfg_fn, std::string src_override = "", const std::map<std::string, std::string>& cfg_override = {},
+        std::shared_ptr<ThreadPool> pool = nullptr);
+
+    /// Embedded tracker (see Tracker.h), configured from params held in memory. There is no frame source, no outputs,
+    /// display or threads: frames of the given size are passed to track() and tracked in the caller's thread.
+    Trackball(const std::map<std::string, std::string>& cfg, int width, int height);
     ~Trackball();
 
+    /// Embedded trackers only. Returns true and fills rec if the frame was tracked (bad frames have no data).
+    bool track(const cv::Mat& frame, PIXEL_FORMAT fmt, double ts, DataRecord& rec);
+
     bool isActive() { return _active; }
+    const std::string& rigName() const { return _rig_name; }
     void terminate() { _kill = true; }
+    void requestReset() { _do_reset = true; }
     std::shared_ptr<Trackball::DATA> getState();
     void dumpStats();
+    Timing getTiming();
+    MetricsPublisher::Metrics getMetrics();
+
+    /// Accumulate thresholded ROI into sphere map (the map update step of the tracking loop).
+    static int updateSphereMap(const cv::Mat& roi_frame, const cv::Mat& roi_mask, const std::vector<double>& p1s_lut,
+        const cv::Mat& R_roi, const CameraModelPtr& sphere_model, cv::Mat& sphere_map, int& good);
     bool writeTemplate(std::string fn = "");
 
 private:
     /// Worker function.
     void process();
 
+    std::shared_ptr<SyntheticSource> makeSyntheticSource();
+    bool initTracking(int width, int height);
+
     void resetData();
     void reset();
     double testRotation(const double x[3]);
@@ -111,13 +162,18 @@ private:
     bool doSearch(bool allow_global);
     void updateSphere();
     void updatePath();
+    bool trackFrame(DataRecord* rec);
+    void makeRecord(DataRecord& rec);
     bool logData();
+    std::shared_ptr<std::string> getOutputBuffer();
 
 private:
     /// Drawing
     struct DrawData {
         unsigned int log_frame;
-        cv::Mat src_frame, roi_frame, sphere_view, sphere_map;
+        cv::Mat src_frame, roi_frame, sphere_map;
+        PIXEL_FORMAT src_fmt;
+        cv::Mat sphere_view_roi, sphere_view_R;     // last frame mapped onto sphere
         CmPoint64f dr_roi;
         cv::Mat R_roi;
         std::deque<cv::Mat> R_roi_hist;
@@ -127,13 +183,23 @@ private:
     bool updateCanvasAsync(std::shared_ptr<DrawData> data);
     void processDrawQ();
     void drawCanvas(std::shared_ptr<DrawData> data);
+    void drawSphereView(const cv::Mat& roi_frame, const cv::Mat& R_roi, cv::Mat& sphere_view);
 
     std::vector<std::shared_ptr<DrawData>> _drawQ;
     std::mutex _drawMutex;
     std::condition_variable _drawCond;
 
+    /// Canvas and scratch images, only touched by the draw thread.
+    struct DrawState {
+        cv::Mat canvas, mapX, mapY, prev_roi, warp_roi, diff_roi;
+        cv::Mat resize_roi, resize_diff, resize_view, resize_map;
+        CameraModelPtr camera;
+        CameraRemapPtr remapper;
+    } _draw;
+    std::string _window_name;
+
     bool _do_display, _save_raw, _save_debug;
-    cv::Mat _sphere_view;
+    cv::Mat _sphere_view_roi, _sphere_view_R;
     std::deque<cv::Mat> _R_roi_hist;
     std::deque<CmPoint64f> _pos_heading_hist;
     cv::VideoWriter _debug_vid, _raw_vid;
@@ -146,6 +212,7 @@ private:
     /// Camera models and remapping.
     CameraModelPtr _src_model, _roi_model, _sphere_model;
     RemapTransformPtr _cam_to_roi;
+    CameraRemapPtr _remapper;
     cv::Mat _roi_to_cam_R, _cam_to_lab_R;
     std::shared_ptr<std::vector<double>> _p1s_lut;
 
@@ -153,8 +220,13 @@ private:
     int _map_w, _map_h;
     int _roi_w, _roi_h;
     cv::Mat _src_frame, _roi_frame, _roi_mask;
+    PIXEL_FORMAT _src_fmt;
     cv::Mat _sphere_map, _sphere_template;
 
+    /// Thresholding.
+    double _thresh_ratio, _thresh_win_pc;
+    AdaptiveThreshold::Mode _thresh_mode;
+
     /// Sphere vars.
     double _sphere_rad, _r_d_ratio;
     CmPoint64f _sphere_c;
@@ -164,7 +236,13 @@ private:
     double _error_thresh, _err;
     bool _do_global_search;
     int _max_bad_frames;
+    int _nbad;                  // consecutive bad frames
     int _nevals;
+    CmPoint64f _guess;          // low-pass filtered rotation, used as the next search's starting point
+
+    /// Path integration.
+    PathIntegrator _path;
+    double _prev_log_ts;
 
     /// Program.
     bool _init, _reset, _clean_map;
@@ -173,10 +251,22 @@ private:
     DATA _data;
 
     /// Data i/o.
+    std::string _rig_name;      // tags log messages and output file names when several rigs share a process
     std::string _base_fn;
     std::unique_ptr<FrameGrabber> _frameGrabber;
     bool _do_sock_output, _do_com_output;
     std::unique_ptr<Recorder> _data_log, _data_sock, _data_com, _vid_frames;
+    std::unique_ptr<ShmRecorder> _data_shm;     // written directly from the tracking thread (wait-free)
+    bool _out_bin, _lat_cols;
+    bool _decim_log, _decim_sock, _decim_com;   // output formats its own (decimated) data from binary records
+    std::vector<std::shared_ptr<std::string>> _out_bufs;    // output line buffers, shared by all recorders
+    double _lat_budget_ms;
+    std::unique_ptr<MetricsPublisher> _metrics;
+    bool _trace;                // this instance enabled (and so disables) tracing
+
+    /// Timing.
+    Timing _timing;
+    std::mutex _timing_mutex;
 
     /// Thread stuff.
     std::atomic_bool _active, _kill, _do_reset;
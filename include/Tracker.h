@@ -0,0 +1,65 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       Tracker.h
+/// \brief      Embeddable tracker (libfictrac): frames are pushed in by the caller and tracked in-process.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include "DataRecord.h"
+#include "FrameSource.h"    // PIXEL_FORMAT
+
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>   // unique_ptr
+#include <string>
+
+class Trackball;
+
+///
+/// Sphere tracking for applications that acquire their own frames.
+/// Configured with the same params as a config file, held in memory. No frame source, output files (including the
+/// log file), sockets, display or threads are created: each call to track() preprocesses and tracks one frame in
+/// the calling thread and returns its data directly.
+///
+class Tracker
+{
+public:
+    /// Called from within track() with the data for each tracked frame.
+    typedef std::function<void(const DataRecord& rec)> Callback;
+
+    /// Receives log messages (e.g. warnings about params left at their defaults) instead of the console.
+    /// level is 0 (debug) to 3 (error), or 4 for plain console text.
+    typedef std::function<void(int level, const char* msg)> LogSink;
+
+    /// Must be called before the first Tracker is constructed.
+    static void setLogSink(LogSink sink);
+
+    /// cfg holds config params (see doc/params.md). width and height are the size of the frames passed to track().
+    Tracker(const std::map<std::string, std::string>& cfg, int width, int height);
+    ~Tracker();
+
+    /// False if the params were invalid.
+    bool isOpen() const;
+
+    /// Track one frame. data points to the first pixel and stride is the number of bytes between rows
+    /// (3 bytes per pixel for PIXEL_BGR8, otherwise 1). The frame is read in place and not retained after the call.
+    /// ts is the frame timestamp (ms). Returns true and fills rec if the frame was tracked; bad frames have no data.
+    bool track(const uint8_t* data, size_t stride, PIXEL_FORMAT fmt, double ts, DataRecord& rec);
+    bool track(const uint8_t* data, size_t stride, PIXEL_FORMAT fmt, double ts);
+
+    void setCallback(Callback cb) { _cb = cb; }
+
+    /// Restart orientation, heading and path from the next frame.
+    void reset();
+
+    /// Save the current sphere map, e.g. to use as sphere_map_fn next time.
+    bool writeTemplate(const std::string& fn);
+
+private:
+    std::unique_ptr<Trackball> _tracker;
+    int _width, _height;
+    Callback _cb;
+};
@@ -0,0 +1,93 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       TripleBuffer.h
+/// \brief      Lock-free latest-value mailbox between one producer and one consumer.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include "WaitEvent.h"
+
+#include <atomic>
+#include <cstdint>
+#include <utility>  // move
+
+///
+/// Classic triple buffer: the producer never waits and always replaces the pending item, the consumer always
+/// gets the most recent item. An item that is replaced before the consumer takes it is dropped.
+/// After close(), take returns any pending item before returning false.
+///
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer(WaitEvent::Policy policy = WaitEvent::SPIN_BLOCK)
+        : _back(0), _middle(1), _front(2), _closed(false), _fresh(policy)
+    {}
+
+    /// Delete the copy constructors we wish to block (public decs give better compiler error msgs)
+    TripleBuffer(TripleBuffer const&) = delete;
+    void operator=(TripleBuffer const&) = delete;
+
+    bool closed() const { return _closed.load(std::memory_order_acquire); }
+    bool pending() const { return (_middle.load(std::memory_order_acquire) & DIRTY) != 0; }
+
+    void setWaitPolicy(WaitEvent::Policy policy) { _fresh.setPolicy(policy); }
+
+    ///
+    /// Producer: publish item. Returns true if an unread item was dropped to make way for it.
+    ///
+    bool put(T&& item)
+    {
+        _buf[_back] = std::move(item);
+        uint8_t prev = _middle.exchange(_back | DIRTY, std::memory_order_acq_rel);
+        _back = prev & IDX_MASK;
+        _buf[_back] = T();  // release dropped item now rather than when overwritten
+        _fresh.notify();
+        return (prev & DIRTY) != 0;
+    }
+
+    ///
+    /// Consumer: take the latest item, if there is one we haven't seen.
+    ///
+    bool tryTake(T& item)
+    {
+        if (!pending()) { return false; }
+        uint8_t prev = _middle.exchange(_front, std::memory_order_acq_rel);
+        _front = prev & IDX_MASK;
+        item = std::move(_buf[_front]);
+        _buf[_front] = T();
+        return true;
+    }
+
+    ///
+    /// Consumer: wait for a new item, then take it. Returns false once closed and nothing is pending.
+    ///
+    bool take(T& item)
+    {
+        _fresh.wait([&] { return pending() || closed(); });
+        return tryTake(item);
+    }
+
+    ///
+    /// Either side: refuse further items and wake the consumer.
+    ///
+    void close()
+    {
+        _closed.store(true, std::memory_order_release);
+        _fresh.notify();
+    }
+
+private:
+    static const uint8_t IDX_MASK = 0x03;
+    static const uint8_t DIRTY = 0x04;
+
+    T _buf[3];
+
+    uint8_t _back;                      // producer
+    alignas(64) std::atomic<uint8_t> _middle;
+    alignas(64) uint8_t _front;         // consumer
+    std::atomic<bool> _closed;
+
+    WaitEvent _fresh;
+};
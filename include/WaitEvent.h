@@ -0,0 +1,164 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       WaitEvent.h
+/// \brief      Lightweight wake-up event for lock-free queues (futex on Linux).
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>  // INT_MAX
+#include <cstdint>
+#include <thread>   // yield
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>    // timespec
+#else
+#include <mutex>
+#include <condition_variable>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>  // _mm_pause
+#endif
+
+///
+/// Event count used to park a thread until a lock-free predicate becomes true.
+/// notify() is a single fence and load when nobody is waiting, so producers
+/// only pay for a syscall when the other side is actually asleep.
+///
+class WaitEvent
+{
+public:
+    enum Policy {
+        BLOCK,          // sleep straight away
+        SPIN_BLOCK      // busy-wait for a short while, then sleep
+    };
+
+    WaitEvent(Policy policy = SPIN_BLOCK, int spin_its = 4000)
+        : _policy(policy), _spin_its(spin_its), _epoch(0), _waiters(0)
+    {
+        /// Spinning only steals time from the thread we are waiting on if there is a single core.
+        if (std::thread::hardware_concurrency() <= 1) { _spin_its = 0; }
+    }
+
+    /// Delete the copy constructors we wish to block (public decs give better compiler error msgs)
+    WaitEvent(WaitEvent const&) = delete;
+    void operator=(WaitEvent const&) = delete;
+
+    void setPolicy(Policy policy) { _policy = policy; }
+    Policy policy() const { return _policy; }
+
+    ///
+    /// Block until pred() returns true, or timeout (ms) expires (timeout_ms < 0 waits forever).
+    /// Returns the final value of pred().
+    ///
+    template<typename Pred>
+    bool wait(Pred pred, long timeout_ms = -1)
+    {
+        if (pred()) { return true; }
+
+        if (_policy == SPIN_BLOCK) {
+            for (int i = 0; i < _spin_its; i++) {
+                relax();
+                if (pred()) { return true; }
+            }
+        }
+
+        auto tend = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (true) {
+            uint32_t epoch = _epoch.load(std::memory_order_acquire);
+            _waiters.fetch_add(1, std::memory_order_seq_cst);
+            if (pred()) {
+                _waiters.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            long wait_ms = -1;
+            if (timeout_ms >= 0) {
+                wait_ms = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(tend - std::chrono::steady_clock::now()).count());
+                if (wait_ms <= 0) {
+                    _waiters.fetch_sub(1, std::memory_order_relaxed);
+                    return pred();
+                }
+            }
+            sleep(epoch, wait_ms);
+            _waiters.fetch_sub(1, std::memory_order_relaxed);
+
+            if (pred()) { return true; }
+        }
+    }
+
+    ///
+    /// Wake all waiting threads. Must be called after the state tested by pred() has been published.
+    ///
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_waiters.load(std::memory_order_relaxed) == 0) { return; }
+        wake();
+    }
+
+    static inline void relax()
+    {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+private:
+#ifdef __linux__
+    void sleep(uint32_t epoch, long wait_ms)
+    {
+        if (wait_ms >= 0) {
+            timespec ts;
+            ts.tv_sec = wait_ms / 1000;
+            ts.tv_nsec = (wait_ms % 1000) * 1000000;
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_epoch), FUTEX_WAIT_PRIVATE, epoch, &ts, nullptr, 0);
+        }
+        else {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_epoch), FUTEX_WAIT_PRIVATE, epoch, nullptr, nullptr, 0);
+        }
+    }
+
+    void wake()
+    {
+        _epoch.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_epoch), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+#else
+    void sleep(uint32_t epoch, long wait_ms)
+    {
+        std::unique_lock<std::mutex> l(_mutex);
+        auto changed = [&] { return _epoch.load(std::memory_order_acquire) != epoch; };
+        if (wait_ms >= 0) {
+            _cond.wait_for(l, std::chrono::milliseconds(wait_ms), changed);
+        }
+        else {
+            _cond.wait(l, changed);
+        }
+    }
+
+    void wake()
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        _epoch.fetch_add(1, std::memory_order_release);
+        _cond.notify_all();
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+#endif
+
+private:
+    Policy _policy;
+    int _spin_its;
+    std::atomic<uint32_t> _epoch;
+    std::atomic<int> _waiters;
+};
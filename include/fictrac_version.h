@@ -0,0 +1,4 @@
+// FicTrac version filled by CMake
+#define FICTRAC_VERSION_MAJOR 2
+#define FICTRAC_VERSION_MIDDLE 1
+#define FICTRAC_VERSION_MINOR 2
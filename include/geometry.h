@@ -63,6 +63,26 @@ static CmReal vec3normalise(CmReal a[3])
 	return mag;
 }
 
+///
+/// Intersect a unit view ray with a sphere of radius r centred at unit distance along z.
+/// Returns the intersection point on the front surface, relative to the sphere centre.
+///
+static inline bool intersectSphere(const double r, const double camVec[3], double sphereVec[3])
+{
+    double q = camVec[2] * camVec[2] + r * r - 1;
+    if (q < 0) { return false; }
+
+    // get point on front surface of sphere (camera coords)
+    double u = camVec[2] - sqrt(q);
+
+    // switch to sphere coords
+    sphereVec[0] = camVec[0] * u;
+    sphereVec[1] = camVec[1] * u;
+    sphereVec[2] = camVec[2] * u - 1;
+
+    return true;
+}
+
 ///
 /// A simple clamp function.
 ///
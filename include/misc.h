@@ -6,6 +6,11 @@
 
 #pragma once
 
+#include <cstddef>  // size_t
+#include <string>
+#include <thread>
+#include <vector>
+
 ///
 /// Helper function to force getchar to take new key press.
 ///
@@ -22,3 +27,23 @@ bool SetProcessHighPriority();
 bool SetThreadVeryHighPriority();
 bool SetThreadHighPriority();
 bool SetThreadNormalPriority();
+
+///
+/// Pin thread to the given logical CPUs.
+///
+bool SetThreadAffinity(std::thread& thread, const std::vector<int>& cpus);
+
+///
+/// Logical CPUs this process may run on (empty if unknown).
+///
+std::vector<int> GetProcessCpus();
+
+///
+/// Compact CPU list string (e.g. "0-3,6").
+///
+std::string CpuListStr(const std::vector<int>& cpus);
+
+///
+/// Get peak memory usage (bytes).
+///
+size_t GetPeakRSS();
@@ -37,16 +37,15 @@ static double ts_ms() {
 ///
 static double ms_since_midnight() {
 
-    static std::chrono::system_clock::time_point tmidnight;
-
-    if (tmidnight.time_since_epoch().count() == 0) {
+    // initialised once, even if first called from several threads at once
+    static const std::chrono::system_clock::time_point tmidnight = [] {
         auto texec = std::chrono::system_clock::to_time_t(_tExec);
         tm* tdate = std::localtime(&texec);
         tdate->tm_hour = 0;
         tdate->tm_min = 0;
         tdate->tm_sec = 0;
-        tmidnight = std::chrono::system_clock::from_time_t(std::mktime(tdate));
-    }
+        return std::chrono::system_clock::from_time_t(std::mktime(tdate));
+    }();
 
     return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - tmidnight).count() / 1000.;
 }
@@ -56,9 +55,8 @@ static double ms_since_midnight() {
 ///
 static std::string execTime()
 {
-    static std::string s;
-
-    if (s.empty()) {
+    // initialised once, even if first called from several threads at once
+    static const std::string s = [] {
         std::time_t t = std::chrono::system_clock::to_time_t(_tExec);
         struct tm* timeinfo = localtime(&t);
 
@@ -71,8 +69,8 @@ static std::string execTime()
             timeinfo->tm_min,
             timeinfo->tm_sec);
 
-        s = std::string(tmps);
-    }
+        return std::string(tmps);
+    }();
     return s;
 }
 
@@ -0,0 +1,216 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       AdaptiveThreshold.cpp
+/// \brief      Local adaptive thresholding of the remapped ROI image.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "AdaptiveThreshold.h"
+
+/// OpenCV individual includes required by gcc?
+#include <opencv2/imgproc.hpp>
+
+#include <cstring>  // memset
+#include <algorithm>    // min, max
+
+using cv::Mat;
+
+///
+///
+///
+AdaptiveThreshold::AdaptiveThreshold(const Mat& mask, double ratio, int win, Mode mode)
+    : _mask(mask), _ratio(ratio), _win(win), _mode(mode)
+{
+    _w = _mask.cols;
+    _h = _mask.rows;
+    _rad = (_win - 1) / 2;
+
+    if (_mode == MEAN) {
+        _masked.create(_h, _w, CV_8UC1);
+        _masked.setTo(cv::Scalar::all(0));
+
+        /// Pixel count integral only depends on the mask, so compute it once.
+        cv::threshold(_mask, _valid, 254, 1, cv::THRESH_BINARY);
+        cv::integral(_valid, _cnt, CV_32S);
+        _sum.create(_h + 1, _w + 1, CV_32SC1);  // int is plenty, max sum is 255 * ROI area
+        return;
+    }
+
+    _blur.create(_h, _w, CV_8UC1);
+    _blur.setTo(cv::Scalar::all(128));
+    _thresh_min.create(_h, _w, CV_8UC1);
+    _thresh_min.setTo(cv::Scalar::all(0));
+    _thresh_max.create(_h, _w, CV_8UC1);
+    _thresh_max.setTo(cv::Scalar::all(0));
+
+    _win_max_hist = std::make_unique<uint8_t[]>(_win);
+    _win_min_hist = std::make_unique<uint8_t[]>(_win);
+}
+
+///
+///
+///
+void AdaptiveThreshold::apply(Mat& grey)
+{
+    if (_mode == MEAN) {
+        applyMean(grey);
+    } else {
+        applyMinMax(grey);
+    }
+}
+
+///
+/// Pixel is foreground if ratio * (p - min) > (max - p), for window min/max.
+///
+void AdaptiveThreshold::applyMinMax(Mat& grey)
+{
+    /// Vars for cached min/max.
+    int win_it = 0;
+    memset(_win_max_hist.get(), 0, _win);
+    memset(_win_min_hist.get(), 0, _win);
+
+    /// Blur image before calculating region min/max values.
+    medianBlur(grey, _blur, 3);
+
+    _thresh_min.setTo(cv::Scalar::all(255));
+    _thresh_max.setTo(cv::Scalar::all(0));
+
+    /** cached min/max **/
+    // pre-fill first col
+    uint8_t max = 0, min = 255;
+    for (int i = 0; i < _rad; i++) {		// last row is computed in next block (before testing)
+        max = 0; min = 255;
+        const uint8_t* pmask = _mask.ptr(i);
+        uint8_t* pgrey = _blur.ptr(i);
+        for (int j = 0; j <= _rad; j++) {
+            if (pmask[j] < 255) { continue; }
+            const uint8_t& g = pgrey[j];
+            if ((g > max) && (g < 255)) { max = g; }	// ignore overexposed regions
+            if (g < min) { min = g; }
+        }
+        _win_max_hist[win_it] = max;
+        _win_min_hist[win_it] = min;
+        win_it++;
+    }
+
+    // compute window min/max
+    uint8_t* pthrmax = _thresh_max.data;
+    uint8_t* pthrmin = _thresh_min.data;
+    for (int j = 0; j < _w; j++) {
+        for (int i = 0; i < _h; i++) {
+
+            // add row
+            max = 0; min = 255;
+            if ((i + _rad) < _h) {
+                const uint8_t* pmask = _mask.ptr(i + _rad);
+                const uint8_t* pgrey = _blur.ptr(i + _rad);
+                for (int s = -_rad; s <= _rad; s++) {
+                    const int js = j + s;
+                    if ((js < 0) || (js >= _w)) { continue; }
+                    if (pmask[js] < 255) { continue; }
+                    const uint8_t& g = pgrey[js];
+                    if ((g > max) && (g < 255)) { max = g; }	// ignore overexposed regions
+                    if (g < min) { min = g; }
+                }
+            }
+            else {
+                // pre-fill next cols
+                const uint8_t* pmask = _mask.ptr(i + _rad - _h);
+                uint8_t* pgrey = _blur.ptr(i + _rad - _h);
+                for (int s = -_rad; s <= _rad; s++) {
+                    const int js = j + s + 1;
+                    if ((js < 0) || (js >= _w)) { continue; }
+                    if (pmask[js] < 255) { continue; }
+                    const uint8_t& g = pgrey[js];
+                    if ((g > max) && (g < 255)) { max = g; }	// ignore overexposed regions
+                    if (g < min) { min = g; }
+                }
+            }
+            _win_max_hist[win_it] = max;
+            _win_min_hist[win_it] = min;
+
+            // find window max/min
+            max = 0; min = 255;
+            for (int k = 0; k < _win; k++) {
+                int ik = i + _rad - k;
+                if ((ik >= _h) || (ik < 0)) { continue; }
+                int wk = win_it - k;
+                if (wk < 0) { wk += _win; }
+                uint8_t mx = _win_max_hist[wk];
+                if (mx > max) { max = mx; }
+                uint8_t mn = _win_min_hist[wk];
+                if (mn < min) { min = mn; }
+            }
+            pthrmax[i*_thresh_max.step + j] = max;
+            pthrmin[i*_thresh_min.step + j] = min;
+            if (++win_it >= _win) { win_it -= _win; }
+        }
+    }
+
+    // apply thresholding
+    for (int i = 0; i < _h; i++) {
+        const uint8_t* pmask = _mask.ptr(i);
+        uint8_t* pgrey = grey.ptr(i);
+        const uint8_t* pthrmin = _thresh_min.ptr(i);
+        const uint8_t* pthrmax = _thresh_max.ptr(i);
+        for (int j = 0; j < _w; j++) {
+            if (pmask[j] != 255) {
+                pgrey[j] = 128;
+                continue;
+            }
+            if ((_ratio*(pgrey[j] - pthrmin[j])) <= (pthrmax[j] - pgrey[j])) {
+                pgrey[j] = 0;
+            }
+            else {
+                pgrey[j] = 255;
+            }
+        }
+    }
+}
+
+///
+/// Pixel is foreground if (1 + ratio) * p > 2 * mean, for masked window mean (i.e. the min/max rule with
+/// the window midpoint replaced by the window mean).
+/// Window sums come from integral images, so cost doesn't depend on window size.
+///
+void AdaptiveThreshold::applyMean(Mat& grey)
+{
+    /// Zero pixels outside mask so they don't contribute to window sums.
+    _masked.setTo(cv::Scalar::all(0));
+    grey.copyTo(_masked, _valid);
+    cv::integral(_masked, _sum, CV_32S);
+
+    const float k = static_cast<float>(1 + _ratio);
+    const int rad = _rad;
+    const int jlo = std::min(rad, _w);              // first col with full window to the left
+    const int jhi = std::max(_w - rad, jlo);        // first col without full window to the right
+
+    for (int i = 0; i < _h; i++) {
+        const int i1 = std::max(i - rad, 0);
+        const int i2 = std::min(i + rad + 1, _h);
+        const int* s1 = _sum.ptr<int>(i1);
+        const int* s2 = _sum.ptr<int>(i2);
+        const int* c1 = _cnt.ptr<int>(i1);
+        const int* c2 = _cnt.ptr<int>(i2);
+        const uint8_t* pmask = _mask.ptr(i);
+        uint8_t* pgrey = grey.ptr(i);
+
+        auto test = [&](int j, int j1, int j2) {
+            const int sum = s2[j2] - s1[j2] - s2[j1] + s1[j1];
+            const int cnt = c2[j2] - c1[j2] - c2[j1] + c1[j1];
+            const uint8_t v = ((k * pgrey[j] * cnt) <= (2.f * sum)) ? 0 : 255;
+            pgrey[j] = (pmask[j] == 255) ? v : 128;
+        };
+
+        // window clipped at image edges
+        for (int j = 0; j < jlo; j++) {
+            test(j, 0, std::min(j + rad + 1, _w));
+        }
+        // interior, contiguous offsets (vectorisable)
+        for (int j = jlo; j < jhi; j++) {
+            test(j, j - rad, j + rad + 1);
+        }
+        for (int j = jhi; j < _w; j++) {
+            test(j, std::max(j - rad, 0), _w);
+        }
+    }
+}
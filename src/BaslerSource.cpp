@@ -97,7 +97,7 @@ bool BaslerSource::setFPS(double fps)
     return ret;
 }
 
-bool BaslerSource::grab(cv::Mat& frame)
+bool BaslerSource::grabNative(cv::Mat& frame, PIXEL_FORMAT& fmt)
 {
     if (!_open) { return false; }
 
@@ -128,12 +128,29 @@ bool BaslerSource::grab(cv::Mat& frame)
     }
 
     try {
-        // Convert image
-        Pylon::CImageFormatConverter formatConverter;
-        formatConverter.Convert(_pylonImg, _ptrGrabResult);
+        // Deliver mono/Bayer frames as-is, only convert anything else
+        switch (_ptrGrabResult->GetPixelType()) {
+        case PixelType_Mono8:       fmt = PIXEL_MONO8; break;
+        case PixelType_BayerRG8:    fmt = PIXEL_BAYER_RGGB; break;
+        case PixelType_BayerGR8:    fmt = PIXEL_BAYER_GRBG; break;
+        case PixelType_BayerGB8:    fmt = PIXEL_BAYER_GBRG; break;
+        case PixelType_BayerBG8:    fmt = PIXEL_BAYER_BGGR; break;
+        default:                    fmt = PIXEL_BGR8; break;
+        }
 
-        Mat tmp(_height, _width, CV_8UC3, (uint8_t*)_pylonImg.GetBuffer()); 
-        tmp.copyTo(frame);
+        if (fmt != PIXEL_BGR8) {
+            Mat tmp(_height, _width, CV_8UC1, (uint8_t*)_ptrGrabResult->GetBuffer(), _width + _ptrGrabResult->GetPaddingX());
+            tmp.copyTo(frame);
+        }
+        else {
+            // Convert image
+            Pylon::CImageFormatConverter formatConverter;
+            formatConverter.OutputPixelFormat = PixelType_BGR8packed;
+            formatConverter.Convert(_pylonImg, _ptrGrabResult);
+
+            Mat tmp(_height, _width, CV_8UC3, (uint8_t*)_pylonImg.GetBuffer());
+            tmp.copyTo(frame);
+        }
 
         // release the original image pointer
         _ptrGrabResult.Release();
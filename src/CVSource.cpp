@@ -19,12 +19,38 @@
 
 using cv::Mat;
 
+namespace {
+
+///
+/// Ask the backend for frames without conversion to BGR, so mono and Bayer sources reach grabNative untouched,
+/// and read a test frame. Backends that refuse, or that then return packed/planar frames (e.g. YUYV, YUV420)
+/// rather than single-channel or BGR frames, are left converting to BGR.
+///
+bool openNative(cv::VideoCapture& cap, Mat& test_frame)
+{
+    if (cap.set(cv::CAP_PROP_CONVERT_RGB, 0)) {
+        const int w = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH));
+        const int h = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+        if (cap.read(test_frame) && (test_frame.cols == w) && (test_frame.rows == h) &&
+            ((test_frame.type() == CV_8UC1) || (test_frame.type() == CV_8UC3))) {
+            LOG_DBG("Source frames are delivered unconverted (%d channels).", test_frame.channels());
+            return true;
+        }
+        LOG_DBG("Source does not deliver unconverted frames. Converting to BGR.");
+        cap.set(cv::CAP_PROP_CONVERT_RGB, 1);
+    }
+    cap >> test_frame;
+    return !test_frame.empty();
+}
+
+}   // namespace
+
 
 ///
 /// Constructor.
 ///
 CVSource::CVSource(std::string input)
-    : _is_image(false)
+    : _is_image(false), _pace_prev_ts(-1), _pace_av_fps(0), _pace_sleep_ms(0)
 {
     LOG_DBG("Source is: %s", input.c_str());
     Mat test_frame;
@@ -35,8 +61,7 @@ CVSource::CVSource(std::string input)
         int id = std::stoi(input);
         _cap = std::shared_ptr<cv::VideoCapture>(new cv::VideoCapture(id));
         if (!_cap->isOpened()) { throw 0; }
-        *_cap >> test_frame;
-        if (test_frame.empty()) { throw 0; }
+        if (!openNative(*_cap, test_frame)) { throw 0; }
         LOG("Using source type: camera id.");
         _open = true;
         _live = true;
@@ -47,8 +72,7 @@ CVSource::CVSource(std::string input)
             LOG_DBG("Trying source as video file...");
             _cap = std::shared_ptr<cv::VideoCapture>(new cv::VideoCapture(input));
             if (!_cap->isOpened()) { throw 0; }
-            *_cap >> test_frame;
-            if (test_frame.empty()) { throw 0; }
+            if (!openNative(*_cap, test_frame)) { throw 0; }
             LOG("Using source type: video file.");
             _open = true;
             _live = false;
@@ -131,6 +155,16 @@ bool CVSource::setFPS(double fps)
     return ret;
 }
 
+///
+/// Get number of frames in a video file.
+///
+long CVSource::getFrameCount()
+{
+    if (!_open || _live || _is_image || !_cap) { return -1; }
+    double n = _cap->get(cv::CAP_PROP_FRAME_COUNT);
+    return (n > 0) ? static_cast<long>(n) : -1;
+}
+
 ///
 /// Rewind input source to beginning.
 /// Ignored by non-file sources.
@@ -147,55 +181,68 @@ bool CVSource::rewind()
 }
 
 ///
-/// Capture and retrieve frame from source.
+/// Seek to a frame in a video file.
+/// Not every backend/container seeks exactly (some land on the nearest keyframe), so the position is
+/// checked afterwards and, if it is wrong, we rewind and decode forward to the requested frame.
 ///
-bool CVSource::grab(cv::Mat& frame)
+bool CVSource::seek(long frame)
+{
+    if (!_open || (frame < 0)) { return false; }
+    if (_is_image || (frame == 0)) { return rewind() || _is_image; }
+    if (_live || !_cap) { return false; }
+
+    bool ok = _cap->set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(frame));
+    long pos = static_cast<long>(_cap->get(cv::CAP_PROP_POS_FRAMES));
+    if (!ok || (pos != frame)) {
+        LOG_WRN("Warning! Inexact seek in source (wanted frame %ld, got %ld). Decoding forward from the start.", frame, pos);
+        if (!rewind()) { return false; }
+        for (pos = 0; pos < frame; pos++) {
+            if (!_cap->grab()) {
+                LOG_ERR("Error! Source ended before frame %ld (%ld frames).", frame, pos);
+                return false;
+            }
+        }
+    }
+    LOG_DBG("Source positioned at frame %ld", frame);
+
+    _pace_prev_ts = -1;     // restart playback pacing
+    return true;
+}
+
+///
+/// Capture and retrieve frame from source, in native pixel format.
+///
+bool CVSource::grabNative(cv::Mat& frame, PIXEL_FORMAT& fmt)
 {
 	if( !_open ) { return false; }
-	if( !_is_image && !_cap->read(_frame_cap) ) {
+    if (_is_image) {
+        _frame_cap.copyTo(frame);
+    }
+	else if( !_cap->read(frame) ) {  // decode straight into output frame
 		LOG_ERR("Error grabbing image frame!");
 		return false;
 	}
     double ts = ts_ms();    // backup, in case the device timestamp is junk
     _ms_since_midnight = ms_since_midnight();
 	_timestamp = _cap->get(cv::CAP_PROP_POS_MSEC);
-    LOG_DBG("Frame captured %dx%dx%d @ %f (t_sys: %f ms, t_day: %f ms)", _frame_cap.cols, _frame_cap.rows, _frame_cap.channels(), _timestamp, ts, _ms_since_midnight);
+    LOG_DBG("Frame captured %dx%dx%d @ %f (t_sys: %f ms, t_day: %f ms)", frame.cols, frame.rows, frame.channels(), _timestamp, ts, _ms_since_midnight);
     if (_timestamp <= 0) {
         _timestamp = ts;
     }
 
-	if( _frame_cap.channels() == 1 ) {
-		switch( _bayerType ) {
-			case BAYER_BGGR:
-				cv::cvtColor(_frame_cap, frame, cv::COLOR_BayerBG2BGR);
-				break;
-			case BAYER_GBRG:
-				cv::cvtColor(_frame_cap, frame, cv::COLOR_BayerGB2BGR);
-				break;
-			case BAYER_GRBG:
-				cv::cvtColor(_frame_cap, frame, cv::COLOR_BayerGR2BGR);
-				break;
-			case BAYER_RGGB:
-				cv::cvtColor(_frame_cap, frame, cv::COLOR_BayerRG2BGR);
-				break;
-			case BAYER_NONE:
-			default:
-				cv::cvtColor(_frame_cap, frame, cv::COLOR_GRAY2BGR);
-				break;
-		}
-	} else {
-        _frame_cap.copyTo(frame);
-	}
+    fmt = (frame.channels() == 1) ? monoFormat() : PIXEL_BGR8;
 
     /// Correct average frame rate when reading from file.
     if (!_live && (_fps > 0)) {
-        static double prev_ts = ts - (1000/_fps);
-        static double av_fps = _fps;      // initially 40 Hz
-        static double sleep_ms = 1000/_fps;
-        av_fps = 0.15 * av_fps + 0.85 * (1000 / (ts - prev_ts));
-        sleep_ms *= 0.25 * (av_fps / _fps) + 0.75;
-        ficsleep(static_cast<long>(round(sleep_ms)));
-        prev_ts = ts;
+        if (_pace_prev_ts < 0) {
+            _pace_prev_ts = ts - (1000/_fps);
+            _pace_av_fps = _fps;
+            _pace_sleep_ms = 1000/_fps;
+        }
+        _pace_av_fps = 0.15 * _pace_av_fps + 0.85 * (1000 / (ts - _pace_prev_ts));
+        _pace_sleep_ms *= 0.25 * (_pace_av_fps / _fps) + 0.75;
+        ficsleep(static_cast<long>(round(_pace_sleep_ms)));
+        _pace_prev_ts = ts;
     }
 
 	return true;
@@ -261,7 +261,7 @@ cv::Mat_<T> CmPointT<T>::omegaToMatrix(const CmPointT<T>& omega)
 {
     CmPointT<T> v = omega;
 	T angle = v.normalise();
-    static double R[9];
+    double R[9];
 	angleUnitAxisToMatrix<double>(std::cos(angle), std::sin(angle), v, R);
     return (cv::Mat_<T>(3,3) << R[0], R[1], R[2], R[3], R[4], R[5], R[6], R[7], R[8]);
 }
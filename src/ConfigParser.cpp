@@ -111,7 +111,7 @@ int ConfigParser::write(string fn)
     f << "## FicTrac v" << FICTRAC_VERSION_MAJOR << "." << FICTRAC_VERSION_MIDDLE << "." << FICTRAC_VERSION_MINOR << " config file (build date " << __DATE__ << ")" << std::endl;
 
     /// Write map
-    static char tmps[4096];
+    char tmps[4096];
     for (auto& it : _data) {
         // warning: super long str vals will cause overwrite error!
         try { sprintf(tmps, "%-16s : %s\n", it.first.c_str(), it.second.c_str()); }
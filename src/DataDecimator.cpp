@@ -0,0 +1,66 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       DataDecimator.cpp
+/// \brief      Per-output rate reduction of the data stream (every Nth frame, or aggregated over N frames).
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "DataDecimator.h"
+
+#include "typesvars.h"  // CM_PI
+
+#include <algorithm>    // max
+#include <cmath>    // atan2, sqrt
+#include <cstring>  // memcpy
+
+using namespace std;
+
+///
+///
+///
+DataDecimator::DataDecimator(int n, Mode mode, bool text, bool lat_cols, string prefix)
+    : _n(std::max(n, 1)), _count(0), _mode(mode), _text(text), _lat_cols(lat_cols), _prefix(prefix)
+{
+}
+
+///
+///
+///
+bool DataDecimator::operator()(string_view in, string& out)
+{
+    if (in.size() != sizeof(DataRecord)) {
+        out.assign(in.data(), in.size());
+        return true;
+    }
+
+    DataRecord rec;
+    memcpy(&rec, in.data(), sizeof(rec));
+
+    if ((_mode == SUM) && (_count > 0)) {
+        for (int i = 0; i < 3; i++) {
+            rec.dr_cam[i] += _acc.dr_cam[i];
+            rec.dr_lab[i] += _acc.dr_lab[i];
+        }
+        rec.err = std::max(rec.err, _acc.err);
+        rec.dts += _acc.dts;
+
+        // running speed/direction over the whole window (same convention as Trackball)
+        double velx = rec.dr_lab[1], vely = -rec.dr_lab[0];
+        rec.step_mag = sqrt(velx * velx + vely * vely);
+        rec.step_dir = atan2(vely, velx);
+        if (rec.step_dir < 0) { rec.step_dir += 2 * CM_PI; }
+    }
+    _acc = rec;
+
+    if (++_count < _n) { return false; }
+    _count = 0;
+
+    if (_text) {
+        out.resize(_prefix.size() + DataRecord::TEXT_MAX);
+        memcpy(&out[0], _prefix.data(), _prefix.size());
+        out.resize(_prefix.size() + rec.formatText(&out[_prefix.size()], DataRecord::TEXT_MAX, _lat_cols));
+    }
+    else {
+        out.assign(reinterpret_cast<const char*>(&rec), sizeof(rec));
+    }
+    return true;
+}
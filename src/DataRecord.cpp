@@ -0,0 +1,191 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       DataRecord.cpp
+/// \brief      Fixed-size output data record, with text and binary (.bin) serialisation.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "DataRecord.h"
+
+#include <algorithm>    // min
+#include <charconv>     // to_chars
+#include <cstddef>  // offsetof, ptrdiff_t
+#include <cstdio>   // snprintf
+#include <cstring>  // memcpy, strncpy
+#include <initializer_list>
+
+using namespace std;
+
+const char DATA_MAGIC[8] = { 'F', 'I', 'C', 'T', 'R', 'A', 'C', 'B' };
+
+namespace {
+
+///
+/// Append helpers for formatText. Each returns the new end of the output.
+///
+inline char* putDbl(char* p, char* end, double v, int precision)
+{
+#if defined(__cpp_lib_to_chars)
+    return std::to_chars(p, end, v, std::chars_format::general, precision).ptr;
+#else
+    int n = snprintf(p, end - p, "%.*g", precision, v);
+    return (n > 0) ? p + std::min<ptrdiff_t>(n, end - p - 1) : p;
+#endif
+}
+
+inline char* putU64(char* p, char* end, uint64_t v)
+{
+    return std::to_chars(p, end, v).ptr;
+}
+
+inline char* putSep(char* p, char* end)
+{
+    if (end - p >= 2) {
+        *p++ = ',';
+        *p++ = ' ';
+    }
+    return p;
+}
+
+}   // namespace
+
+///
+///
+///
+size_t DataRecord::formatText(char* buf, size_t len, bool lat_cols) const
+{
+    const int PREC = 14;
+    char* p = buf;
+    char* end = buf + len - 1;      // leave room for newline
+
+    // frame_count
+    p = putU64(p, end, cnt);
+    // rel_vec_cam[3] | error | rel_vec_world[3] | abs_vec_cam[3] | abs_vec_world[3]
+    for (int i = 0; i < 3; i++) { p = putSep(p, end); p = putDbl(p, end, dr_cam[i], PREC); }
+    p = putSep(p, end); p = putDbl(p, end, err, PREC);
+    for (int i = 0; i < 3; i++) { p = putSep(p, end); p = putDbl(p, end, dr_lab[i], PREC); }
+    for (int i = 0; i < 3; i++) { p = putSep(p, end); p = putDbl(p, end, r_cam[i], PREC); }
+    for (int i = 0; i < 3; i++) { p = putSep(p, end); p = putDbl(p, end, r_lab[i], PREC); }
+    // integrated xpos | integrated ypos | integrated heading | direction (radians) | speed (radians/frame)
+    // integrated x movement | integrated y movement (mouse output equivalent) | timestamp (ms since epoch)
+    for (double v : { posx, posy, heading, step_dir, step_mag, intx, inty, ts }) {
+        p = putSep(p, end); p = putDbl(p, end, v, PREC);
+    }
+    // sequence number | delta ts (ms since last frame) | timestamp (ms since midnight)
+    p = putSep(p, end); p = putU64(p, end, seq);
+    p = putSep(p, end); p = putDbl(p, end, dts, PREC);
+    p = putSep(p, end); p = putDbl(p, end, ms, PREC);
+    // latency from grab (ms): dequeued | optimised | queued for output
+    if (lat_cols) {
+        for (double v : { lat_deq, lat_opt, lat_out }) {
+            p = putSep(p, end); p = putDbl(p, end, v, 6);
+        }
+    }
+    *p++ = '\n';
+
+    return p - buf;
+}
+
+///
+///
+///
+string DataRecord::toText(bool lat_cols) const
+{
+    char buf[TEXT_MAX];
+    return string(buf, formatText(buf, sizeof(buf), lat_cols));
+}
+
+///
+///
+///
+const vector<DataColumn>& dataColumns()
+{
+    static const vector<DataColumn> cols = [] {
+        struct Col { const char* name; size_t offset; bool u64; };
+        const Col defs[] = {
+            { "frame_cnt", offsetof(DataRecord, cnt), true },
+            { "dr_cam_x", offsetof(DataRecord, dr_cam) + 0, false },
+            { "dr_cam_y", offsetof(DataRecord, dr_cam) + 8, false },
+            { "dr_cam_z", offsetof(DataRecord, dr_cam) + 16, false },
+            { "err", offsetof(DataRecord, err), false },
+            { "dr_lab_x", offsetof(DataRecord, dr_lab) + 0, false },
+            { "dr_lab_y", offsetof(DataRecord, dr_lab) + 8, false },
+            { "dr_lab_z", offsetof(DataRecord, dr_lab) + 16, false },
+            { "r_cam_x", offsetof(DataRecord, r_cam) + 0, false },
+            { "r_cam_y", offsetof(DataRecord, r_cam) + 8, false },
+            { "r_cam_z", offsetof(DataRecord, r_cam) + 16, false },
+            { "r_lab_x", offsetof(DataRecord, r_lab) + 0, false },
+            { "r_lab_y", offsetof(DataRecord, r_lab) + 8, false },
+            { "r_lab_z", offsetof(DataRecord, r_lab) + 16, false },
+            { "posx", offsetof(DataRecord, posx), false },
+            { "posy", offsetof(DataRecord, posy), false },
+            { "heading", offsetof(DataRecord, heading), false },
+            { "step_dir", offsetof(DataRecord, step_dir), false },
+            { "step_mag", offsetof(DataRecord, step_mag), false },
+            { "intx", offsetof(DataRecord, intx), false },
+            { "inty", offsetof(DataRecord, inty), false },
+            { "ts", offsetof(DataRecord, ts), false },
+            { "seq", offsetof(DataRecord, seq), true },
+            { "dts", offsetof(DataRecord, dts), false },
+            { "ms", offsetof(DataRecord, ms), false },
+            { "lat_deq", offsetof(DataRecord, lat_deq), false },
+            { "lat_opt", offsetof(DataRecord, lat_opt), false },
+            { "lat_out", offsetof(DataRecord, lat_out), false },
+        };
+        vector<DataColumn> v;
+        for (auto& d : defs) {
+            DataColumn c;
+            memset(&c, 0, sizeof(c));
+            strncpy(c.name, d.name, sizeof(c.name) - 1);
+            c.offset = static_cast<uint32_t>(d.offset);
+            strncpy(c.type, d.u64 ? "u64" : "f64", sizeof(c.type) - 1);
+            v.push_back(c);
+        }
+        return v;
+    }();
+    return cols;
+}
+
+///
+///
+///
+string dataFileHeader(bool lat_cols)
+{
+    const vector<DataColumn>& cols = dataColumns();
+
+    DataHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, DATA_MAGIC, sizeof(h.magic));
+    h.version = DATA_RECORD_VERSION;
+    h.header_size = static_cast<uint32_t>(sizeof(DataHeader) + cols.size() * sizeof(DataColumn));
+    h.record_size = sizeof(DataRecord);
+    h.ncols = static_cast<uint32_t>(cols.size());
+    h.flags = lat_cols ? DATA_FLAG_LAT_COLS : 0;
+
+    string s(reinterpret_cast<const char*>(&h), sizeof(h));
+    s.append(reinterpret_cast<const char*>(cols.data()), cols.size() * sizeof(DataColumn));
+    return s;
+}
+
+///
+///
+///
+bool parseDataFileHeader(const string& buf, bool& lat_cols, size_t& header_size, string& err)
+{
+    DataHeader h;
+    if (buf.size() < sizeof(h)) {
+        err = "file too short";
+        return false;
+    }
+    memcpy(&h, buf.data(), sizeof(h));
+    if (memcmp(h.magic, DATA_MAGIC, sizeof(h.magic)) != 0) {
+        err = "not a FicTrac binary data file";
+        return false;
+    }
+    if ((h.version != DATA_RECORD_VERSION) || (h.record_size != sizeof(DataRecord))) {
+        err = "unsupported record version (" + to_string(h.version) + ")";
+        return false;
+    }
+    lat_cols = (h.flags & DATA_FLAG_LAT_COLS) != 0;
+    header_size = h.header_size;
+    return true;
+}
@@ -6,12 +6,17 @@
 
 #include "FileRecorder.h"
 
+#include <cstring>  // memset
 #include <iostream> // cout/cerr
 
+/// Compressed output is made decodable up to this point at least this often, so a crash loses at most this much data.
+const int FILE_GZ_SYNC_MS = 2000;
+
 ///
 ///
 ///
-FileRecorder::FileRecorder()
+FileRecorder::FileRecorder(bool binary)
+    : _binary(binary), _gzip(false)
 {
     _type = FILE;
 }
@@ -24,28 +29,116 @@ FileRecorder::~FileRecorder()
     closeRecord();
 }
 
+///
+///
+///
+bool FileRecorder::gzipSupported()
+{
+#ifdef WITH_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
 ///
 ///
 ///
 bool FileRecorder::openRecord(std::string fn)
 {
-    _file.open(fn);
+    _gzip = (fn.size() > 3) && (fn.compare(fn.size() - 3, 3, ".gz") == 0);
+    if (_gzip && !gzipSupported()) {
+        std::cerr << "Error! FileRecorder could not open output file (" << fn << ") because this build does not support compression!" << std::endl;
+        return false;
+    }
+
+    _buf.resize(1 << 16);
+    _file.rdbuf()->pubsetbuf(_buf.data(), _buf.size());     // must precede open
+    _file.open(fn, (_binary || _gzip) ? (std::ios::out | std::ios::binary) : std::ios::out);
     _open = _file.is_open();
     if (!_open) {
         std::cerr << "Error! FileRecorder could not open output file (" << fn << ")!" << std::endl;
+        return false;
+    }
+
+#ifdef WITH_ZLIB
+    if (_gzip) {
+        memset(&_zs, 0, sizeof(_zs));
+        // 15 + 16: max window with a gzip header, so the file can be read with gunzip/zcat
+        if (deflateInit2(&_zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            std::cerr << "Error! FileRecorder could not initialise compression for output file (" << fn << ")!" << std::endl;
+            _file.close();
+            _open = false;
+            return false;
+        }
+        _zbuf.resize(1 << 16);
+        _last_sync = std::chrono::steady_clock::now();
     }
+#endif
     return _open;
 }
 
 ///
+/// Compress data (flush is Z_NO_FLUSH, Z_SYNC_FLUSH or Z_FINISH) and write out whatever zlib produces.
+///
+#ifdef WITH_ZLIB
+bool FileRecorder::deflateChunk(const char* data, size_t len, int flush)
+{
+    _zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    _zs.avail_in = static_cast<uInt>(len);
+    do {
+        _zs.next_out = reinterpret_cast<Bytef*>(_zbuf.data());
+        _zs.avail_out = static_cast<uInt>(_zbuf.size());
+        int ret = deflate(&_zs, flush);
+        if ((ret != Z_OK) && (ret != Z_STREAM_END) && (ret != Z_BUF_ERROR)) { return false; }
+        _file.write(_zbuf.data(), _zbuf.size() - _zs.avail_out);
+    } while ((_zs.avail_out == 0) || (_zs.avail_in > 0));
+    return _file.good();
+}
+#endif
+
 ///
 ///
-bool FileRecorder::writeRecord(std::string s)
+///
+bool FileRecorder::write(const char* data, size_t len)
+{
+#ifdef WITH_ZLIB
+    if (_gzip) { return deflateChunk(data, len, Z_NO_FLUSH); }
+#endif
+    _file.write(data, len);
+    return true;
+}
+
+///
+///
+///
+bool FileRecorder::writeRecord(std::string_view s)
+{
+    return writeRecords(std::vector<std::string_view>(1, s));
+}
+
+///
+///
+///
+bool FileRecorder::writeRecords(const std::vector<std::string_view>& recs)
 {
     if (!_open) { return false; }
-    _file << s;
+    bool ret = true;
+    for (auto& s : recs) {
+        ret &= write(s.data(), s.size());
+    }
+
+#ifdef WITH_ZLIB
+    /// Compressed data only reaches the file in blocks, so just make it readable up to here every so often.
+    if (_gzip) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - _last_sync < std::chrono::milliseconds(FILE_GZ_SYNC_MS)) { return ret; }
+        _last_sync = now;
+        ret &= deflateChunk(nullptr, 0, Z_SYNC_FLUSH);
+    }
+#endif
     _file.flush();  // force flush in Linux
-    return true;
+    return ret;
 }
 
 ///
@@ -53,6 +146,12 @@ bool FileRecorder::writeRecord(std::string s)
 ///
 void FileRecorder::closeRecord()
 {
+#ifdef WITH_ZLIB
+    if (_open && _gzip) {
+        deflateChunk(nullptr, 0, Z_FINISH);
+        deflateEnd(&_zs);
+    }
+#endif
     _open = false;
     _file.close();
 }
@@ -10,6 +10,7 @@
 
 #include "Logger.h"
 #include "misc.h"
+#include "Trace.h"
 
 /// OpenCV individual includes required by gcc?
 #include <opencv2/highgui.hpp>
@@ -18,11 +19,18 @@
 #include <opencv2/videoio.hpp>
 
 #include <cmath>    // round
+#include <algorithm>    // min, max
 #include <string>
 
 using cv::Mat;
 using namespace std;
 
+/// Ring length used when no queue length is given (max_buf_len <= 0).
+const int FRAME_Q_MAX_LEN = 256;
+
+/// Upper limit on the number of preprocessing threads chosen automatically (proc_threads <= 0).
+const int PROC_THREADS_AUTO_MAX = 4;
+
 ///
 ///
 ///
@@ -32,9 +40,16 @@ FrameGrabber::FrameGrabber( shared_ptr<FrameSource> source,
                             double                  thresh_ratio,
                             double                  thresh_win_pc,
                             string                  thresh_rgb_transform,
+                            AdaptiveThreshold::Mode thresh_mode,
+                            DeliveryPolicy          policy,
                             int                     max_buf_len,
-                            int                     max_frame_cnt
-)   : _source(source), _remapper(remapper), _remap_mask(remap_mask), _active(false)
+                            int                     max_frame_cnt,
+                            WaitEvent::Policy       wait_policy,
+                            int                     proc_threads,
+                            shared_ptr<ThreadPool>  pool,
+                            long                    start_frame
+)   : _source(source), _remapper(remapper), _remap_mask(remap_mask), _thresh_mode(thresh_mode), _policy(policy), _active(false), _keep_src(true),
+    _ngrabbed(0), _ndropped(0), _noverflow(0), _q_depth_max(0), _pool_shared(false), _next_seq(0), _proc_threads(1), _inflight(0)
 {
     /// Quick sizes.
     _w = _remapper->getSrcW();
@@ -64,16 +79,67 @@ FrameGrabber::FrameGrabber( shared_ptr<FrameSource> source,
         thresh_win_pc = 0.2;
     }
     _thresh_win = static_cast<int>(round(thresh_win_pc*_rw)) | 0x01;
-    _thresh_rad = static_cast<int>((_thresh_win - 1) / 2);
 
-    LOG_DBG("Thresholding window size: %d (ROI: %d x %d)", _thresh_win, _rw, _rh);
+    LOG_DBG("Thresholding window size: %d (ROI: %d x %d, %s)", _thresh_win, _rw, _rh, _thresh_mode == AdaptiveThreshold::MEAN ? "mean" : "min/max");
 
     _max_buf_len = max_buf_len;
     _max_frame_cnt = max_frame_cnt;
+    _start_frame = start_frame;
+
+    /// Processed frame queue.
+    if (_policy == LATEST) {
+        _latest_q = std::make_unique<TripleBuffer<FrameSet>>(wait_policy);
+        LOG_DBG("Processed frame delivery: latest (%s wait)", wait_policy == WaitEvent::BLOCK ? "block" : "spin");
+    }
+    else {
+        _frame_q = std::make_unique<SPSCRing<FrameSet>>(_max_buf_len > 0 ? _max_buf_len : FRAME_Q_MAX_LEN, wait_policy);
+        LOG_DBG("Processed frame delivery: %s, queue length %zu (%s wait)", _policy == UNBOUNDED ? "unbounded" : "bounded",
+            _frame_q->capacity(), wait_policy == WaitEvent::BLOCK ? "block" : "spin");
+    }
+
+    /// Preprocessing threads. Live sources are always processed serially, as reordering only adds latency.
+    /// With a shared pool, proc_threads limits how many of the pool's threads this grabber keeps busy, and
+    /// defaults to an even share between the grabbers using the pool.
+    if (!_source || _source->isLive()) {
+        proc_threads = 1;
+    }
+    else if ((proc_threads <= 0) && !pool) {
+        proc_threads = std::min<int>(std::max<int>(std::thread::hardware_concurrency() - 1, 1), PROC_THREADS_AUTO_MAX);
+    }
+    const bool use_shared = pool && (proc_threads != 1);
+    _workers.resize(use_shared ? pool->size() : proc_threads);     // scratch is indexed by pool worker id
+    for (auto& w : _workers) {
+        w.frame_grey.create(_h, _w, CV_8UC1);
+        w.frame_grey.setTo(cv::Scalar::all(0));
+        w.thresh = std::make_unique<AdaptiveThreshold>(_remap_mask, _thresh_ratio, _thresh_win, _thresh_mode);
+    }
+    _proc_threads = proc_threads;
+    if (use_shared) {
+        _pool = pool;
+        _pool_shared = true;
+        _pool->addUser();
+        if (proc_threads > 0) {
+            LOG_DBG("Frame preprocessing threads: %d (shared pool)", std::min<int>(proc_threads, _pool->size()));
+        } else {
+            LOG_DBG("Frame preprocessing threads: even share of %d (shared pool)", _pool->size());
+        }
+    }
+    else {
+        if (proc_threads > 1) {
+            _pool = std::make_shared<ThreadPool>(proc_threads);
+        }
+        LOG_DBG("Frame preprocessing threads: %d", proc_threads);
+    }
+
+    /// Frames are pushed in by the caller.
+    if (!_source) { return; }
 
     /// Thread stuff.
     _active = true;
-    _thread = std::make_unique<std::thread>(&FrameGrabber::process, this);
+    _thread = std::make_unique<std::thread>([this, tag = Logger::threadTag()] {
+        Logger::setThreadTag(tag);
+        process();
+    });
 }
 
 ///
@@ -83,101 +149,267 @@ FrameGrabber::~FrameGrabber()
 {
     LOG("Closing input stream");
 
-    unique_lock<mutex> l(_qMutex);
     _active = false;
-    _qCond.notify_all();
-    l.unlock();
+    closeQueue();
+
+    {
+        std::lock_guard<std::mutex> l(_reorder_mutex);
+        _inflight_cond.notify_all();
+    }
 
     if (_thread && _thread->joinable()) {
         _thread->join();
     }
+
+    /// Grab thread has already waited for outstanding frames, so pool has nothing of ours left to run.
+    if (_pool_shared) { _pool->removeUser(); }
+    _pool.reset();
 }
 
 ///
 ///
 ///
-bool FrameGrabber::getFrameSet(Mat& frame, Mat& remap, double& timestamp, double& ms_since_midnight, bool latest)
+bool FrameGrabber::getFrameSet(Mat& frame, PIXEL_FORMAT& fmt, Mat& remap, double& timestamp, double& ms_since_midnight, int64_t& t_grab)
 {
-    unique_lock<mutex> l(_qMutex);
-    while (_active && (_frame_q.size() == 0)) {
-        _qCond.wait(l);
+    // queues return remaining frames before returning false, so we finish processing before quitting
+    FrameSet fs;
+    if (_latest_q) {
+        if (!_latest_q->take(fs)) {
+            LOG_DBG("No more processed frames!");
+            return false;
+        }
+    }
+    else {
+        if (!_frame_q->pop(fs)) {
+            LOG_DBG("No more processed frames in queue!");
+            return false;
+        }
+        size_t n = _frame_q->size() + _noverflow;
+        if (n > 0) {
+            LOG_DBG("%zu frames remaining in processed frame queue.", n);
+        }
     }
-    size_t n = _frame_q.size();
-    if (!_active && (n == 0)) {   // n test allows us to finish processing the queue before quitting
-        LOG_DBG("No more processed frames in queue!");
 
-        // shouldn't be needed - but just in case :-)
-        _qCond.notify_all();
+    frame = fs.frame;
+    fmt = fs.fmt;
+    remap = fs.remap;
+    timestamp = fs.ts;
+    ms_since_midnight = fs.ms;
+    t_grab = fs.t_grab;
+    return true;
+}
 
-        // mutex unlocked in unique_lock dstr
-        return false;
+///
+///
+///
+FrameGrabber::Stats FrameGrabber::getStats()
+{
+    Stats stats;
+    stats.grabbed = _ngrabbed;
+    stats.dropped = _ndropped;
+    stats.q_depth = _latest_q ? (_latest_q->pending() ? 1 : 0) : (_frame_q->size() + _noverflow);
+    stats.q_depth_max = _q_depth_max;
+    return stats;
+}
+
+///
+///
+///
+bool FrameGrabber::setAffinity(const std::vector<int>& cpus)
+{
+    if (!_thread) { return false; }
+    bool ok = SetThreadAffinity(*_thread, cpus);
+    if (_pool && !_pool_shared) {
+        ok &= _pool->setAffinity(cpus);
     }
-    
-    // must be frame_q.size() > 0 to get here (can be !_active)
-
-    if ((n != _remap_q.size()) || (n != _ts_q.size()) || (n != _ms_q.size())) {
-        LOG_ERR("Error! Input processed frame queues are misaligned!");
-        
-        // drop all frames
-        _frame_q.clear();
-        _remap_q.clear();
-        _ts_q.clear();
-        _ms_q.clear();
-
-        // wake processing thread
-        _qCond.notify_all();
-
-        // mutex unlocked in unique_lock dstr
-        return false;
+    return ok;
+}
+
+///
+///
+///
+void FrameGrabber::terminate()
+{
+    _active = false;
+    closeQueue();
+
+    std::lock_guard<std::mutex> l(_reorder_mutex);
+    _inflight_cond.notify_all();
+}
+
+///
+/// Add processed frame to output queue, according to delivery policy.
+/// Grab thread only. Returns false if the queue has been closed.
+///
+bool FrameGrabber::deliver(FrameSet&& fs)
+{
+    size_t depth = 1;
+    switch (_policy) {
+    case LATEST:
+        if (_latest_q->closed()) { return false; }
+        if (_latest_q->put(std::move(fs))) {
+            _ndropped++;
+            LOG_DBG("Dropped unread frame (total dropped: %lu).", _ndropped.load());
+        }
+        break;
+
+    case UNBOUNDED:
+        // never wait - park frames on our side of the queue until there is room
+        _overflow_q.push_back(std::move(fs));
+        while (!_overflow_q.empty() && _frame_q->tryPush(std::move(_overflow_q.front()))) {
+            _overflow_q.pop_front();
+        }
+        _noverflow = _overflow_q.size();
+        if (_frame_q->closed()) { return false; }
+        depth = _frame_q->size() + _overflow_q.size();
+        break;
+
+    case BOUNDED:
+    default:
+        if (!_frame_q->push(std::move(fs))) { return false; }
+        depth = _frame_q->size();
+        break;
+    }
+
+    if (depth > _q_depth_max) { _q_depth_max = depth; }
+    return true;
+}
+
+///
+/// Number of frames that may be preprocessing or waiting to be reordered at once.
+///
+int FrameGrabber::maxInflight() const
+{
+    if (_pool_shared) {
+        return 2 * ((_proc_threads > 0) ? std::min<int>(_proc_threads, _pool->size()) : _pool->share());
     }
+    return 2 * _proc_threads;
+}
+
+///
+/// Grab thread only: release preprocessed frames to the output queue, strictly in grab order.
+/// The mutex is released while delivering, so workers are never held up by the consumer.
+/// Returns false if the queue has been closed (remaining ready frames are discarded).
+///
+bool FrameGrabber::deliverReady(std::unique_lock<std::mutex>& l)
+{
+    bool ok = true;
+    auto it = _reorder_buf.begin();
+    while ((it != _reorder_buf.end()) && (it->first == _next_seq)) {
+        FrameSet fs = std::move(it->second);
+        _reorder_buf.erase(it);
+        _next_seq++;
+        _inflight--;
 
-    if (latest) {
-        frame = _frame_q.back();
-        remap = _remap_q.back();
-        timestamp = _ts_q.back();
-        ms_since_midnight = _ms_q.back();
-        
-        if (n > 1) {
-            LOG_WRN("Warning! Dropping %d frame/s from input processed frame queues!", n - 1);
+        l.unlock();
+        if (ok) {
+            ok = deliver(std::move(fs));
+            LOG_DBG("Processed frame added to input queue (l = %zu).", getStats().q_depth);
         }
+        l.lock();
+        it = _reorder_buf.begin();
+    }
+    return ok;
+}
 
-        // drop unused frames
-        _frame_q.clear();
-        _remap_q.clear();
-        _ts_q.clear();
-        _ms_q.clear();
+///
+/// Wait for any parked frames to make it into the output queue.
+///
+void FrameGrabber::flushOverflow()
+{
+    while (!_overflow_q.empty()) {
+        if (!_frame_q->push(std::move(_overflow_q.front()))) { break; }
+        _overflow_q.pop_front();
+        _noverflow = _overflow_q.size();
+    }
+    _overflow_q.clear();
+    _noverflow = 0;
+}
+
+///
+/// Refuse further frames and wake the consumer (which will drain any queued frames).
+///
+void FrameGrabber::closeQueue()
+{
+    if (_latest_q) { _latest_q->close(); }
+    if (_frame_q) { _frame_q->close(); }
+}
+
+///
+/// Reuse a previous grab buffer if there is one, to avoid allocating (and faulting in) a full frame every grab.
+///
+Mat FrameGrabber::getGrabBuffer()
+{
+    Mat frame;
+    std::lock_guard<std::mutex> l(_grab_buf_mutex);
+    if (!_grab_bufs.empty()) {
+        frame = _grab_bufs.back();
+        _grab_bufs.pop_back();
+    }
+    return frame;
+}
+
+///
+/// Return grab buffer for reuse, once nothing else references it.
+///
+void FrameGrabber::recycleGrabBuffer(Mat& frame)
+{
+    std::lock_guard<std::mutex> l(_grab_buf_mutex);
+    if (_grab_bufs.size() < (_workers.size() + 2)) {     // enough for every worker plus the grab thread
+        _grab_bufs.push_back(frame);
+    }
+    frame.release();
+}
+
+///
+///
+///
+void FrameGrabber::preprocess(const Mat& frame, PIXEL_FORMAT fmt, Mat& remap_grey, Worker& worker)
+{
+    TRACE_ZONE("grab.preprocess");
+
+    /// Create output remap image.
+    remap_grey.create(_rh, _rw, CV_8UC1);
+    remap_grey.setTo(cv::Scalar::all(128));
+
+    /// Create grey ROI frame, taking the cheapest path from the native pixel format.
+    Mat frame_grey = worker.frame_grey;
+    if ((fmt == PIXEL_MONO8) || (_thresh_rgb_transform == GREY)) {
+        FrameSource::toGrey(frame, fmt, frame_grey);    // no copy for mono frames
     }
     else {
-        frame = _frame_q.front();
-        remap = _remap_q.front();
-        timestamp = _ts_q.front();
-        ms_since_midnight = _ms_q.front();
-
-        _frame_q.pop_front();
-        _remap_q.pop_front();
-        _ts_q.pop_front();
-        _ms_q.pop_front();
-
-        if (n > 1) {
-            LOG_DBG("%d frames remaining in processed frame queue.", _frame_q.size());
+        const Mat* frame_bgr = &frame;
+        if (fmt != PIXEL_BGR8) {
+            FrameSource::toBGR(frame, fmt, worker.frame_bgr);
+            frame_bgr = &worker.frame_bgr;
         }
-    }
 
-    // wake processing thread
-    _qCond.notify_all();
+        int from_to[2] = { 0, 0 };
+        switch (_thresh_rgb_transform) {
+        case RED:   from_to[0] = 2; break;
+        case GREEN: from_to[0] = 1; break;
+        case BLUE:
+        default:    from_to[0] = 0; break;
+        }
+        cv::mixChannels(frame_bgr, 1, &frame_grey, 1, from_to, 1);
+    }
+    _remapper->apply(frame_grey, remap_grey);
 
-    // mutex unlocked in unique_lock dstr
-    return true;
+    /// Threshold in place.
+    worker.thresh->apply(remap_grey);
 }
 
 ///
 ///
 ///
-void FrameGrabber::terminate()
+bool FrameGrabber::preprocessFrame(const Mat& frame, PIXEL_FORMAT fmt, Mat& remap)
 {
-    unique_lock<mutex> l(_qMutex);
-    _active = false;
-    _qCond.notify_all();
+    if ((frame.cols != _w) || (frame.rows != _h)) {
+        LOG_ERR("Error! Frame size (%dx%d) does not match the configured size (%dx%d).", frame.cols, frame.rows, _w, _h);
+        return false;
+    }
+    preprocess(frame, fmt, remap, _workers[0]);
+    return true;
 }
 
 ///
@@ -185,23 +417,16 @@ void FrameGrabber::terminate()
 ///
 void FrameGrabber::process()
 {
-    /// Init storage arrays
-    Mat frame_grey(_h, _w, CV_8UC1);
-    frame_grey.setTo(cv::Scalar::all(0));
-    Mat remap_bgr(_rh, _rw, CV_8UC3);
-    remap_bgr.setTo(cv::Scalar::all(0));
-    Mat remap_blur(_rh, _rw, CV_8UC1);
-    remap_blur.setTo(cv::Scalar::all(128));
-    Mat thresh_min(_rh, _rw, CV_8UC1);
-    thresh_min.setTo(cv::Scalar::all(0));
-    Mat thresh_max(_rh, _rw, CV_8UC1);
-    thresh_max.setTo(cv::Scalar::all(0));
-
-    auto win_max_hist = std::make_unique<uint8_t[]>(_thresh_win);
-    auto win_min_hist = std::make_unique<uint8_t[]>(_thresh_win);
-
-    /// Rewind to video start.
-    _source->rewind();
+    /// Rewind to video start (or the requested start frame).
+    if (_start_frame > 0) {
+        if (!_source->seek(_start_frame)) {
+            LOG_ERR("Error! Unable to seek to source frame %ld!", _start_frame);
+            _active = false;
+        }
+    }
+    else {
+        _source->rewind();
+    }
 
     LOG_DBG("Starting frame grabbing loop!");
 
@@ -212,179 +437,93 @@ void FrameGrabber::process()
         LOG_DBG("Set frame grabbing thread priority to HIGH!");
     }
 
+    Trace::setThreadName("grabber");
+
     /// Frame grab loop.
     int cnt = 0;
+    unsigned int seq = 0;
     while (_active) {
         /// Wait until we need to capture a new frame.
-        unique_lock<mutex> l(_qMutex);
-        while (_active && (_max_buf_len > 0) && (_frame_q.size() >= _max_buf_len)) {
-            _qCond.wait(l);
-        }
-        l.unlock();
-        if (!_active) { break; }
-
-        /// Capture new frame.
-        Mat frame_bgr(_h, _w, CV_8UC3);
-        frame_bgr.setTo(cv::Scalar::all(0));
-        if (!_source->grab(frame_bgr) || ((_max_frame_cnt > 0) && (++cnt > _max_frame_cnt))) {
-            if ((_max_frame_cnt > 0) && (++cnt > _max_frame_cnt)) {
-                LOG("Max frame count (%d) reached!", _max_frame_cnt);
-            } else {
-                LOG_ERR("Error grabbing new frame!");
+        {
+            TRACE_ZONE("grab.wait");
+            if (_pool) {
+                // deliver whatever is ready, and limit frames being processed or waiting to be reordered
+                std::unique_lock<std::mutex> l(_reorder_mutex);
+                _inflight_cond.wait(l, [&] { return nextReady() || (_inflight < maxInflight()) || !_active; });
+                if (!_active || !deliverReady(l)) { break; }
+                if (_inflight >= maxInflight()) { continue; }
             }
-            _active = false;
-            l.lock();   // predicate check and wait are not atomic in other thread, so if we don't lock before notifying, notification could be dropped.
-            _qCond.notify_all();
-            l.unlock();
-            break;
+            else if ((_policy == BOUNDED) && !_frame_q->waitForSpace()) { break; }
         }
-        double timestamp = _source->getTimestamp();
-        double ms_since_midnight = _source->getMsSinceMidnight();
-
-        /// Create output remap image in the loop.
-        Mat remap_grey(_rh, _rw, CV_8UC1);
-        remap_grey.setTo(cv::Scalar::all(128));
 
-        /// Vars for cached min/max.
-        int win_it = 0;
-        memset(win_max_hist.get(), 0, _thresh_win);
-        memset(win_min_hist.get(), 0, _thresh_win);
-
-        /// Create grey ROI frame.
-        int from_to[2] = { 0, 0 };
-        switch (_thresh_rgb_transform) {
-        case RED:
-            from_to[0] = 2; from_to[1] = 0;
-            cv::mixChannels(&frame_bgr, 1, &frame_grey, 1, from_to, 1);
-            break;
-
-        case GREEN:
-            from_to[0] = 1; from_to[1] = 0;
-            cv::mixChannels(&frame_bgr, 1, &frame_grey, 1, from_to, 1);
-            break;
-
-        case BLUE:
-            from_to[0] = 0; from_to[1] = 0;
-            cv::mixChannels(&frame_bgr, 1, &frame_grey, 1, from_to, 1);
+        if ((_max_frame_cnt > 0) && (cnt >= _max_frame_cnt)) {
+            LOG("Max frame count (%d) reached!", _max_frame_cnt);
+            _active = false;
             break;
+        }
 
-        case GREY:
-        default:
-            cv::cvtColor(frame_bgr, frame_grey, cv::COLOR_BGR2GRAY);
+        /// Capture new frame (fresh buffer if it is going downstream, as the previous one may still be in use).
+        const bool keep_src = _keep_src;
+        Mat frame = keep_src ? Mat() : getGrabBuffer();
+        PIXEL_FORMAT fmt = PIXEL_BGR8;
+        bool grabbed;
+        {
+            TRACE_ZONE("grab.capture");
+            grabbed = _source->grabNative(frame, fmt);
+        }
+        const int64_t t_grab = Trace::now();
+        if (!grabbed) {
+            LOG_ERR("Error grabbing new frame!");
+            _active = false;
             break;
         }
-        _remapper->apply(frame_grey, remap_grey);
-
-        /// Blur image before calculating region min/max values.
-        medianBlur(remap_grey, remap_blur, 3);
-
-        thresh_min.setTo(cv::Scalar::all(255));
-        thresh_max.setTo(cv::Scalar::all(0));
-
-        /** cached min/max **/
-        // pre-fill first col
-        uint8_t max = 0, min = 255;
-        for (int i = 0; i < _thresh_rad; i++) {		// last row is computed in next block (before testing)
-            max = 0; min = 255;
-            const uint8_t* pmask = _remap_mask.ptr(i);
-            uint8_t* pgrey = remap_blur.ptr(i);
-            for (int j = 0; j <= _thresh_rad; j++) {
-                if (pmask[j] < 255) { continue; }
-                const uint8_t& g = pgrey[j];
-                if ((g > max) && (g < 255)) { max = g; }	// ignore overexposed regions
-                if (g < min) { min = g; }
-            }
-            win_max_hist[win_it] = max;
-            win_min_hist[win_it] = min;
-            win_it++;
+        cnt++;
+        _ngrabbed++;
+
+        FrameSet fs;
+        fs.frame = frame;
+        fs.fmt = fmt;
+        fs.ts = _source->getTimestamp();
+        fs.ms = _source->getMsSinceMidnight();
+        fs.t_grab = t_grab;
+
+        if (!_pool) {
+            /// Process in this thread and add to queue.
+            preprocess(fs.frame, fs.fmt, fs.remap, _workers[0]);
+            if (!keep_src) { recycleGrabBuffer(fs.frame); }
+            if (!deliver(std::move(fs))) { break; }
+
+            LOG_DBG("Processed frame added to input queue (l = %zd).", getStats().q_depth);
+            continue;
         }
 
-        // compute window min/max
-        uint8_t* pthrmax = thresh_max.data;
-        uint8_t* pthrmin = thresh_min.data;
-        for (int j = 0; j < _rw; j++) {
-            for (int i = 0; i < _rh; i++) {
-
-                // add row
-                max = 0; min = 255;
-                if ((i + _thresh_rad) < _rh) {
-                    const uint8_t* pmask = _remap_mask.ptr(i + _thresh_rad);
-                    const uint8_t* pgrey = remap_blur.ptr(i + _thresh_rad);
-                    for (int s = -_thresh_rad; s <= _thresh_rad; s++) {
-                        const int js = j + s;
-                        if ((js < 0) || (js >= _rw)) { continue; }
-                        if (pmask[js] < 255) { continue; }
-                        const uint8_t& g = pgrey[js];
-                        if ((g > max) && (g < 255)) { max = g; }	// ignore overexposed regions
-                        if (g < min) { min = g; }
-                    }
-                }
-                else {
-                    // pre-fill next cols
-                    const uint8_t* pmask = _remap_mask.ptr(i + _thresh_rad - _rh);
-                    uint8_t* pgrey = remap_blur.ptr(i + _thresh_rad - _rh);
-                    for (int s = -_thresh_rad; s <= _thresh_rad; s++) {
-                        const int js = j + s + 1;
-                        if ((js < 0) || (js >= _rw)) { continue; }
-                        if (pmask[js] < 255) { continue; }
-                        const uint8_t& g = pgrey[js];
-                        if ((g > max) && (g < 255)) { max = g; }	// ignore overexposed regions
-                        if (g < min) { min = g; }
-                    }
-                }
-                win_max_hist[win_it] = max;
-                win_min_hist[win_it] = min;
-
-                // find window max/min
-                max = 0; min = 255;
-                for (int k = 0; k < _thresh_win; k++) {
-                    int ik = i + _thresh_rad - k;
-                    if ((ik >= _rh) || (ik < 0)) { continue; }
-                    int wk = win_it - k;
-                    if (wk < 0) { wk += _thresh_win; }
-                    uint8_t mx = win_max_hist[wk];
-                    if (mx > max) { max = mx; }
-                    uint8_t mn = win_min_hist[wk];
-                    if (mn < min) { min = mn; }
-                }
-                pthrmax[i*thresh_max.step + j] = max;
-                pthrmin[i*thresh_min.step + j] = min;
-                if (++win_it >= _thresh_win) { win_it -= _thresh_win; }
-            }
+        /// Hand frame to a worker; frames are released to the queue strictly in grab order.
+        {
+            std::lock_guard<std::mutex> l(_reorder_mutex);
+            _inflight++;
         }
+        unsigned int s = seq++;
+        _pool->push([this, s, fs, keep_src](int id) mutable {
+            preprocess(fs.frame, fs.fmt, fs.remap, _workers[id]);
+            if (!keep_src) { recycleGrabBuffer(fs.frame); }
+
+            // never wait on the output queue here (the pool may be shared), the grab thread delivers in order
+            std::lock_guard<std::mutex> l(_reorder_mutex);
+            _reorder_buf.emplace(s, std::move(fs));
+            _inflight_cond.notify_all();
+        });
+    }
 
-        // apply thresholding
-        for (int i = 0; i < _rh; i++) {
-            const uint8_t* pmask = _remap_mask.ptr(i);
-            uint8_t* premap = remap_grey.ptr(i);
-            uint8_t* pthrmin = thresh_min.ptr(i);
-            uint8_t* pthrmax = thresh_max.ptr(i);
-            for (int j = 0; j < _rw; j++) {
-                if (pmask[j] != 255) {
-                    premap[j] = 128;
-                    continue;
-                }
-                if ((_thresh_ratio*(premap[j] - pthrmin[j])) <= (pthrmax[j] - premap[j])) {
-                    premap[j] = 0;
-                }
-                else {
-                    premap[j] = 255;
-                }
-            }
+    /// Wait for outstanding frames to be delivered (or discarded if the queue was closed).
+    if (_pool) {
+        std::unique_lock<std::mutex> l(_reorder_mutex);
+        while (_inflight > 0) {
+            _inflight_cond.wait(l, [&] { return nextReady(); });
+            deliverReady(l);
         }
-
-        /// Re-obtain lock and add processed frame to queue.
-        l.lock();
-        _frame_q.push_back(frame_bgr);
-        _remap_q.push_back(remap_grey);
-        _ts_q.push_back(timestamp);
-        _ms_q.push_back(ms_since_midnight);
-        _qCond.notify_all();
-        size_t q_size = _frame_q.size();
-        l.unlock();
-        
-        LOG_DBG("Processed frame added to input queue (l = %zd).", q_size);
     }
+    if (_frame_q) { flushOverflow(); }
+    closeQueue();   // consumer drains remaining frames before quitting
 
     LOG_DBG("Stopping frame grabbing loop!");
 }
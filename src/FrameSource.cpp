@@ -0,0 +1,96 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       FrameSource.cpp
+/// \brief      Abstract template for frame sources.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "FrameSource.h"
+
+/// OpenCV individual includes required by gcc?
+#include <opencv2/imgproc.hpp>
+
+using cv::Mat;
+
+///
+/// Capture frame and convert to BGR.
+///
+bool FrameSource::grab(Mat& frame)
+{
+    Mat native;
+    PIXEL_FORMAT fmt = PIXEL_BGR8;
+    if (!grabNative(native, fmt)) { return false; }
+    toBGR(native, fmt, frame);
+    return true;
+}
+
+///
+/// Convert native frame to BGR.
+///
+void FrameSource::toBGR(const Mat& src, PIXEL_FORMAT fmt, Mat& dst)
+{
+    switch (fmt) {
+    case PIXEL_MONO8:
+        cv::cvtColor(src, dst, cv::COLOR_GRAY2BGR);
+        break;
+    case PIXEL_BAYER_BGGR:
+        cv::cvtColor(src, dst, cv::COLOR_BayerBG2BGR);
+        break;
+    case PIXEL_BAYER_GBRG:
+        cv::cvtColor(src, dst, cv::COLOR_BayerGB2BGR);
+        break;
+    case PIXEL_BAYER_GRBG:
+        cv::cvtColor(src, dst, cv::COLOR_BayerGR2BGR);
+        break;
+    case PIXEL_BAYER_RGGB:
+        cv::cvtColor(src, dst, cv::COLOR_BayerRG2BGR);
+        break;
+    case PIXEL_BGR8:
+    default:
+        dst = src;
+        break;
+    }
+}
+
+///
+/// Convert native frame to grey, demosaicing Bayer frames straight to grey.
+///
+void FrameSource::toGrey(const Mat& src, PIXEL_FORMAT fmt, Mat& dst)
+{
+    switch (fmt) {
+    case PIXEL_MONO8:
+        dst = src;
+        break;
+    case PIXEL_BAYER_BGGR:
+        cv::cvtColor(src, dst, cv::COLOR_BayerBG2GRAY);
+        break;
+    case PIXEL_BAYER_GBRG:
+        cv::cvtColor(src, dst, cv::COLOR_BayerGB2GRAY);
+        break;
+    case PIXEL_BAYER_GRBG:
+        cv::cvtColor(src, dst, cv::COLOR_BayerGR2GRAY);
+        break;
+    case PIXEL_BAYER_RGGB:
+        cv::cvtColor(src, dst, cv::COLOR_BayerRG2GRAY);
+        break;
+    case PIXEL_BGR8:
+    default:
+        cv::cvtColor(src, dst, cv::COLOR_BGR2GRAY);
+        break;
+    }
+}
+
+///
+/// Format of single channel frames, according to the configured Bayer type.
+///
+PIXEL_FORMAT FrameSource::monoFormat() const
+{
+    switch (_bayerType) {
+    case BAYER_RGGB: return PIXEL_BAYER_RGGB;
+    case BAYER_GRBG: return PIXEL_BAYER_GRBG;
+    case BAYER_GBRG: return PIXEL_BAYER_GBRG;
+    case BAYER_BGGR: return PIXEL_BAYER_BGGR;
+    case BAYER_NONE:
+    default:
+        return PIXEL_MONO8;
+    }
+}
@@ -0,0 +1,108 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       LatencyHist.cpp
+/// \brief      Fixed-size log-linear histogram for timing statistics.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "LatencyHist.h"
+
+#include <algorithm>    // min/max
+#include <cmath>        // round
+
+/// 32 linear sub-bins per power of two.
+const unsigned int SUB_BITS = 5;
+const unsigned int SUB_BINS = 1 << SUB_BITS;
+const unsigned int NUM_BINS = (64 - SUB_BITS) * SUB_BINS;
+
+///
+/// Constructor.
+///
+LatencyHist::LatencyHist(double unit)
+    : _unit(unit > 0 ? unit : 1e-3), _bins(NUM_BINS, 0)
+{
+    reset();
+}
+
+///
+/// Bin index for quantised value. Values < SUB_BINS map directly to their own bin,
+/// larger values keep their top SUB_BITS + 1 significant bits.
+///
+unsigned int LatencyHist::bin(uint64_t q)
+{
+    if (q < SUB_BINS) { return static_cast<unsigned int>(q); }
+    unsigned int msb = 63;
+    while (!(q >> msb)) { msb--; }
+    unsigned int shift = msb - SUB_BITS;
+    return (shift + 1) * SUB_BINS + static_cast<unsigned int>((q >> shift) - SUB_BINS);
+}
+
+///
+/// Mid-point value of bin.
+///
+double LatencyHist::binValue(unsigned int b) const
+{
+    if (b < SUB_BINS) { return b * _unit; }
+    unsigned int shift = b / SUB_BINS - 1;
+    uint64_t lo = static_cast<uint64_t>(SUB_BINS + (b % SUB_BINS)) << shift;
+    uint64_t w = 1ULL << shift;
+    return (lo + 0.5 * (w - 1)) * _unit;
+}
+
+void LatencyHist::add(double val)
+{
+    if (!(val >= 0)) { val = 0; }   // also catches NaN
+    double q = std::round(val / _unit);
+    uint64_t qi = q < 1.8e19 ? static_cast<uint64_t>(q) : UINT64_MAX;
+    _bins[std::min(bin(qi), NUM_BINS - 1)]++;
+    if (_count == 0) { _min = _max = val; }
+    else {
+        _min = std::min(_min, val);
+        _max = std::max(_max, val);
+    }
+    _count++;
+    _sum += val;
+}
+
+void LatencyHist::merge(const LatencyHist& other)
+{
+    if (other._count == 0) { return; }
+    if (other._unit != _unit) {
+        // different resolution - re-bin at other's bin values
+        for (unsigned int b = 0; b < NUM_BINS; b++) {
+            if (other._bins[b] == 0) { continue; }
+            double q = std::round(other.binValue(b) / _unit);
+            _bins[std::min(bin(static_cast<uint64_t>(q)), NUM_BINS - 1)] += other._bins[b];
+        }
+    }
+    else {
+        for (unsigned int b = 0; b < NUM_BINS; b++) { _bins[b] += other._bins[b]; }
+    }
+    _min = (_count > 0) ? std::min(_min, other._min) : other._min;
+    _max = (_count > 0) ? std::max(_max, other._max) : other._max;
+    _count += other._count;
+    _sum += other._sum;
+}
+
+void LatencyHist::reset()
+{
+    std::fill(_bins.begin(), _bins.end(), 0);
+    _count = 0;
+    _sum = _min = _max = 0;
+}
+
+double LatencyHist::percentile(double pc) const
+{
+    if (_count == 0) { return 0; }
+    pc = std::max(0.0, std::min(100.0, pc));
+    uint64_t rank = static_cast<uint64_t>(std::ceil(pc / 100 * _count));
+    if (rank < 1) { rank = 1; }
+    uint64_t n = 0;
+    for (unsigned int b = 0; b < NUM_BINS; b++) {
+        n += _bins[b];
+        if (n >= rank) {
+            // clamp to observed range, so p0/p100 are exact
+            return std::max(_min, std::min(_max, binValue(b)));
+        }
+    }
+    return _max;
+}
@@ -54,16 +54,27 @@ double Localiser::search(Mat& roi_frame, Mat& R_roi, CmPoint64f& vx)
     return getOptF();
 }
 
+///
+///
+///
+double Localiser::evaluate(const Mat& roi_frame, const Mat& R_roi, const CmPoint64f& vx)
+{
+    _roi_frame = roi_frame;
+    _R_roi = reinterpret_cast<const double*>(R_roi.data);
+    double x[3] = { vx[0], vx[1], vx[2] };
+    return testRotation(x);
+}
+
 ///
 ///
 ///
 double Localiser::testRotation(const double x[3])
 {
-    static double lmat[9];
+    double lmat[9];
     CmPoint64f tmp(x[0], x[1], x[2]);
     tmp.omegaToMatrix(lmat);            // relative rotation in camera frame
     const double* rmat = _R_roi;        // pre-multiply to orientation matrix
-    static double m[9];                 // absolute orientation in camera frame
+    double m[9];                        // absolute orientation in camera frame
 
     m[0] = lmat[0] * rmat[0] + lmat[1] * rmat[3] + lmat[2] * rmat[6];
     m[1] = lmat[0] * rmat[1] + lmat[1] * rmat[4] + lmat[2] * rmat[7];
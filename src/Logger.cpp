@@ -1,48 +1,232 @@
 /// FicTrac http://rjdmoore.net/fictrac/
 /// \file       Logger.cpp
-/// \brief      Simple thread-safe logger.
+/// \brief      Thread-safe logger with deferred formatting.
 /// \author     Richard Moore
 /// \copyright  CC BY-NC-SA 3.0
 
 #include "Logger.h"
 
+#include "FileRecorder.h"
+#include "SPSCRing.h"
 #include "timing.h"
 
-#include <cstdio>   // vsnprintf
-#include <cstdarg>  // va_list, va_start, va_end
+#include <algorithm>    // stable_sort, remove_if
+#include <atomic>
+#include <condition_variable>
 #include <iostream> // cout
+#include <map>
+#include <memory>   // shared_ptr, unique_ptr
+#include <mutex>
+#include <numeric>  // iota
+#include <thread>
+#include <vector>
 
 using namespace std;
 
-Logger::Logger()
+/// Messages each thread can queue before it has to wait for the writer.
+const size_t LOG_RING_LEN = 512;
+/// How often queued messages are written (warnings, errors and PRINTs are written straight away).
+const int LOG_WRITE_MS = 50;
+
+namespace {
+
+const char* const LogLevelStrings[4] = { "DBG", "INF", "WRN", "ERR" };
+
+struct LogBuffer
+{
+    SPSCRing<Logger::Record> ring;
+
+    LogBuffer() : ring(LOG_RING_LEN, WaitEvent::BLOCK) {}
+};
+
+struct LogState
 {
-    // create log writer
-    string fn = string("fictrac-") + execTime() + ".log";
-    _log = make_unique<Recorder>(RecorderInterface::RecordType::FILE, fn);
-    _cout = make_unique<Recorder>(RecorderInterface::RecordType::TERM);
-    if (_log->is_active() && _cout->is_active()) {
-        cout << "Initialised logging to " << fn << endl;
-    } else {
-        cerr << "Error opening log file (" << fn << ") or cout stream!" << endl;
+    mutex mtx;                              // guards buffers, flush_*
+    vector<shared_ptr<LogBuffer>> buffers;  // one per thread that has logged
+    uint64_t flush_req, flush_done;         // flush() calls, and how many of them have been written
+    condition_variable written;
+
+    WaitEvent wake;
+    atomic<bool> wake_req, stop;
+
+    FileRecorder file;      // compressed on this writer thread if the name ends in .gz
+    unique_ptr<thread> writer;
+
+    LogState() : flush_req(0), flush_done(0), wake(WaitEvent::BLOCK), wake_req(false), stop(false)
+    {
+        // create log writer
+        string fn = string("fictrac-") + execTime() + ".log";
+        if (Logger::fileCompression()) {
+            if (FileRecorder::gzipSupported()) { fn += ".gz"; }
+            else { cerr << "Warning! This build does not support compression, so the log file is not compressed." << endl; }
+        }
+        file.openRecord(fn);
+        if (file.is_open() && cout.good()) {
+            cout << "Initialised logging to " << fn << endl;
+        } else {
+            cerr << "Error opening log file (" << fn << ") or cout stream!" << endl;
+        }
+
+        writer = make_unique<thread>(&LogState::run, this);
+    }
+
+    ~LogState()
+    {
+        stop = true;
+        wake.notify();
+        writer->join();
+
+        // anything logged from here on is dropped rather than left waiting for the writer
+        lock_guard<mutex> l(mtx);
+        for (auto& b : buffers) { b->ring.close(); }
+    }
+
+    void request()
+    {
+        wake_req.store(true, memory_order_release);
+        wake.notify();
     }
+
+    ///
+    /// Writer thread: every LOG_WRITE_MS (or when woken), format everything queued and write it in one go.
+    ///
+    void run()
+    {
+        vector<Logger::Record> recs;
+        vector<size_t> order;
+        string out_cout, out_file;
+        char msg[Logger::MSG_MAX], line[Logger::MSG_MAX + 128];
+
+        bool stopping = false;
+        while (!stopping) {
+            wake.wait([&] { return wake_req.load(memory_order_acquire) || stop.load(memory_order_acquire); }, LOG_WRITE_MS);
+            stopping = stop.load(memory_order_acquire);
+            wake_req.store(false, memory_order_relaxed);
+
+            /// Drain all threads' rings (dropping rings whose thread has exited).
+            recs.clear();
+            uint64_t req;
+            {
+                lock_guard<mutex> l(mtx);
+                req = flush_req;
+                for (auto& b : buffers) {
+                    Logger::Record rec;
+                    while (b->ring.tryPop(rec)) { recs.push_back(rec); }
+                }
+                buffers.erase(remove_if(buffers.begin(), buffers.end(), [](const shared_ptr<LogBuffer>& b) {
+                    return (b.use_count() == 1) && b->ring.empty();
+                }), buffers.end());
+            }
+
+            /// Interleave threads' messages in the order they were logged.
+            order.resize(recs.size());
+            iota(order.begin(), order.end(), 0);
+            stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return recs[a].t < recs[b].t; });
+
+            out_cout.clear();
+            out_file.clear();
+            for (size_t i : order) {
+                const Logger::Record& rec = recs[i];
+                int n = rec.format(msg, sizeof(msg), rec.fmt, rec.args);
+                if (n < 0) { continue; }
+                if (rec.to_cout) {
+                    out_cout += rec.tag;
+                    out_cout += msg;
+                    out_cout += '\n';
+                }
+                // don't log display text to file (but log everything else)
+                if (rec.to_file) {
+                    n = snprintf(line, sizeof(line), "%f %s [%s] %s%s\n", rec.t, rec.func, LogLevelStrings[rec.lvl], rec.tag, msg);
+                    if (n > 0) { out_file.append(line, min<size_t>(n, sizeof(line) - 1)); }
+                }
+            }
+
+            if (!out_cout.empty()) {
+                cout.write(out_cout.data(), out_cout.size());
+                cout.flush();
+            }
+            if (!out_file.empty() && file.is_open()) {
+                file.writeRecord(out_file);
+            }
+
+            {
+                lock_guard<mutex> l(mtx);
+                flush_done = req;
+            }
+            written.notify_all();
+        }
+    }
+};
+
+LogState& state()
+{
+    static LogState s;   // *the* logger instance
+    return s;
 }
 
-Logger::~Logger()
+Logger::Sink& directSink()
 {
+    static Logger::Sink sink;
+    return sink;
 }
 
-void Logger::setVerbosity(std::string v) {
+/// Thread tag -> message prefix. Never erased (or destroyed), so queued records can point at them.
+struct TagMap
+{
+    mutex mtx;
+    map<string, string> prefixes;
+};
+
+TagMap& tags()
+{
+    static TagMap* t = new TagMap();
+    return *t;
+}
+
+thread_local shared_ptr<LogBuffer> t_buf;
+thread_local string t_tag;
+thread_local const char* t_prefix = "";
+
+///
+/// Calling thread's message ring, created on first use.
+///
+LogBuffer* threadBuffer()
+{
+    if (!t_buf) {
+        LogState& s = state();
+        lock_guard<mutex> l(s.mtx);
+        t_buf = make_shared<LogBuffer>();
+        s.buffers.push_back(t_buf);
+    }
+    return t_buf.get();
+}
+
+bool parseLevel(const string& v, Logger::LogLevel& lvl)
+{
     if ((v.compare("debug") == 0) || (v.compare("DBG") == 0) || (v.compare("dbg") == 0)) {
-        setVerbosity(DBG);
+        lvl = Logger::DBG;
     }
     else if ((v.compare("info") == 0) || (v.compare("INF") == 0) || (v.compare("inf") == 0)) {
-        setVerbosity(INF);
+        lvl = Logger::INF;
     }
     else if ((v.compare("warn") == 0) || (v.compare("WRN") == 0) || (v.compare("wrn") == 0)) {
-        setVerbosity(WRN);
+        lvl = Logger::WRN;
     }
     else if ((v.compare("error") == 0) || (v.compare("ERR") == 0) || (v.compare("err") == 0)) {
-        setVerbosity(ERR);
+        lvl = Logger::ERR;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+}   // namespace
+
+void Logger::setVerbosity(std::string v) {
+    LogLevel lvl;
+    if (parseLevel(v, lvl)) {
+        setVerbosity(lvl);
     }
     else {
         setVerbosity(INF);
@@ -50,32 +234,78 @@ void Logger::setVerbosity(std::string v) {
     }
 }
 
-/// Thread-safe printf wrapper.
-void Logger::mprintf(LogLevel lvl, string func, string format, ...)
+void Logger::setDirect(Sink sink)
 {
-    static Logger log;   // *the* logger instance
+    directSink() = sink;
+    direct() = true;
+}
 
-    static const int buf_size = 1024;
-    static char buf[buf_size];
+void Logger::setFileVerbosity(std::string v) {
+    LogLevel lvl;
+    if (parseLevel(v, lvl)) {
+        setFileVerbosity(lvl);
+    }
+    else {
+        setFileVerbosity(DBG);
+        LOG_WRN("Warning, log file verbosity (%s) not recognised! Defaulting to DEBUG.", v.c_str());
+    }
+}
 
-    // not re-entrant
-    lock_guard<mutex> l1(log._pMutex);
+///
+/// Queue a message. Only blocks if this thread has filled its ring faster than the writer can empty it.
+///
+void Logger::push(Record& rec)
+{
+    rec.t = elapsed_secs();
+    rec.to_cout = (rec.lvl == PRT) || (rec.lvl >= verbosity());
+    rec.to_file = (rec.lvl != PRT) && (rec.lvl >= fileVerbosity());
+    rec.tag = t_prefix;
 
-    // expand args
-    va_list args;
-    va_start(args, format);
-    vsnprintf(buf, buf_size, format.c_str(), args);
-    va_end(args);
+    if (direct()) {
+        if (!rec.to_cout) { return; }
+        char msg[MSG_MAX];
+        if (rec.format(msg, sizeof(msg), rec.fmt, rec.args) < 0) { return; }
+        string line = string(rec.tag) + msg;
+        if (directSink()) { directSink()(rec.lvl, line.c_str()); }
+        else { cout << line << endl; }
+        return;
+    }
 
-    // print and log
-    if ((int)lvl >= (int)verbosity()) {
-        // async printing to console
-        log._cout->addMsg(string(buf) + "\n");
+    LogState& s = state();
+    LogBuffer* buf = threadBuffer();
+    if (!buf->ring.tryPush(std::move(rec))) {
+        s.request();
+        buf->ring.push(std::move(rec));
     }
+    if (rec.lvl >= WRN) {
+        s.request();
+    }
+}
 
-    // don't log display text to file (but log everything else)
-    if (lvl != PRT) {
-        // async logging to file (with additional info)
-        log._log->addMsg(to_string(elapsed_secs()) + " " + func + " [" + log.LogLevelStrings[lvl] + "] " + buf + "\n");
+void Logger::flush()
+{
+    if (direct()) { return; }      // nothing queued
+    LogState& s = state();
+    unique_lock<mutex> l(s.mtx);
+    uint64_t req = ++s.flush_req;
+    s.request();
+    s.written.wait(l, [&] { return (s.flush_done >= req) || s.stop; });
+}
+
+void Logger::setThreadTag(const std::string& tag)
+{
+    t_tag = tag;
+    if (tag.empty()) {
+        t_prefix = "";
+        return;
     }
+    TagMap& t = tags();
+    lock_guard<mutex> l(t.mtx);
+    auto it = t.prefixes.emplace(tag, "[" + tag + "] ").first;
+    t_prefix = it->second.c_str();
+}
+
+std::string Logger::threadTag()
+{
+    return t_tag;
 }
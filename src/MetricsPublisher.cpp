@@ -0,0 +1,253 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       MetricsPublisher.cpp
+/// \brief      Periodic metrics snapshots over UDP, or served over TCP, as Prometheus text or JSON.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "MetricsPublisher.h"
+
+#include "Logger.h"
+#include "misc.h"   // thread priority
+#include "timing.h" // ficsleep
+#include "Trace.h"
+
+#include <algorithm>    // sort, min
+#include <chrono>
+#include <cmath>    // isfinite
+#include <cstdio>   // snprintf
+
+using namespace std;
+using boost::asio::ip::udp;
+using boost::asio::ip::tcp;
+
+/// How often the TCP listener checks for new connections.
+const int METRICS_ACCEPT_POLL_MS = 50;
+/// How long to wait for a client's request before answering anyway.
+const int METRICS_REQUEST_WAIT_MS = 200;
+
+namespace {
+
+string fmtValue(double v, bool json)
+{
+    if (!std::isfinite(v)) {
+        if (json) { return "null"; }
+        return std::isnan(v) ? "NaN" : (v > 0 ? "+Inf" : "-Inf");
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.6g", v);
+    return buf;
+}
+
+string escape(const string& s)
+{
+    string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        if ((c == '"') || (c == '\\')) { out += '\\'; }
+        if (c == '\n') { out += "\\n"; continue; }
+        out += c;
+    }
+    return out;
+}
+
+}   // namespace
+
+///
+///
+///
+MetricsPublisher::MetricsPublisher(function<Metrics()> snapshot, Transport transport, string host, int port,
+    Format format, int period_ms, string prefix)
+    : _snapshot(snapshot), _transport(transport), _format(format), _host(host), _prefix(prefix),
+    _port(port), _period_ms(std::max(period_ms, 1)), _active(false)
+{
+    try {
+        auto addr = boost::asio::ip::address::from_string(_host);
+        if (_transport == UDP) {
+            LOG("Publishing metrics to UDP %s:%d every %d ms", _host.c_str(), _port, _period_ms);
+            _endpoint = udp::endpoint(addr, _port);
+            _udp = make_unique<udp::socket>(_io_service);
+            _udp->open(_endpoint.protocol());
+        }
+        else {
+            LOG("Serving metrics on TCP %s:%d", _host.c_str(), _port);
+            _acceptor = make_unique<tcp::acceptor>(_io_service, tcp::endpoint(addr, _port));
+            _acceptor->non_blocking(true);
+        }
+        _active = true;
+    }
+    catch (const boost::system::system_error& e) {
+        LOG_ERR("Error! Could not open metrics %s socket (%s:%d) due to %s", _transport == UDP ? "UDP" : "TCP", _host.c_str(), _port, e.what());
+        return;
+    }
+
+    _thread = make_unique<thread>([this, tag = Logger::threadTag()] {
+        Logger::setThreadTag(tag);
+        run();
+    });
+}
+
+///
+///
+///
+MetricsPublisher::~MetricsPublisher()
+{
+    unique_lock<mutex> l(_mutex);
+    _active = false;
+    _cond.notify_all();
+    l.unlock();
+
+    if (_thread && _thread->joinable()) {
+        _thread->join();
+    }
+}
+
+///
+///
+///
+void MetricsPublisher::run()
+{
+    if (!SetThreadNormalPriority()) {
+        LOG_ERR("Error! Metrics thread unable to set thread priority!");
+    }
+    Trace::setThreadName("metrics");
+
+    const int tick_ms = (_transport == TCP) ? std::min(METRICS_ACCEPT_POLL_MS, _period_ms) : _period_ms;
+
+    unique_lock<mutex> l(_mutex);
+    while (_active) {
+        _cond.wait_for(l, chrono::milliseconds(tick_ms));
+        if (!_active) { break; }
+        l.unlock();
+
+        if (_transport == UDP) { sendDatagram(); }
+        else { serveClients(); }
+
+        l.lock();
+    }
+}
+
+///
+///
+///
+string MetricsPublisher::snapshot()
+{
+    Metrics metrics = _snapshot();
+    return (_format == JSON) ? formatJSON(metrics) + "\n" : formatPrometheus(metrics, _prefix);
+}
+
+///
+///
+///
+void MetricsPublisher::sendDatagram()
+{
+    boost::system::error_code ec;
+    _udp->send_to(boost::asio::buffer(snapshot()), _endpoint, 0, ec);
+    if (ec) {
+        LOG_DBG("Error sending metrics to %s:%d (%s)", _host.c_str(), _port, ec.message().c_str());
+    }
+}
+
+///
+/// Answer all pending connections, then return.
+///
+void MetricsPublisher::serveClients()
+{
+    while (_active) {
+        boost::system::error_code ec;
+        tcp::socket sock(_io_service);
+        _acceptor->accept(sock, ec);
+        if (ec) { return; }     // usually would_block
+
+        /// Drain the request (if the client sends one) so closing doesn't reset the connection before it reads the reply.
+        sock.non_blocking(true, ec);
+        string req;
+        char buf[1024];
+        auto tend = chrono::steady_clock::now() + chrono::milliseconds(METRICS_REQUEST_WAIT_MS);
+        while ((req.find("\r\n\r\n") == string::npos) && (req.find("\n\n") == string::npos) && (chrono::steady_clock::now() < tend)) {
+            size_t n = sock.read_some(boost::asio::buffer(buf), ec);
+            if (ec == boost::asio::error::would_block) {
+                ficsleep(5);
+                continue;
+            }
+            if (ec) { break; }
+            req.append(buf, n);
+        }
+
+        string body = snapshot();
+        string resp = "HTTP/1.0 200 OK\r\nContent-Type: ";
+        resp += (_format == JSON) ? "application/json" : "text/plain; version=0.0.4";
+        resp += "\r\nContent-Length: " + to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+
+        sock.non_blocking(false, ec);
+        boost::asio::write(sock, boost::asio::buffer(resp), ec);
+        if (ec) {
+            LOG_DBG("Error serving metrics (%s)", ec.message().c_str());
+        }
+        sock.shutdown(tcp::socket::shutdown_both, ec);
+        sock.close(ec);
+    }
+}
+
+///
+///
+///
+string MetricsPublisher::formatPrometheus(const Metrics& metrics, const string& prefix)
+{
+    string s;
+    s.reserve(64 * metrics.size());
+    for (auto& m : metrics) {
+        s += prefix + m.name;
+        if (!m.labels.empty()) {
+            s += '{';
+            for (size_t i = 0; i < m.labels.size(); i++) {
+                if (i > 0) { s += ','; }
+                s += m.labels[i].first + "=\"" + escape(m.labels[i].second) + '"';
+            }
+            s += '}';
+        }
+        s += ' ' + fmtValue(m.value, false) + '\n';
+    }
+    return s;
+}
+
+///
+/// e.g. {"fps_in":100,"stage_ms":{"track.opt":{"p50":1.2,"p99":2.5}}}
+///
+string MetricsPublisher::formatJSON(const Metrics& metrics)
+{
+    /// Key path for each metric: name, then label values.
+    vector<pair<vector<string>, double>> paths;
+    paths.reserve(metrics.size());
+    for (auto& m : metrics) {
+        vector<string> path(1, m.name);
+        for (auto& lbl : m.labels) { path.push_back(lbl.second); }
+        paths.push_back(make_pair(path, m.value));
+    }
+    stable_sort(paths.begin(), paths.end(), [](const pair<vector<string>, double>& a, const pair<vector<string>, double>& b) {
+        return a.first < b.first;
+    });
+
+    /// Emit sorted paths as nested objects, closing and opening levels where consecutive paths diverge.
+    string s = "{";
+    vector<string> open;
+    bool first = true;
+    for (auto& p : paths) {
+        const vector<string>& path = p.first;
+        size_t common = 0;
+        while ((common < open.size()) && (common + 1 < path.size()) && (open[common] == path[common])) { common++; }
+        while (open.size() > common) {
+            s += '}';
+            open.pop_back();
+        }
+        if (!first) { s += ','; }
+        first = false;
+        for (size_t i = common; i + 1 < path.size(); i++) {
+            s += '"' + escape(path[i]) + "\":{";
+            open.push_back(path[i]);
+        }
+        s += '"' + escape(path.back()) + "\":" + fmtValue(p.second, true);
+    }
+    s.append(open.size(), '}');
+    s += '}';
+    return s;
+}
@@ -229,7 +229,7 @@ bool PGRSource::setFPS(double fps)
     return ret;
 }
 
-bool PGRSource::grab(cv::Mat& frame)
+bool PGRSource::grabNative(cv::Mat& frame, PIXEL_FORMAT& fmt)
 {
 	if( !_open ) { return false; }
 
@@ -268,11 +268,26 @@ bool PGRSource::grab(cv::Mat& frame)
     }
 
     try {
-        // Convert image
-        ImagePtr bgr_image = pgr_image->Convert(PixelFormat_BGR8, NEAREST_NEIGHBOR);
+        // Deliver mono/Bayer frames as-is, only convert anything else
+        switch (pgr_image->GetPixelFormat()) {
+        case PixelFormat_Mono8:     fmt = PIXEL_MONO8; break;
+        case PixelFormat_BayerRG8:  fmt = PIXEL_BAYER_RGGB; break;
+        case PixelFormat_BayerGR8:  fmt = PIXEL_BAYER_GRBG; break;
+        case PixelFormat_BayerGB8:  fmt = PIXEL_BAYER_GBRG; break;
+        case PixelFormat_BayerBG8:  fmt = PIXEL_BAYER_BGGR; break;
+        default:                    fmt = PIXEL_BGR8; break;
+        }
+
+        if (fmt != PIXEL_BGR8) {
+            Mat tmp(_height, _width, CV_8UC1, pgr_image->GetData(), pgr_image->GetStride());
+            tmp.copyTo(frame);
+        }
+        else {
+            ImagePtr bgr_image = pgr_image->Convert(PixelFormat_BGR8, NEAREST_NEIGHBOR);
 
-        Mat tmp(_height, _width, CV_8UC3, bgr_image->GetData(), bgr_image->GetStride());
-        tmp.copyTo(frame);
+            Mat tmp(_height, _width, CV_8UC3, bgr_image->GetData(), bgr_image->GetStride());
+            tmp.copyTo(frame);
+        }
 
         // We have to release our original image to clear space on the buffer
         pgr_image->Release();
@@ -304,6 +319,28 @@ bool PGRSource::grab(cv::Mat& frame)
         _timestamp = ts;
     }
 
+    // Deliver mono/Bayer frames as-is, only convert anything else
+    fmt = PIXEL_BGR8;
+    if (frame_raw.GetPixelFormat() == PIXEL_FORMAT_MONO8) {
+        fmt = PIXEL_MONO8;
+    }
+    else if (frame_raw.GetPixelFormat() == PIXEL_FORMAT_RAW8) {
+        switch (frame_raw.GetBayerTileFormat()) {
+        case RGGB:  fmt = PIXEL_BAYER_RGGB; break;
+        case GRBG:  fmt = PIXEL_BAYER_GRBG; break;
+        case GBRG:  fmt = PIXEL_BAYER_GBRG; break;
+        case BGGR:  fmt = PIXEL_BAYER_BGGR; break;
+        case NONE:
+        default:    fmt = PIXEL_MONO8; break;
+        }
+    }
+
+    if (fmt != PIXEL_BGR8) {
+        Mat frame_cv(frame_raw.GetRows(), frame_raw.GetCols(), CV_8UC1, frame_raw.GetData(), frame_raw.GetStride());
+        frame_cv.copyTo(frame);
+        return true;
+    }
+
     Image frame_bgr;
     error = frame_raw.Convert(PIXEL_FORMAT_BGR, &frame_bgr);
     if (error != PGRERROR_OK) {
@@ -0,0 +1,73 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       PathIntegrator.cpp
+/// \brief      Integrate per-frame ball rotations into heading and fictive path.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "PathIntegrator.h"
+
+#include "typesvars.h"
+
+#include <cmath>
+
+using namespace std;
+
+///
+///
+///
+void PathIntegrator::reset()
+{
+    State s;
+    s.intx = _s.intx;
+    s.inty = _s.inty;
+    _s = s;
+    _prev_heading = 0;
+}
+
+///
+///
+///
+const PathIntegrator::State& PathIntegrator::update(const CmPoint64f& dr_lab)
+{
+    // running speed, radians/frame (-ve rotation around x-axis causes y-axis translation & vice-versa!!)
+    _s.velx = dr_lab[1];
+    _s.vely = -dr_lab[0];
+    _s.step_mag = sqrt(_s.velx * _s.velx + _s.vely * _s.vely);  // magnitude (radians) of ball rotation excluding turning (change in heading)
+
+    // running direction
+    _s.step_dir = atan2(_s.vely, _s.velx);
+    if (_s.step_dir < 0) { _s.step_dir += 360 * CM_D2R; }
+
+    // integrated x/y pos (optical mouse style)
+    _s.intx += _s.velx;
+    _s.inty += _s.vely;
+
+    // integrate bee heading
+    _s.heading -= dr_lab[2];
+    while (_s.heading < 0) { _s.heading += 360 * CM_D2R; }
+    while (_s.heading >= 360 * CM_D2R) { _s.heading -= 360 * CM_D2R; }
+    _s.ang_dist += abs(dr_lab[2]);
+
+    // integrate 2d position
+    {
+        const int steps = 4;	// increasing this doesn't help much
+        double step = _s.step_mag / steps;
+        double heading_step = (_s.heading - _prev_heading);
+        while (heading_step >= 180 * CM_D2R) { heading_step -= 360 * CM_D2R; }
+        while (heading_step < -180 * CM_D2R) { heading_step += 360 * CM_D2R; }
+        heading_step /= steps;  // do after wrapping above
+
+        // super-res integration
+        CmPoint64f dir(_s.velx, _s.vely, 0);
+        dir.normalise();
+        dir.rotateAboutNorm(CmPoint(0, 0, 1), _prev_heading + heading_step / 2.0);
+        for (int i = 0; i < steps; i++) {
+            _s.posx += step * dir[0];
+            _s.posy += step * dir[1];
+            dir.rotateAboutNorm(CmPoint(0, 0, 1), heading_step);
+        }
+        _prev_heading = _s.heading;
+    }
+
+    return _s;
+}
@@ -9,15 +9,24 @@
 #include "TermRecorder.h"
 #include "FileRecorder.h"
 #include "SocketRecorder.h"
+#include "SocketServerRecorder.h"
 #include "SerialRecorder.h"
-#include "misc.h"   // thread priority
+#include "ShmRecorder.h"
+#include "Logger.h"
+#include "misc.h"   // thread priority/affinity
+#include "Trace.h"
 
 #include <iostream> // cout/cerr
+#include <string_view>
+#include <vector>
 
 using namespace std;
 
-Recorder::Recorder(RecorderInterface::RecordType type, string fn)
-    : _active(false)
+/// Maximum number of messages written per batch.
+const size_t RECORDER_MAX_BATCH = 256;
+
+Recorder::Recorder(RecorderInterface::RecordType type, string fn, bool binary, size_t q_len, Overflow overflow)
+    : _active(false), _flush_ms(0), _overflow(overflow), _ndropped(0), _msgQ(q_len), _stop(WaitEvent::BLOCK)
 {
     /// Set record type.
     switch (type) {
@@ -25,22 +34,37 @@ Recorder::Recorder(RecorderInterface::RecordType type, string fn)
         _record = make_unique<TermRecorder>();
         break;
     case RecorderInterface::RecordType::FILE:
-        _record = make_unique<FileRecorder>();
+        _record = make_unique<FileRecorder>(binary);
         break;
     case RecorderInterface::RecordType::SOCK:
         _record = make_unique<SocketRecorder>();
         break;
+    case RecorderInterface::RecordType::SOCK_SERVER:
+        _record = make_unique<SocketServerRecorder>(q_len);
+        break;
     case RecorderInterface::RecordType::COM:
         _record = make_unique<SerialRecorder>();
         break;
+    case RecorderInterface::RecordType::SHM:
+        _record = make_unique<ShmRecorder>(static_cast<uint32_t>(q_len));
+        break;
     default:
         break;
     }
 
+    /// Asynchronous senders report latency once records have actually been sent.
+    _async_latency = _record && _record->setSentHandler([this](const vector<int64_t>& t_refs, int64_t t_sent) {
+        lock_guard<mutex> l(_latMutex);
+        for (auto t_ref : t_refs) { _latency.add((t_sent - t_ref) / 1e6); }
+    });
+
     /// Open record and start async recording.
     if (_record && _record->openRecord(fn)) {
         _active = true;
-        _thread = make_unique<thread>(&Recorder::processMsgQ, this);
+        _thread = make_unique<thread>([this, tag = Logger::threadTag()] {
+            Logger::setThreadTag(tag);
+            processMsgQ();
+        });
     }
     else {
         cerr << "Error initialising recorder!" << endl;
@@ -51,28 +75,47 @@ Recorder::~Recorder()
 {
     cout << "Closing recorder.." << endl;
 
-    unique_lock<mutex> l(_qMutex);
+    /// Writer drains remaining messages before exiting.
     _active = false;
-    _qCond.notify_all();
-    l.unlock();
+    _msgQ.close();
+    _stop.notify();
 
     if (_thread && _thread->joinable()) {
         _thread->join();
     }
 
-    /// _record->close() called by unique_ptr dstr.
+    /// _record->close() called by unique_ptr dstr (now, as it may still report latency).
+    _record.reset();
 }
 
-bool Recorder::addMsg(string msg)
+bool Recorder::addMsg(string msg, int64_t t_ref)
 {
-    bool ret = false;
-    lock_guard<mutex> l(_qMutex);
-    if (_active) {
-        _msgQ.push_back(msg);
-        _qCond.notify_all();
-        ret = true;
+    return addMsg(make_shared<const string>(std::move(msg)), 0, t_ref);
+}
+
+bool Recorder::addMsg(shared_ptr<const string> buf, size_t offset, int64_t t_ref)
+{
+    if (!_active) { return false; }
+    Msg msg = { std::move(buf), offset, t_ref };
+    if (_overflow == DROP) {
+        if (!_msgQ.tryPush(std::move(msg))) {
+            _ndropped++;
+            return false;
+        }
+        return true;
     }
-    return ret;
+    return _msgQ.push(std::move(msg));
+}
+
+LatencyHist Recorder::getLatency()
+{
+    lock_guard<mutex> l(_latMutex);
+    return _latency;
+}
+
+bool Recorder::setAffinity(const vector<int>& cpus)
+{
+    return _thread && SetThreadAffinity(*_thread, cpus);
 }
 
 void Recorder::processMsgQ()
@@ -81,25 +124,62 @@ void Recorder::processMsgQ()
     if (!SetThreadNormalPriority()) {
         cerr << "Error! Recorder processing thread unable to set thread priority!" << endl;
     }
+    Trace::setThreadName("recorder");
+
+    vector<Msg> batch;
+    vector<string_view> recs;
+    vector<RecorderInterface::Buffer> bufs;     // buffer holding each record (null if transformed)
+    vector<int64_t> t_refs;
+    vector<string> transformed;     // only used with a transform
+    batch.reserve(RECORDER_MAX_BATCH);
+    recs.reserve(RECORDER_MAX_BATCH);
+    bufs.reserve(RECORDER_MAX_BATCH);
+    t_refs.reserve(RECORDER_MAX_BATCH);
 
-    /// Get a un/lockable lock.
-    unique_lock<mutex> l(_qMutex);
-    while (_active) {
-        while (_msgQ.size() == 0) {
-            _qCond.wait(l);
-            if (!_active) { break; }
+    /// Keep going until closed and drained.
+    while (_msgQ.waitNotEmpty()) {
+        /// Let messages accumulate (unless we're closing).
+        int flush_ms = _flush_ms;
+        if (flush_ms > 0) {
+            _stop.wait([&] { return _msgQ.closed(); }, flush_ms);
         }
 
-        /// Process msg queue. Ignore _active while we have message still to process.
-        while (_msgQ.size() > 0) {
-            string msg = _msgQ.front();
-            _msgQ.pop_front();
-            l.unlock();
+        /// Take everything pending (up to batch limit) and write it in one go.
+        Msg msg;
+        while ((batch.size() < RECORDER_MAX_BATCH) && _msgQ.tryPop(msg)) {
+            string_view s = string_view(*msg.buf).substr(msg.offset);
+            if (_transform) {
+                if (transformed.empty()) { transformed.resize(RECORDER_MAX_BATCH); }
+                string& out = transformed[batch.size()];
+                if (_transform(s, out)) {
+                    recs.push_back(out);
+                    bufs.push_back(nullptr);
+                    t_refs.push_back(msg.t_ref);
+                }
+                else { msg.t_ref = -1; }   // nothing written, so no latency to measure
+            }
+            else {
+                recs.push_back(s);
+                bufs.push_back(msg.buf);
+                t_refs.push_back(msg.t_ref);
+            }
+            batch.push_back(std::move(msg));
+        }
+        if (!recs.empty()) {
+            TRACE_ZONE("rec.write");
+            _record->writeSharedRecords(recs, bufs, t_refs);
+        }
+        int64_t t_written = Trace::now();
 
-            // do async i/o
-            _record->writeRecord(msg);
-            l.lock();
+        if (!_async_latency) {
+            lock_guard<mutex> l(_latMutex);
+            for (auto& m : batch) {
+                if (m.t_ref >= 0) { _latency.add((t_written - m.t_ref) / 1e6); }
+            }
         }
+        recs.clear();
+        bufs.clear();
+        t_refs.clear();
+        batch.clear();      // release buffers for reuse
     }
-    l.unlock();
 }
@@ -0,0 +1,188 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       SegmentStitcher.cpp
+/// \brief      Join data tracked from overlapping segments of one video into a single data file.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "SegmentStitcher.h"
+
+#include "CmPoint.h"
+#include "DataRecord.h"
+#include "FileRecorder.h"
+#include "Logger.h"
+#include "PathIntegrator.h"
+
+#include <opencv2/core.hpp>
+
+#include <fstream>
+#include <limits>
+#include <map>
+
+using namespace std;
+
+namespace {
+
+///
+/// Open a binary data file and skip its header.
+///
+bool openSegment(ifstream& in, const string& fn, bool& lat_cols)
+{
+    in.open(fn, ios::in | ios::binary);
+    if (!in.is_open()) {
+        LOG_ERR("Error! Unable to open segment data file (%s).", fn.c_str());
+        return false;
+    }
+    string hdr(sizeof(DataHeader), '\0');
+    in.read(&hdr[0], hdr.size());
+    hdr.resize(static_cast<size_t>(in.gcount()));
+    size_t header_size = 0;
+    string err;
+    if (!parseDataFileHeader(hdr, lat_cols, header_size, err)) {
+        LOG_ERR("Error! Unable to read segment data file %s (%s).", fn.c_str(), err.c_str());
+        return false;
+    }
+    in.seekg(header_size);
+    return in.good();
+}
+
+}   // namespace
+
+///
+///
+///
+bool SegmentStitcher::stitch(const vector<Segment>& segs, const string& out_fn, bool binary, Stats& stats)
+{
+    stats = Stats();
+    if (segs.empty()) { return false; }
+
+    FileRecorder out(binary);
+    bool lat_cols = false;
+    PathIntegrator path;
+
+    const cv::Mat_<double> I = cv::Mat_<double>::eye(3, 3);
+    map<long, cv::Mat_<double>> prev_tail;  // corrected orientations of the previous segment's frames that this segment also tracked
+    DataRecord prev_out;                    // last record written
+    bool have_out = false;
+
+    for (size_t s = 0; s < segs.size(); s++) {
+        const Segment& seg = segs[s];
+        ifstream in;
+        bool seg_lat_cols = false;
+        if (!openSegment(in, seg.fn, seg_lat_cols)) { return false; }
+        if (s == 0) {
+            lat_cols = seg_lat_cols;
+            if (!out.openRecord(out_fn)) {
+                LOG_ERR("Error! Unable to open stitched output file (%s).", out_fn.c_str());
+                return false;
+            }
+            if (binary) {
+                string hdr = dataFileHeader(lat_cols);
+                out.writeRecord(hdr);
+            }
+        }
+        else if (seg_lat_cols != lat_cols) {
+            LOG_ERR("Error! Segment %s was recorded with different lat_cols to the previous segments.", seg.fn.c_str());
+            return false;
+        }
+
+        const long switch_idx = have_out ? static_cast<long>(prev_out.cnt) : -1;    // frames up to here come from earlier segments
+        const long next_start = (s + 1 < segs.size()) ? segs[s + 1].start : numeric_limits<long>::max();
+        map<long, cv::Mat_<double>> tail;
+
+        cv::Mat_<double> C = I.clone();     // re-references this segment's orientations to the stitched output
+        bool matched = (s == 0);
+        bool own_seq = (s == 0);            // after a reset, the segment's own seq is also correct for the output
+        bool path_reset = false;
+        bool first_take = true;
+        DataRecord prev_rec, rec;
+        bool have_rec = false;
+
+        while (in.read(reinterpret_cast<char*>(&rec), sizeof(rec))) {
+            const long idx = seg.start + static_cast<long>(rec.cnt);
+
+            /// seq counts every frame since the last reset, so if it didn't keep pace with cnt the tracker was reset.
+            bool reset = have_rec && (rec.seq != prev_rec.seq + (rec.cnt - prev_rec.cnt));
+            if (reset) {
+                C = I.clone();
+                own_seq = true;
+                path_reset = true;
+            }
+            prev_rec = rec;
+            have_rec = true;
+
+            const cv::Mat_<double> R_cam = CmPoint64f::omegaToMatrix(CmPoint64f(rec.r_cam[0], rec.r_cam[1], rec.r_cam[2]));
+
+            /// Overlap: output still comes from the earlier segment, so line up with it.
+            if (idx <= switch_idx) {
+                auto it = prev_tail.find(idx);
+                if (it != prev_tail.end()) {
+                    C = R_cam.t() * it->second;
+                    matched = true;
+                    own_seq = false;
+                    path_reset = false;
+                }
+                continue;
+            }
+
+            if (first_take && !matched) {
+                LOG_WRN("Warning! No frame tracked by both %s and the previous segment. Orientation and path may jump at frame %ld.", seg.fn.c_str(), idx);
+                stats.nunmatched++;
+            }
+            first_take = false;
+
+            DataRecord o = rec;
+            o.cnt = static_cast<uint64_t>(idx);
+
+            const cv::Mat_<double> R_cam_out = R_cam * C;
+            const cv::Mat_<double> R_lab_out = CmPoint64f::omegaToMatrix(CmPoint64f(rec.r_lab[0], rec.r_lab[1], rec.r_lab[2])) * C;
+            CmPoint64f r_cam = CmPoint64f::matrixToOmega(R_cam_out);
+            CmPoint64f r_lab = CmPoint64f::matrixToOmega(R_lab_out);
+            for (int i = 0; i < 3; i++) {
+                o.r_cam[i] = r_cam[i];
+                o.r_lab[i] = r_lab[i];
+            }
+
+            if (path_reset) {
+                path.reset();
+                stats.nresets++;
+                path_reset = false;
+            }
+            const PathIntegrator::State& p = path.update(CmPoint64f(rec.dr_lab[0], rec.dr_lab[1], rec.dr_lab[2]));
+            o.posx = p.posx;
+            o.posy = p.posy;
+            o.heading = p.heading;
+            o.step_dir = p.step_dir;
+            o.step_mag = p.step_mag;
+            o.intx = p.intx;
+            o.inty = p.inty;
+
+            o.seq = (own_seq || !have_out) ? rec.seq : (prev_out.seq + (o.cnt - prev_out.cnt));
+            o.dts = have_out ? (o.ts - prev_out.ts) : 0;
+
+            bool ok;
+            if (binary) {
+                ok = out.writeRecord(string_view(reinterpret_cast<const char*>(&o), sizeof(o)));
+            }
+            else {
+                char buf[DataRecord::TEXT_MAX];
+                ok = out.writeRecord(string_view(buf, o.formatText(buf, sizeof(buf), lat_cols)));
+            }
+            if (!ok) {
+                LOG_ERR("Error! Failed writing stitched output (%s).", out_fn.c_str());
+                return false;
+            }
+            stats.nrecs++;
+
+            if (idx >= next_start) { tail[idx] = R_cam_out; }
+            prev_out = o;
+            have_out = true;
+        }
+
+        LOG_DBG("Stitched %s (from frame %ld)", seg.fn.c_str(), seg.start);
+        prev_tail.swap(tail);
+    }
+
+    out.closeRecord();
+    LOG("Stitched %zu segments into %s (%lu records, %lu resets)", segs.size(), out_fn.c_str(), stats.nrecs, stats.nresets);
+    return true;
+}
@@ -79,11 +79,30 @@ bool SerialRecorder::openRecord(std::string port_baud)
 ///
 ///
 ///
-bool SerialRecorder::writeRecord(string s)
+bool SerialRecorder::writeRecord(string_view s)
 {
     if (_open) {
         try {
-            _port->write_some(asio::buffer(s));
+            _port->write_some(asio::buffer(s.data(), s.size()));
+        }
+        catch (const boost::exception &e) {
+            LOG_ERR("Error writing to serial port (%s)! Error was %s", _port_name.c_str(), boost::diagnostic_information(e).c_str());
+            return false;
+        }
+    }
+    return _open;
+}
+
+///
+///
+///
+bool SerialRecorder::writeRecords(const vector<string_view>& recs)
+{
+    if (_open) {
+        _bufs.clear();
+        for (auto& s : recs) { _bufs.push_back(asio::buffer(s.data(), s.size())); }
+        try {
+            asio::write(*_port, _bufs);     // gather write
         }
         catch (const boost::exception &e) {
             LOG_ERR("Error writing to serial port (%s)! Error was %s", _port_name.c_str(), boost::diagnostic_information(e).c_str());
@@ -0,0 +1,126 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       ShmRecorder.cpp
+/// \brief      Implementation of shared-memory recorder.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "ShmRecorder.h"
+
+#include "Logger.h"
+
+#include <cerrno>
+#include <cstring>  // memcpy, memset, strerror
+#include <new>      // placement new
+
+#if !defined(_WIN32)
+#include <fcntl.h>      // O_CREAT
+#include <sys/mman.h>   // shm_open, mmap
+#include <unistd.h>     // ftruncate, close
+#endif
+
+using namespace std;
+
+///
+///
+///
+ShmRecorder::ShmRecorder(uint32_t capacity)
+    : _hdr(nullptr), _slots(nullptr), _size(0)
+{
+    _type = SHM;
+
+    _capacity = 2;
+    while (_capacity < capacity) { _capacity <<= 1; }
+}
+
+///
+///
+///
+ShmRecorder::~ShmRecorder()
+{
+    closeRecord();
+}
+
+///
+///
+///
+bool ShmRecorder::openRecord(string name)
+{
+#if defined(_WIN32)
+    LOG_ERR("Error! Shared-memory output is not supported on Windows.");
+    return false;
+#else
+    _name = (!name.empty() && (name[0] == '/')) ? name : ("/" + name);
+
+    /// Start from a fresh segment, so readers still attached to a previous run see it close rather than reset.
+    shm_unlink(_name.c_str());
+    int fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        LOG_ERR("Error! Could not create shared memory %s (%s).", _name.c_str(), strerror(errno));
+        return false;
+    }
+
+    _size = sizeof(ShmHeader) + static_cast<size_t>(_capacity) * sizeof(ShmSlot);
+    void* p = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(_size)) == 0) {
+        p = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) {
+        LOG_ERR("Error! Could not map shared memory %s (%s).", _name.c_str(), strerror(errno));
+        shm_unlink(_name.c_str());
+        return false;
+    }
+
+    /// New segments are zero-filled, so every slot starts with seq 0 (no record).
+    _hdr = new (p) ShmHeader;
+    _slots = reinterpret_cast<ShmSlot*>(reinterpret_cast<char*>(p) + sizeof(ShmHeader));
+    memcpy(_hdr->magic, SHM_MAGIC, sizeof(SHM_MAGIC));
+    _hdr->version = SHM_VERSION;
+    _hdr->record_version = DATA_RECORD_VERSION;
+    _hdr->header_size = sizeof(ShmHeader);
+    _hdr->slot_size = sizeof(ShmSlot);
+    _hdr->capacity = _capacity;
+    _hdr->count.store(0, memory_order_relaxed);
+    _hdr->live.store(1, memory_order_release);
+
+    LOG("Publishing data to shared memory %s (%u records)", _name.c_str(), _capacity);
+    _open = true;
+    return true;
+#endif
+}
+
+///
+///
+///
+bool ShmRecorder::writeRecord(string_view s)
+{
+    if (!_open || (s.size() != sizeof(DataRecord))) { return false; }
+
+    /// Single writer, so count is only ever modified here.
+    const uint64_t n = _hdr->count.load(memory_order_relaxed);
+    ShmSlot& slot = _slots[n & (_capacity - 1)];
+
+    slot.seq.store(2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);     // readers that see any of the new bytes also see the odd seq
+    memcpy(&slot.rec, s.data(), sizeof(DataRecord));
+    slot.seq.store(2 * (n + 1), memory_order_release);
+    _hdr->count.store(n + 1, memory_order_release);
+    return true;
+}
+
+///
+///
+///
+void ShmRecorder::closeRecord()
+{
+#if !defined(_WIN32)
+    if (_hdr) {
+        _hdr->live.store(0, memory_order_release);
+        munmap(_hdr, _size);
+        shm_unlink(_name.c_str());
+    }
+#endif
+    _hdr = nullptr;
+    _slots = nullptr;
+    _open = false;
+}
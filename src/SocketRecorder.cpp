@@ -21,6 +21,8 @@
 #include <boost/asio.hpp>
 
 #include <string>
+#include <cerrno>
+#include <cstring>  // memset, strerror
 
 using namespace std;
 using boost::asio::ip::udp;
@@ -81,11 +83,11 @@ bool SocketRecorder::openRecord(std::string host_port)
 ///
 ///
 ///
-bool SocketRecorder::writeRecord(string s)
+bool SocketRecorder::writeRecord(string_view s)
 {
     if (_open) {
         try {
-            _socket.send_to(boost::asio::buffer(s), _endpoint);
+            _socket.send_to(boost::asio::buffer(s.data(), s.size()), _endpoint);
         }
         catch (const boost::system::system_error& e) {
             LOG_ERR("Error writing to socket (%s:%d)! Error was %s", _host.c_str(), _port, e.what());
@@ -95,6 +97,43 @@ bool SocketRecorder::writeRecord(string s)
     return _open;
 }
 
+///
+/// Each record is still sent as its own datagram, but on Linux the whole batch goes in one sendmmsg call.
+///
+bool SocketRecorder::writeRecords(const vector<string_view>& recs)
+{
+    if (!_open) { return false; }
+#ifdef __linux__
+    const size_t n = recs.size();
+    _msgs.resize(n);
+    _iovs.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        _iovs[i].iov_base = const_cast<char*>(recs[i].data());
+        _iovs[i].iov_len = recs[i].size();
+        memset(&_msgs[i], 0, sizeof(mmsghdr));
+        _msgs[i].msg_hdr.msg_name = _endpoint.data();
+        _msgs[i].msg_hdr.msg_namelen = static_cast<socklen_t>(_endpoint.size());
+        _msgs[i].msg_hdr.msg_iov = &_iovs[i];
+        _msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    size_t sent = 0;
+    while (sent < n) {
+        int ret = sendmmsg(_socket.native_handle(), &_msgs[sent], static_cast<unsigned int>(n - sent), 0);
+        if (ret < 0) {
+            if (errno == EINTR) { continue; }
+            LOG_ERR("Error writing to socket (%s:%d)! Error was %s", _host.c_str(), _port, strerror(errno));
+            return false;
+        }
+        sent += ret;
+    }
+    return true;
+#else
+    bool ret = true;
+    for (auto& s : recs) { ret &= writeRecord(s); }
+    return ret;
+#endif
+}
+
 ///
 ///
 ///
@@ -0,0 +1,305 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       SocketServerRecorder.cpp
+/// \brief      Implementation of stream socket (TCP/Unix domain) server recorder based on boost::asio.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "SocketServerRecorder.h"
+
+#include "Logger.h"
+#include "timing.h" // ficsleep
+#include "Trace.h"
+
+#include <cstdio>   // remove
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+#include <sys/stat.h>   // stat
+#endif
+
+using namespace std;
+using boost::asio::ip::tcp;
+
+/// How long closeRecord waits for clients to receive what is already queued.
+const int SERVER_CLOSE_WAIT_MS = 500;
+
+///
+///
+///
+SocketServerRecorder::SocketServerRecorder(size_t client_q_len)
+    : _client_q_len(client_q_len > 0 ? client_q_len : 1), _nclients(0)
+{
+    _type = SOCK_SERVER;
+}
+
+///
+///
+///
+SocketServerRecorder::~SocketServerRecorder()
+{
+    closeRecord();
+}
+
+///
+///
+///
+bool SocketServerRecorder::openRecord(string addr)
+{
+    _addr = addr;
+    try {
+        Protocol::endpoint ep;
+        bool is_tcp = false;
+        if (addr.compare(0, 6, "tcp://") == 0) {
+            // extract host name and port
+            string host_port = addr.substr(6);
+            size_t pos = host_port.find_last_of(':');
+            if (pos == string::npos) {
+                LOG_ERR("Error! Malformed tcp://host:port string (%s).", addr.c_str());
+                return false;
+            }
+            ep = tcp::endpoint(boost::asio::ip::address::from_string(host_port.substr(0, pos)), stoi(host_port.substr(pos + 1)));
+            is_tcp = true;
+        }
+        else if (addr.compare(0, 7, "unix://") == 0) {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+            string path = addr.substr(7);
+            struct stat st;
+            if (stat(path.c_str(), &st) == 0) {
+                if (!S_ISSOCK(st.st_mode)) {
+                    LOG_ERR("Error! Socket path (%s) already exists and is not a socket.", path.c_str());
+                    return false;
+                }
+                remove(path.c_str());       // stale socket from a previous run
+            }
+            _unix_path = path;
+            ep = boost::asio::local::stream_protocol::endpoint(_unix_path);
+#else
+            LOG_ERR("Error! Unix domain sockets are not supported on this platform.");
+            return false;
+#endif
+        }
+        else {
+            LOG_ERR("Error! Unrecognised socket server address (%s).", addr.c_str());
+            return false;
+        }
+
+        LOG("Serving data on %s", addr.c_str());
+
+        _acceptor = make_unique<Acceptor>(_io_service);
+        _acceptor->open(ep.protocol());
+        if (is_tcp) {
+            _acceptor->set_option(boost::asio::socket_base::reuse_address(true));
+        }
+        _acceptor->bind(ep);
+        _acceptor->listen();
+    }
+    catch (const exception& e) {
+        LOG_ERR("Error! Could not open socket server on %s due to %s", addr.c_str(), e.what());
+        _acceptor.reset();
+        return false;
+    }
+
+    startAccept();
+    _work = make_unique<boost::asio::io_service::work>(_io_service);
+    _thread = make_unique<thread>([this, tag = Logger::threadTag()] {
+        Logger::setThreadTag(tag);
+        _io_service.run();
+    });
+
+    _open = true;
+    return _open;
+}
+
+///
+///
+///
+void SocketServerRecorder::startAccept()
+{
+    auto c = make_shared<Client>(_io_service);
+    _acceptor->async_accept(c->sock, [this, c](const boost::system::error_code& ec) {
+        if (ec) {
+            if (ec != boost::asio::error::operation_aborted) {
+                LOG_ERR("Error accepting data client on %s (%s)", _addr.c_str(), ec.message().c_str());
+            }
+            return;
+        }
+
+        boost::system::error_code ig;
+        if (_unix_path.empty()) {
+            c->sock.set_option(tcp::no_delay(true), ig);
+        }
+
+        {
+            lock_guard<mutex> l(_mutex);
+            c->name = "client " + to_string(++_nclients);
+            _clients.push_back(c);
+            LOG("Data %s connected to %s (%zu connected)", c->name.c_str(), _addr.c_str(), _clients.size());
+        }
+
+        startAccept();
+    });
+}
+
+///
+///
+///
+bool SocketServerRecorder::writeRecord(string_view s)
+{
+    return writeRecords(vector<string_view>(1, s));
+}
+
+///
+///
+///
+bool SocketServerRecorder::writeRecords(const vector<string_view>& recs)
+{
+    return writeSharedRecords(recs, vector<Buffer>(recs.size()), vector<int64_t>());
+}
+
+///
+/// Must be set before openRecord.
+///
+bool SocketServerRecorder::setSentHandler(SentHandler handler)
+{
+    _sent = handler;
+    return true;
+}
+
+///
+/// Queue each record for every client. Never blocks on a client: a full queue drops its oldest records.
+/// Records are sent straight from their shared buffers; only records without one are copied.
+///
+bool SocketServerRecorder::writeSharedRecords(const vector<string_view>& recs, const vector<Buffer>& bufs,
+    const vector<int64_t>& t_refs)
+{
+    if (!_open) { return false; }
+
+    lock_guard<mutex> l(_mutex);
+    if (_clients.empty()) { return true; }
+
+    vector<Rec> queued;
+    queued.reserve(recs.size());
+    for (size_t i = 0; i < recs.size(); i++) {
+        int64_t t_ref = (i < t_refs.size()) ? t_refs[i] : -1;
+        if ((i < bufs.size()) && bufs[i]) {
+            queued.push_back(Rec{ bufs[i], recs[i], t_ref });
+        }
+        else {
+            auto copy = make_shared<const string>(recs[i]);
+            queued.push_back(Rec{ copy, *copy, t_ref });
+        }
+    }
+
+    for (auto& c : _clients) {
+        for (auto& r : queued) {
+            c->queue.push_back(r);
+        }
+        while (c->queue.size() > _client_q_len) {
+            c->queue.pop_front();
+            c->ndropped++;
+        }
+        if (!c->writing) {
+            c->writing = true;
+            _io_service.post([this, c] { startWrite(c); });
+        }
+    }
+    return true;
+}
+
+///
+/// io thread: send everything queued for this client in one gathered write.
+///
+void SocketServerRecorder::startWrite(ClientPtr c)
+{
+    vector<boost::asio::const_buffer> bufs;
+    {
+        lock_guard<mutex> l(_mutex);
+        c->sending.assign(c->queue.begin(), c->queue.end());
+        c->queue.clear();
+        if (c->sending.empty()) {
+            c->writing = false;
+            return;
+        }
+        bufs.reserve(c->sending.size());
+        for (auto& r : c->sending) {
+            bufs.push_back(boost::asio::buffer(r.data.data(), r.data.size()));
+        }
+    }
+
+    boost::asio::async_write(c->sock, bufs, [this, c](const boost::system::error_code& ec, size_t /*n*/) {
+        if (ec) {
+            dropClient(c, ec.message());
+            return;
+        }
+        if (_sent) {
+            int64_t t_sent = Trace::now();
+            vector<int64_t> t_refs;
+            t_refs.reserve(c->sending.size());
+            for (auto& r : c->sending) {
+                if (r.t_ref >= 0) { t_refs.push_back(r.t_ref); }
+            }
+            if (!t_refs.empty()) { _sent(t_refs, t_sent); }
+        }
+        startWrite(c);
+    });
+}
+
+///
+///
+///
+void SocketServerRecorder::dropClient(ClientPtr c, string why)
+{
+    lock_guard<mutex> l(_mutex);
+    _clients.remove(c);
+    c->queue.clear();
+    c->sending.clear();
+    c->writing = false;
+
+    boost::system::error_code ig;
+    c->sock.close(ig);
+
+    LOG("Data %s disconnected from %s (%s, %zu connected)", c->name.c_str(), _addr.c_str(), why.c_str(), _clients.size());
+    if (c->ndropped > 0) {
+        LOG_WRN("Warning! Dropped %lu records that a slow data client (%s) could not keep up with.", c->ndropped, c->name.c_str());
+    }
+}
+
+///
+///
+///
+void SocketServerRecorder::closeRecord()
+{
+    if (!_thread) { return; }
+
+    LOG("Closing socket server on %s...", _addr.c_str());
+    _open = false;
+
+    /// Stop accepting, then give clients a moment to receive what is already queued.
+    _io_service.post([this] {
+        boost::system::error_code ig;
+        _acceptor->close(ig);
+    });
+    _work.reset();
+    for (int ms = 0; (ms < SERVER_CLOSE_WAIT_MS) && !_io_service.stopped(); ms += 10) {
+        ficsleep(10);
+    }
+    _io_service.stop();
+    if (_thread->joinable()) {
+        _thread->join();
+    }
+    _thread.reset();
+
+    lock_guard<mutex> l(_mutex);
+    for (auto& c : _clients) {
+        boost::system::error_code ig;
+        c->sock.close(ig);
+        if (c->ndropped > 0) {
+            LOG_WRN("Warning! Dropped %lu records that a slow data client (%s) could not keep up with.", c->ndropped, c->name.c_str());
+        }
+    }
+    _clients.clear();
+    _acceptor.reset();
+
+    if (!_unix_path.empty()) {
+        remove(_unix_path.c_str());
+    }
+}
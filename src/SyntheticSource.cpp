@@ -0,0 +1,294 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       SyntheticSource.cpp
+/// \brief      Renders a textured, rotating sphere with known motion (for benchmarking without cameras).
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "SyntheticSource.h"
+
+#include "geometry.h"
+#include "Logger.h"
+#include "timing.h"
+
+/// OpenCV individual includes required by gcc?
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>    // min/max
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+using cv::Mat;
+using std::string;
+using std::vector;
+
+/// Texture and motion generation constants.
+const int TEX_W = 1024;
+const int TEX_H = TEX_W / 2;
+const int TEX_NBLOBS = 60;
+const double TEX_BLOB_R_MIN = 0.1;  // rad
+const double TEX_BLOB_R_MAX = 0.3;  // rad
+const uint8_t TEX_LIGHT = 200;
+const uint8_t TEX_DARK = 40;
+const float BACKGROUND = 20;
+const int NOISE_TABLE_LEN = 1 << 16;
+const double OMEGA_TAU = 0.5;       // time constant of random angular velocity variations (s)
+
+///
+/// Constructor.
+///
+SyntheticSource::SyntheticSource(const Params& params)
+    : _params(params), _rng(params.seed), _cnt(0)
+{
+    _width = _params.width;
+    _height = _params.height;
+    _fps = _params.fps;
+    _live = _params.realtime;
+
+    if ((_width <= 0) || (_height <= 0) || (_fps <= 0) || (_params.vfov <= 0) || (_params.roi_r <= 0) || (_params.roi_r >= CM_PI_2)) {
+        LOG_ERR("Error! Invalid synthetic source parameters (%dx%d @ %.1f fps, vfov %.3f rad, roi_r %.3f rad).",
+            _width, _height, _fps, _params.vfov, _params.roi_r);
+        return;
+    }
+
+    /// Load scripted angular velocity profile.
+    if (!_params.omega_fn.empty()) {
+        std::ifstream f(_params.omega_fn);
+        if (!f.is_open()) {
+            LOG_ERR("Error! Could not open synthetic angular velocity profile (%s)!", _params.omega_fn.c_str());
+            return;
+        }
+        string line;
+        while (std::getline(f, line)) {
+            std::replace(line.begin(), line.end(), ',', ' ');
+            std::istringstream ss(line);
+            CmPoint64f w;
+            if (ss >> w[0] >> w[1] >> w[2]) { _omega_profile.push_back(w); }
+        }
+        if (_omega_profile.empty()) {
+            LOG_ERR("Error! Synthetic angular velocity profile (%s) is empty!", _params.omega_fn.c_str());
+            return;
+        }
+        LOG("Loaded %zu frame angular velocity profile (%s).", _omega_profile.size(), _params.omega_fn.c_str());
+    }
+
+    /// Camera model, as used by the tracker.
+    if (_params.fisheye) {
+        _model = CameraModel::createFisheye(_width, _height, _params.vfov / (double)_height, 360 * CM_D2R);
+    }
+    else {
+        _model = CameraModel::createRectilinear(_width, _height, _params.vfov);
+    }
+
+    /// Pre-compute sphere surface normals for each pixel that sees the sphere.
+    /// Normals are expressed in the ROI frame (sphere centre along z), which is the frame the tracker reports dr_cam/r_cam in.
+    CmPoint64f c = _params.roi_c.getNormalised();
+    double roi_to_cam[9];
+    c.getRotationTo(CmPoint64f(0, 0, 1)).omegaToMatrix(roi_to_cam);
+    const double r_d_ratio = sin(_params.roi_r);
+    for (int i = 0; i < _height; i++) {
+        for (int j = 0; j < _width; j++) {
+            double l[3], v[3], s[3];
+            if (!_model->pixelIndexToVector(j, i, l)) { continue; }
+            for (int k = 0; k < 3; k++) {
+                v[k] = roi_to_cam[3 * k] * l[0] + roi_to_cam[3 * k + 1] * l[1] + roi_to_cam[3 * k + 2] * l[2];
+            }
+            double n = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            for (int k = 0; k < 3; k++) { v[k] /= n; }
+            if (!intersectSphere(r_d_ratio, v, s)) { continue; }
+
+            _pix_idx.push_back(i * _width + j);
+            for (int k = 0; k < 3; k++) { _pix_n.push_back(s[k] / r_d_ratio); }
+
+            // simple Lambertian shading, with light from the camera
+            double cos_i = -(v[0] * s[0] + v[1] * s[1] + v[2] * s[2]) / r_d_ratio;
+            _pix_shade.push_back(static_cast<float>(0.4 + 0.6 * std::max(cos_i, 0.0)));
+        }
+    }
+    if (_pix_idx.empty()) {
+        LOG_ERR("Error! Synthetic sphere is not visible in the camera view!");
+        return;
+    }
+
+    makeTexture();
+
+    /// Gaussian image noise lookup table.
+    std::normal_distribution<float> noise(0, static_cast<float>(_params.noise));
+    _noise.resize(NOISE_TABLE_LEN);
+    for (auto& n : _noise) { n = noise(_rng); }
+
+    _open = rewind();
+
+    LOG("Synthetic source initialised (%dx%d @ %.1f fps, %zu sphere pixels, %d frames).",
+        _width, _height, _fps, _pix_idx.size(), _params.nframes);
+}
+
+///
+/// Default destructor.
+///
+SyntheticSource::~SyntheticSource()
+{}
+
+///
+/// Paint random dark blobs onto a light equirectangular sphere texture.
+///
+void SyntheticSource::makeTexture()
+{
+    std::uniform_real_distribution<double> uni(-1, 1);
+    std::uniform_real_distribution<double> rad(TEX_BLOB_R_MIN, TEX_BLOB_R_MAX);
+    vector<CmPoint64f> blob_c;
+    vector<double> blob_cos_r;
+    while (static_cast<int>(blob_c.size()) < TEX_NBLOBS) {
+        CmPoint64f p(uni(_rng), uni(_rng), uni(_rng));
+        double n = p.len();
+        if ((n > 1) || (n < 1e-3)) { continue; }   // uniform on sphere
+        blob_c.push_back(p / n);
+        blob_cos_r.push_back(cos(rad(_rng)));
+    }
+
+    _texture.create(TEX_H, TEX_W, CV_8UC1);
+    for (int i = 0; i < TEX_H; i++) {
+        double lat = CM_PI_2 - (i + 0.5) * CM_PI / TEX_H;
+        uint8_t* ptex = _texture.ptr(i);
+        for (int j = 0; j < TEX_W; j++) {
+            double lon = (j + 0.5) * 2 * CM_PI / TEX_W - CM_PI;
+            CmPoint64f p(cos(lat) * cos(lon), cos(lat) * sin(lon), sin(lat));
+            ptex[j] = TEX_LIGHT;
+            for (int k = 0; k < TEX_NBLOBS; k++) {
+                if (p.dot(blob_c[k]) > blob_cos_r[k]) {
+                    ptex[j] = TEX_DARK;
+                    break;
+                }
+            }
+        }
+    }
+
+    /// Soften edges so the optimiser has a gradient to follow.
+    cv::GaussianBlur(_texture, _texture, cv::Size(9, 9), 0);
+}
+
+///
+/// Angular velocity for the next frame (rad/s).
+///
+CmPoint64f SyntheticSource::nextOmega()
+{
+    if (!_omega_profile.empty()) {
+        return _omega_profile[std::min<size_t>(_cnt, _omega_profile.size() - 1)];
+    }
+    if (_params.omega_sd > 0) {
+        /// Ornstein-Uhlenbeck process around the mean angular velocity.
+        const double dt = 1 / _fps;
+        const double a = exp(-dt / OMEGA_TAU);
+        std::normal_distribution<double> n(0, _params.omega_sd * sqrt(1 - a * a));
+        for (int k = 0; k < 3; k++) {
+            _omega[k] = _params.omega[k] + a * (_omega[k] - _params.omega[k]) + n(_rng);
+        }
+        return _omega;
+    }
+    return _params.omega;
+}
+
+///
+/// Restart the motion sequence from the beginning.
+///
+bool SyntheticSource::rewind()
+{
+    _rng.seed(_params.seed + 1);    // motion stream is independent of texture
+    _omega = _params.omega;
+    for (int k = 0; k < 9; k++) { _R[k] = (k % 4 == 0) ? 1 : 0; }
+    _cnt = 0;
+    _t_start = ts_ms();
+    _ms_start = ms_since_midnight();
+    return true;
+}
+
+///
+/// Render the next frame.
+///
+bool SyntheticSource::grabNative(cv::Mat& frame, PIXEL_FORMAT& fmt)
+{
+    if (!_open) { return false; }
+    if ((_params.nframes > 0) && (_cnt >= static_cast<unsigned int>(_params.nframes))) { return false; }
+    if (!_omega_profile.empty() && (_cnt >= _omega_profile.size())) { return false; }
+
+    /// Advance sphere orientation, using the tracker's convention (R_new = dR * R_old).
+    /// The first frame is rendered at the initial orientation.
+    CmPoint64f dr(0, 0, 0);
+    if (_cnt > 0) {
+        dr = nextOmega() / _fps;
+        double dR[9], R[9];
+        dr.omegaToMatrix(dR);
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                R[3 * i + j] = dR[3 * i] * _R[j] + dR[3 * i + 1] * _R[3 + j] + dR[3 * i + 2] * _R[6 + j];
+            }
+        }
+        std::copy(R, R + 9, _R);
+    }
+
+    /// Render sphere. Points on the sphere surface are rotated from body to ROI coords by R, so body = R^T n.
+    frame.create(_height, _width, CV_8UC1);
+    const size_t noff = std::uniform_int_distribution<size_t>(0, NOISE_TABLE_LEN - 1)(_rng);
+    uint8_t* pframe = frame.ptr();
+    const size_t npx = static_cast<size_t>(_width) * _height;
+    for (size_t i = 0; i < npx; i++) {
+        pframe[i] = cv::saturate_cast<uint8_t>(BACKGROUND + _noise[(i + noff) & (NOISE_TABLE_LEN - 1)]);
+    }
+    for (size_t p = 0; p < _pix_idx.size(); p++) {
+        const double* n = &_pix_n[3 * p];
+        double b[3];
+        for (int k = 0; k < 3; k++) {
+            b[k] = _R[k] * n[0] + _R[3 + k] * n[1] + _R[6 + k] * n[2];
+        }
+        double lat = asin(std::max(-1.0, std::min(1.0, b[2])));
+        double lon = atan2(b[1], b[0]);
+        int ti = std::min(TEX_H - 1, static_cast<int>((CM_PI_2 - lat) * TEX_H / CM_PI));
+        int tj = std::min(TEX_W - 1, static_cast<int>((lon + CM_PI) * TEX_W / (2 * CM_PI)));
+        float val = _texture.ptr(ti)[tj] * _pix_shade[p] + _noise[(_pix_idx[p] + noff) & (NOISE_TABLE_LEN - 1)];
+        pframe[_pix_idx[p]] = cv::saturate_cast<uint8_t>(val);
+    }
+    fmt = PIXEL_MONO8;
+
+    /// Synthetic clock.
+    const double t_frame = _cnt * 1000 / _fps;
+    if (_params.realtime) {
+        double wait_ms = _t_start + t_frame - ts_ms();
+        if (wait_ms > 0) { ficsleep(static_cast<long>(round(wait_ms))); }
+    }
+    _timestamp = _t_start + t_frame;
+    _ms_since_midnight = _ms_start + t_frame;
+    _cnt++;
+
+    /// Ground truth.
+    CmPoint64f r;
+    {
+        cv::Mat_<double> R(3, 3);
+        for (int k = 0; k < 9; k++) { R(k / 3, k % 3) = _R[k]; }
+        r = CmPoint64f::matrixToOmega(R);
+    }
+    if (_gt_log && _gt_log->is_active()) {
+        std::ostringstream ss;
+        ss.precision(14);
+        ss << _cnt << ", " << dr[0] << ", " << dr[1] << ", " << dr[2] << ", "
+            << r[0] << ", " << r[1] << ", " << r[2] << ", " << _timestamp << std::endl;
+        _gt_log->addMsg(ss.str());
+    }
+
+    LOG_DBG("Synthetic frame %d rendered (dr: %.4f %.4f %.4f)", _cnt, dr[0], dr[1], dr[2]);
+    return true;
+}
+
+///
+/// Log ground truth for every subsequent frame.
+///
+bool SyntheticSource::openGroundTruthLog(std::string fn)
+{
+    _gt_log = std::make_unique<Recorder>(RecorderInterface::RecordType::FILE, fn);
+    if (!_gt_log->is_active()) {
+        LOG_ERR("Error! Unable to open ground truth output file (%s)!", fn.c_str());
+        _gt_log.reset();
+        return false;
+    }
+    LOG("Writing synthetic ground truth to %s", fn.c_str());
+    return true;
+}
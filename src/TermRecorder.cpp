@@ -27,10 +27,23 @@ TermRecorder::~TermRecorder()
 ///
 ///
 ///
-bool TermRecorder::writeRecord(std::string s)
+bool TermRecorder::writeRecord(std::string_view s)
 {
     if (!_open) { return false; }
     std::cout << s;
     fflush(stdout);     // force flush in Linux
     return true;
 }
+
+///
+///
+///
+bool TermRecorder::writeRecords(const std::vector<std::string_view>& recs)
+{
+    if (!_open) { return false; }
+    for (auto& s : recs) {
+        std::cout << s;
+    }
+    fflush(stdout);     // force flush in Linux
+    return true;
+}
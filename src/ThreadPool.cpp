@@ -0,0 +1,80 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       ThreadPool.cpp
+/// \brief      Fixed-size pool of worker threads.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "ThreadPool.h"
+
+#include "Logger.h"
+#include "Trace.h"
+#include "misc.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(int nthreads, bool start)
+    : _active(true), _nthreads(max(nthreads, 1)), _users(0)
+{
+    if (start) { this->start(); }
+}
+
+void ThreadPool::start()
+{
+    lock_guard<mutex> l(_qMutex);
+    if (!_threads.empty()) { return; }
+    for (int i = 0; i < _nthreads; i++) {
+        _threads.push_back(make_unique<thread>(&ThreadPool::work, this, i));
+    }
+    LOG_DBG("Started thread pool (%d threads).", _nthreads);
+}
+
+ThreadPool::~ThreadPool()
+{
+    unique_lock<mutex> l(_qMutex);
+    _active = false;
+    _qCond.notify_all();
+    l.unlock();
+
+    /// Workers finish any queued tasks before exiting.
+    for (auto& t : _threads) {
+        if (t && t->joinable()) {
+            t->join();
+        }
+    }
+}
+
+bool ThreadPool::push(Task task)
+{
+    lock_guard<mutex> l(_qMutex);
+    if (!_active) { return false; }
+    _taskQ.push_back(std::move(task));
+    _qCond.notify_one();
+    return true;
+}
+
+bool ThreadPool::setAffinity(const vector<int>& cpus)
+{
+    bool ok = true;
+    for (auto& t : _threads) {
+        ok &= SetThreadAffinity(*t, cpus);
+    }
+    return ok;
+}
+
+void ThreadPool::work(int id)
+{
+    Trace::setThreadName("pool-" + to_string(id));
+
+    unique_lock<mutex> l(_qMutex);
+    while (true) {
+        _qCond.wait(l, [&] { return !_taskQ.empty() || !_active; });
+        if (_taskQ.empty()) { break; }  // inactive and drained
+
+        Task task = std::move(_taskQ.front());
+        _taskQ.pop_front();
+
+        l.unlock();
+        task(id);
+        l.lock();
+    }
+}
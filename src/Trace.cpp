@@ -0,0 +1,266 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       Trace.cpp
+/// \brief      Low-overhead scoped timing zones, with per-zone histograms and Chrome trace export.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "Trace.h"
+
+#include "SPSCRing.h"
+#include "Logger.h"
+
+#include <algorithm>    // remove_if
+#include <condition_variable>
+#include <cstdio>
+#include <memory>   // shared_ptr, unique_ptr
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/// Events buffered per thread between collector passes.
+const size_t TRACE_RING_LEN = 8192;
+const int TRACE_COLLECT_MS = 100;
+
+namespace {
+
+struct TraceEvent {
+    int zone;
+    int64_t t0, t1;
+};
+
+struct TraceBuffer {
+    TraceBuffer(int tid) : ring(TRACE_RING_LEN, WaitEvent::BLOCK), tid(tid), dropped(0) {}
+    SPSCRing<TraceEvent> ring;
+    int tid;
+    string name;
+    atomic<uint64_t> dropped;
+};
+
+///
+/// Shared trace state. The collector is the single consumer of every thread ring (guarded by mutex).
+///
+struct TraceState {
+    mutex mtx;
+    vector<string> zones;
+    vector<shared_ptr<TraceBuffer>> buffers;
+    int next_tid = 1;
+    vector<LatencyHist> hists;
+    uint64_t dropped = 0;
+
+    FILE* json = nullptr;
+    int64_t t_start = 0;
+    bool first_event = true;
+
+    unique_ptr<thread> collector;
+    condition_variable cond;
+    bool stop = false;
+
+    /// Drain all thread rings (mtx must be held).
+    /// Buffers of threads that have exited (only we hold them) are dropped once empty, keeping their counts.
+    void drain()
+    {
+        TraceEvent ev;
+        for (auto& b : buffers) {
+            while (b->ring.tryPop(ev)) {
+                if (ev.zone >= static_cast<int>(hists.size())) { hists.resize(zones.size()); }
+                hists[ev.zone].add((ev.t1 - ev.t0) / 1e6);
+                if (json) {
+                    fprintf(json, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        first_event ? "" : ",\n", zones[ev.zone].c_str(), b->tid, (ev.t0 - t_start) / 1e3, (ev.t1 - ev.t0) / 1e3);
+                    first_event = false;
+                }
+            }
+        }
+        buffers.erase(remove_if(buffers.begin(), buffers.end(), [this](const shared_ptr<TraceBuffer>& b) {
+            if ((b.use_count() > 1) || !b->ring.empty()) { return false; }
+            dropped += b->dropped.exchange(0);
+            writeThreadName(*b);
+            return true;
+        }), buffers.end());
+    }
+
+    /// Name a thread's events in the JSON output (mtx must be held).
+    void writeThreadName(const TraceBuffer& b)
+    {
+        if (!json || b.name.empty()) { return; }
+        fprintf(json, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            first_event ? "" : ",\n", b.tid, b.name.c_str());
+        first_event = false;
+    }
+
+    ~TraceState()
+    {
+        if (collector) {
+            {
+                lock_guard<mutex> l(mtx);
+                stop = true;
+            }
+            cond.notify_all();
+            collector->join();
+        }
+        if (json) { fclose(json); }
+    }
+
+    void collect()
+    {
+        unique_lock<mutex> l(mtx);
+        while (!stop) {
+            cond.wait_for(l, chrono::milliseconds(TRACE_COLLECT_MS));
+            drain();
+        }
+    }
+};
+
+TraceState& state()
+{
+    static TraceState s;
+    return s;
+}
+
+thread_local shared_ptr<TraceBuffer> t_buf;
+thread_local string t_name;
+
+///
+/// Calling thread's event buffer, created on first use (so threads that never record don't pay for one).
+///
+TraceBuffer* threadBuffer()
+{
+    if (!t_buf) {
+        TraceState& s = state();
+        lock_guard<mutex> l(s.mtx);
+        t_buf = make_shared<TraceBuffer>(s.next_tid++);
+        t_buf->name = t_name;
+        s.buffers.push_back(t_buf);
+    }
+    return t_buf.get();
+}
+
+} // namespace
+
+atomic<bool> Trace::_enabled(false);
+
+bool Trace::enable(string json_fn)
+{
+    TraceState& s = state();
+    {
+        lock_guard<mutex> l(s.mtx);
+        if (s.collector) {
+            LOG_WRN("Warning! Tracing is already enabled.");
+            return false;
+        }
+
+        s.drain();  // discard stale events
+        s.hists.assign(s.zones.size(), LatencyHist());
+        s.dropped = 0;
+        for (auto& b : s.buffers) { b->dropped = 0; }
+
+        s.t_start = now();
+        s.first_event = true;
+        if (!json_fn.empty()) {
+            s.json = fopen(json_fn.c_str(), "w");
+            if (!s.json) {
+                LOG_ERR("Error! Unable to open trace output file (%s).", json_fn.c_str());
+            }
+            else {
+                fprintf(s.json, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+                LOG("Writing trace events to %s", json_fn.c_str());
+            }
+        }
+
+        s.stop = false;
+        s.collector = make_unique<thread>(&TraceState::collect, &s);
+    }
+    _enabled = true;
+    return true;
+}
+
+void Trace::disable()
+{
+    TraceState& s = state();
+    _enabled = false;
+    {
+        lock_guard<mutex> l(s.mtx);
+        if (!s.collector) { return; }
+        s.stop = true;
+        s.cond.notify_all();
+    }
+    s.collector->join();
+
+    lock_guard<mutex> l(s.mtx);
+    s.collector.reset();
+    s.drain();
+    for (auto& b : s.buffers) { s.dropped += b->dropped.exchange(0); }
+    if (s.json) {
+        for (auto& b : s.buffers) { s.writeThreadName(*b); }
+        fprintf(s.json, "\n]}\n");
+        fclose(s.json);
+        s.json = nullptr;
+    }
+}
+
+void Trace::setThreadName(string name)
+{
+    t_name = name;
+    if (t_buf) {    // otherwise picked up when the buffer is created
+        lock_guard<mutex> l(state().mtx);
+        t_buf->name = name;
+    }
+}
+
+int Trace::zoneId(const char* name)
+{
+    TraceState& s = state();
+    lock_guard<mutex> l(s.mtx);
+    for (size_t i = 0; i < s.zones.size(); i++) {
+        if (s.zones[i] == name) { return static_cast<int>(i); }
+    }
+    s.zones.push_back(name);
+    s.hists.resize(s.zones.size());
+    return static_cast<int>(s.zones.size()) - 1;
+}
+
+void Trace::record(int zone, int64_t t_start_ns, int64_t t_end_ns)
+{
+    TraceBuffer* b = threadBuffer();
+    if (!b->ring.tryPush(TraceEvent{ zone, t_start_ns, t_end_ns })) {
+        b->dropped.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+map<string, LatencyHist> Trace::histograms()
+{
+    TraceState& s = state();
+    lock_guard<mutex> l(s.mtx);
+    s.drain();
+    map<string, LatencyHist> hists;
+    for (size_t i = 0; i < s.hists.size(); i++) {
+        if (s.hists[i].count() > 0) { hists[s.zones[i]] = s.hists[i]; }
+    }
+    return hists;
+}
+
+uint64_t Trace::dropped()
+{
+    TraceState& s = state();
+    lock_guard<mutex> l(s.mtx);
+    uint64_t n = s.dropped;
+    for (auto& b : s.buffers) { n += b->dropped.load(memory_order_relaxed); }
+    return n;
+}
+
+void Trace::report()
+{
+    auto hists = histograms();
+    if (hists.empty()) { return; }
+    LOG("Zone timing (ms):   %-20s %10s %8s %8s %8s %8s", "zone", "count", "mean", "p50", "p99", "max");
+    for (auto& h : hists) {
+        LOG("                    %-20s %10llu %8.3f %8.3f %8.3f %8.3f", h.first.c_str(), static_cast<unsigned long long>(h.second.count()),
+            h.second.mean(), h.second.percentile(50), h.second.percentile(99), h.second.max());
+    }
+    uint64_t ndropped = dropped();
+    if (ndropped > 0) {
+        LOG_WRN("Warning! %llu trace events were dropped.", static_cast<unsigned long long>(ndropped));
+    }
+}
@@ -15,7 +15,12 @@
 #include "CameraRemap.h"
 #include "BasicRemapper.h"
 #include "misc.h"
+#include "Trace.h"
+#include "DataRecord.h"
+#include "DataDecimator.h"
+#include "FileRecorder.h"    // gzipSupported
 #include "CVSource.h"
+#include "SyntheticSource.h"
 #if defined(PGR_USB2) || defined(PGR_USB3)
 #include "PGRSource.h"
 #elif defined(BASLER_USB3)
@@ -28,8 +33,10 @@
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/videoio.hpp>
 
-#include <sstream>
+#include <algorithm>
+#include <atomic>  // atomic_thread_fence
 #include <cmath>
+#include <cstring>  // memcpy
 #include <exception>
 
 using namespace cv;
@@ -48,18 +55,66 @@ const int OPT_MAX_BAD_FRAMES_DEFAULT = -1;
 
 const double THRESH_RATIO_DEFAULT = 1.25;
 const double THRESH_WIN_PC_DEFAULT = 0.25;
+const string THRESH_MODE_DEFAULT = "minmax";
+
+const string FRAME_Q_WAIT_DEFAULT = "spin";
+const int PROC_THREADS_DEFAULT = 0;
+const string FRAME_POLICY_LIVE_DEFAULT = "latest";
+const string FRAME_POLICY_FILE_DEFAULT = "bounded";
+const int FRAME_Q_LEN_DEFAULT = 1;
+const int MAX_FRAME_CNT_DEFAULT = -1;
+const int SRC_START_DEFAULT = 0;
+
+const string SYNTH_SRC_FN = "synth";
+const int SYNTH_NFRAMES_DEFAULT = 1000;
+const double SYNTH_FPS_DEFAULT = 100;
+const double SYNTH_VFOV_DEFAULT = 45;
+const double SYNTH_ROI_R_DEFAULT = 0.25;
+
+const bool TRACE_DEFAULT = true;
+const bool TRACE_JSON_DEFAULT = false;
+
+const bool LAT_COLS_DEFAULT = false;
+const double LAT_BUDGET_MS_DEFAULT = -1;
+
+const string OUT_FMT_DEFAULT = "txt";
+const size_t OUT_BUF_POOL_MAX = 64;
+const int OUT_Q_LEN_DEFAULT = 4096;
+const string OUT_OVERFLOW_DEFAULT = "block";
+const int OUT_FLUSH_MS_DEFAULT = 0;
+const bool OUT_GZ_DEFAULT = false;
+const int DECIM_DEFAULT = 1;
+const string DECIM_MODE_DEFAULT = "skip";
+
+const int METRICS_PORT_DEFAULT = -1;
+const string METRICS_HOST_DEFAULT = "127.0.0.1";
+const string METRICS_PROTO_DEFAULT = "udp";
+const string METRICS_FMT_DEFAULT = "prom";
+const int METRICS_PERIOD_MS_DEFAULT = 1000;
 
 const uint8_t SPHERE_MAP_FIRST_HIT_BONUS = 64;
 
+const string SOCK_TYPE_DEFAULT = "udp";
 const string SOCK_HOST_DEFAULT = "127.0.0.1";
 const int SOCK_PORT_DEFAULT = -1;
+const string SOCK_PATH_DEFAULT = "/tmp/fictrac.sock";
 
 const int COM_BAUD_DEFAULT = 115200;
 
+const int SHM_LEN_DEFAULT = 1024;
+
 const bool DO_DISPLAY_DEFAULT = true;
 const bool SAVE_RAW_DEFAULT = false;
 const bool SAVE_DEBUG_DEFAULT = false;
 
+/// HighGUI isn't thread-safe, so rigs sharing a process take turns to update their windows.
+/// HighGUI also can't say which window a key was pressed in, so keys are ignored while several rigs are displayed.
+namespace {
+    std::mutex display_mutex;
+    int display_rigs = 0;       // draw threads running
+    bool display_keys_warned = false;
+}
+
 /// OpenCV codecs for video writing
 const vector<vector<std::string>> CODECS = {
     {"h264", "H264", "avi"},
@@ -69,30 +124,12 @@ const vector<vector<std::string>> CODECS = {
     {"raw",  "",     "avi"}
 };
 
-///
-///
-///
-bool intersectSphere(const double r, const double camVec[3], double sphereVec[3])
-{
-    double q = camVec[2] * camVec[2] + r * r - 1;
-    if (q < 0) { return false; }
-
-    // get point on front surface of sphere (camera coords)
-    double u = camVec[2] - sqrt(q);
-
-    // switch to sphere coords
-    sphereVec[0] = camVec[0] * u;
-    sphereVec[1] = camVec[1] * u;
-    sphereVec[2] = camVec[2] * u - 1;
-
-    return true;
-}
-
 ///
 /// 
 ///
-Trackball::Trackball(string cfg_fn, string src_override)
-    : _init(false), _reset(true), _clean_map(true), _active(true), _kill(false), _do_reset(false)
+Trackball::Trackball(string cfg_fn, string src_override, const map<string, string>& cfg_override, shared_ptr<ThreadPool> pool)
+    : _guess(0, 0, 0), _prev_log_ts(-1), _init(false), _reset(true), _clean_map(true), _trace(false),
+    _active(true), _kill(false), _do_reset(false)
 {
     /// Save execTime for outptut file naming.
     string exec_time = execTime();
@@ -103,6 +140,14 @@ Trackball::Trackball(string cfg_fn, string src_override)
         _active = false;
         return;
     }
+    for (auto& kv : cfg_override) {
+        LOG("Using %s=%s", kv.first.c_str(), kv.second.c_str());
+        _cfg.add(kv.first, kv.second);
+    }
+
+    /// Everything logged from here on (including by the threads we start) is tagged with the rig name.
+    _rig_name = _cfg("rig_name");
+    Logger::ScopedTag log_tag(_rig_name.empty() ? Logger::threadTag() : _rig_name);
 
     /// Open frame source and set fps.
     string src_fn = _cfg("src_fn");
@@ -112,6 +157,12 @@ Trackball::Trackball(string cfg_fn, string src_override)
         LOG("Using src_fn=%s", src_fn.c_str());
     }
     shared_ptr<FrameSource> source;
+    shared_ptr<SyntheticSource> synth;
+    if (src_fn == SYNTH_SRC_FN) {
+        synth = makeSyntheticSource();
+        source = synth;
+    }
+    else {
     // try specific camera sdk first if available
 #if defined(PGR_USB2) || defined(PGR_USB3) || defined(BASLER_USB3)
     try {
@@ -131,6 +182,7 @@ Trackball::Trackball(string cfg_fn, string src_override)
 #else // !PGR/BASLER
     source = make_shared<CVSource>(src_fn);
 #endif // PGR/BASLER
+    }
     if (!source->isOpen()) {
         LOG_ERR("Error! Could not open input frame source (%s)!", src_fn.c_str());
         _active = false;
@@ -148,27 +200,542 @@ Trackball::Trackball(string cfg_fn, string src_override)
     /// Create base file name for output files.
     _base_fn = _cfg("output_fn");
     if (_base_fn.empty()) {
-        if (!source->isLive()) {
+        if (synth) {
+            _base_fn = "fictrac-" + SYNTH_SRC_FN;
+        } else if (!source->isLive()) {
             _base_fn = src_fn.substr(0, src_fn.length() - 4);
         } else {
             _base_fn = "fictrac";
         }
+        if (!_rig_name.empty()) {
+            _base_fn += "-" + _rig_name;
+        }
+    }
+
+    /// Tracking state.
+    if (!initTracking(source->getWidth(), source->getHeight())) {
+        _active = false;
+        return;
+    }
+
+    string frame_q_wait = FRAME_Q_WAIT_DEFAULT;
+    if (!_cfg.getStr("frame_q_wait", frame_q_wait) || ((frame_q_wait != "spin") && (frame_q_wait != "block"))) {
+        frame_q_wait = FRAME_Q_WAIT_DEFAULT;
+        LOG_WRN("Warning! Using default value for frame_q_wait (%s).", frame_q_wait.c_str());
+        _cfg.add("frame_q_wait", frame_q_wait);
+    }
+    int proc_threads = PROC_THREADS_DEFAULT;
+    if (!_cfg.getInt("proc_threads", proc_threads)) {
+        LOG_WRN("Warning! Using default value for proc_threads (%d).", proc_threads);
+        _cfg.add("proc_threads", proc_threads);
+    }
+    string frame_policy = source->isLive() ? FRAME_POLICY_LIVE_DEFAULT : FRAME_POLICY_FILE_DEFAULT;
+    if (!_cfg.getStr("frame_policy", frame_policy) || ((frame_policy != "latest") && (frame_policy != "bounded") && (frame_policy != "unbounded"))) {
+        frame_policy = source->isLive() ? FRAME_POLICY_LIVE_DEFAULT : FRAME_POLICY_FILE_DEFAULT;
+        LOG_WRN("Warning! Using default value for frame_policy (%s).", frame_policy.c_str());
+        _cfg.add("frame_policy", frame_policy);
+    }
+    int frame_q_len = FRAME_Q_LEN_DEFAULT;
+    if (!_cfg.getInt("frame_q_len", frame_q_len)) {
+        LOG_WRN("Warning! Using default value for frame_q_len (%d).", frame_q_len);
+        _cfg.add("frame_q_len", frame_q_len);
+    }
+    int max_frame_cnt = MAX_FRAME_CNT_DEFAULT;
+    if (!_cfg.getInt("max_frame_cnt", max_frame_cnt)) {
+        LOG_WRN("Warning! Using default value for max_frame_cnt (%d).", max_frame_cnt);
+        _cfg.add("max_frame_cnt", max_frame_cnt);
+    }
+    int src_start = SRC_START_DEFAULT;
+    if (!_cfg.getInt("src_start", src_start) || (src_start < 0)) {
+        src_start = SRC_START_DEFAULT;
+        LOG_WRN("Warning! Using default value for src_start (%d).", src_start);
+        _cfg.add("src_start", src_start);
+    }
+    _timing.src_frames = source->getFrameCount();
+    if (src_start > 0) {
+        if (source->isLive()) {
+            LOG_ERR("Error! src_start can only be used with video file sources.");
+            _active = false;
+            return;
+        }
+        if ((_timing.src_frames >= 0) && (src_start >= _timing.src_frames)) {
+            LOG_ERR("Error! src_start (%d) is beyond the end of the source (%ld frames).", src_start, _timing.src_frames);
+            _active = false;
+            return;
+        }
+        LOG("Starting from source frame %d", src_start);
+        if (_timing.src_frames >= 0) { _timing.src_frames -= src_start; }
+    }
+    if ((max_frame_cnt > 0) && ((_timing.src_frames < 0) || (_timing.src_frames > max_frame_cnt))) {
+        _timing.src_frames = max_frame_cnt;
+    }
+
+    /// Thread affinity (CPU lists per thread role; unset roles run on any CPU).
+    const vector<string> cpu_roles = { "grab", "track", "write", "draw" };
+    const vector<int> proc_cpus = GetProcessCpus();
+    map<string, vector<int>> cpus;
+    for (auto& role : cpu_roles) {
+        vector<int> role_cpus;
+        if (!_cfg.getVecInt("cpu_" + role, role_cpus) || role_cpus.empty()) { continue; }
+        for (int cpu : role_cpus) {
+            if (!proc_cpus.empty() && (find(proc_cpus.begin(), proc_cpus.end(), cpu) == proc_cpus.end())) {
+                LOG_ERR("Error! CPU %d in cpu_%s is not available to this process (CPUs %s).", cpu, role.c_str(), CpuListStr(proc_cpus).c_str());
+                _active = false;
+                return;
+            }
+        }
+        cpus[role] = role_cpus;
+    }
+
+
+    /// Output.
+    string out_fmt = OUT_FMT_DEFAULT;
+    if (!_cfg.getStr("out_fmt", out_fmt) || ((out_fmt != "txt") && (out_fmt != "bin"))) {
+        out_fmt = OUT_FMT_DEFAULT;
+        LOG_WRN("Warning! Using default value for out_fmt (%s).", out_fmt.c_str());
+        _cfg.add("out_fmt", out_fmt);
+    }
+    _out_bin = (out_fmt == "bin");
+    _lat_cols = LAT_COLS_DEFAULT;
+    if (!_cfg.getBool("lat_cols", _lat_cols)) {
+        LOG_WRN("Warning! Using default value for lat_cols (%d).", _lat_cols);
+        _cfg.add("lat_cols", _lat_cols ? "y" : "n");
+    }
+
+    int out_q_len = OUT_Q_LEN_DEFAULT;
+    if (!_cfg.getInt("out_q_len", out_q_len) || (out_q_len <= 0)) {
+        out_q_len = OUT_Q_LEN_DEFAULT;
+        LOG_WRN("Warning! Using default value for out_q_len (%d).", out_q_len);
+        _cfg.add("out_q_len", out_q_len);
+    }
+    string out_overflow = OUT_OVERFLOW_DEFAULT;
+    if (!_cfg.getStr("out_overflow", out_overflow) || ((out_overflow != "block") && (out_overflow != "drop"))) {
+        out_overflow = OUT_OVERFLOW_DEFAULT;
+        LOG_WRN("Warning! Using default value for out_overflow (%s).", out_overflow.c_str());
+        _cfg.add("out_overflow", out_overflow);
+    }
+    Recorder::Overflow overflow = (out_overflow == "drop") ? Recorder::DROP : Recorder::BLOCK;
+    int out_flush_ms = OUT_FLUSH_MS_DEFAULT;
+    if (!_cfg.getInt("out_flush_ms", out_flush_ms) || (out_flush_ms < 0)) {
+        out_flush_ms = OUT_FLUSH_MS_DEFAULT;
+        LOG_WRN("Warning! Using default value for out_flush_ms (%d).", out_flush_ms);
+        _cfg.add("out_flush_ms", out_flush_ms);
+    }
+
+    bool out_gz = OUT_GZ_DEFAULT;
+    if (!_cfg.getBool("out_gz", out_gz)) {
+        LOG_WRN("Warning! Using default value for out_gz (%d).", out_gz);
+        _cfg.add("out_gz", out_gz ? "y" : "n");
+    }
+    if (out_gz && !FileRecorder::gzipSupported()) {
+        LOG_WRN("Warning! This build of FicTrac does not support compressed output (zlib not found). Writing uncompressed data.");
+        out_gz = false;
+    }
+
+    string data_fn = _base_fn + "-" + exec_time + (_out_bin ? ".bin" : ".dat") + (out_gz ? ".gz" : "");
+    _data_log = make_unique<Recorder>(RecorderInterface::RecordType::FILE, data_fn, _out_bin, out_q_len, overflow);
+    if (!_data_log->is_active()) {
+        LOG_ERR("Error! Unable to open output data log file (%s).", data_fn.c_str());
+        _active = false;
+        return;
+    }
+    _data_log->setFlushInterval(out_flush_ms);
+
+    /// Optional per-output decimation, done on each output's writer thread (the output is then sent binary records).
+    auto setDecimation = [&](Recorder& rec, const string& name, bool text, const string& prefix) {
+        int n = DECIM_DEFAULT;
+        if (!_cfg.getInt(name + "_decim", n) || (n < 1)) {
+            n = DECIM_DEFAULT;
+            LOG_WRN("Warning! Using default value for %s_decim (%d).", name.c_str(), n);
+            _cfg.add(name + "_decim", n);
+        }
+        string mode = DECIM_MODE_DEFAULT;
+        if (!_cfg.getStr(name + "_decim_mode", mode) || ((mode != "skip") && (mode != "sum"))) {
+            mode = DECIM_MODE_DEFAULT;
+            LOG_WRN("Warning! Using default value for %s_decim_mode (%s).", name.c_str(), mode.c_str());
+            _cfg.add(name + "_decim_mode", mode);
+        }
+        if (n == 1) { return false; }
+
+        LOG("Decimating %s output by %d (%s)", name.c_str(), n, mode.c_str());
+        rec.setTransform(DataDecimator(n, (mode == "sum") ? DataDecimator::SUM : DataDecimator::SKIP, text, _lat_cols, prefix));
+        return true;
+    };
+    _decim_log = setDecimation(*_data_log, "out", !_out_bin, "");
+    if (_out_bin) {
+        _data_log->addMsg(dataFileHeader(_lat_cols));
+    }
+
+    if (synth) {
+        synth->openGroundTruthLog(_base_fn + "-gt-" + exec_time + ".dat");
+    }
+
+    /// Timing zones.
+    bool trace = TRACE_DEFAULT;
+    if (!_cfg.getBool("trace", trace)) {
+        LOG_WRN("Warning! Using default value for trace (%d).", trace);
+        _cfg.add("trace", trace ? "y" : "n");
+    }
+    bool trace_json = TRACE_JSON_DEFAULT;
+    if (!_cfg.getBool("trace_json", trace_json)) {
+        LOG_WRN("Warning! Using default value for trace_json (%d).", trace_json);
+        _cfg.add("trace_json", trace_json ? "y" : "n");
+    }
+    if (trace && !Trace::enabled()) {
+        // tracing is process-wide: if it's already running (e.g. started for several rigs) it isn't ours to report or stop
+        _trace = Trace::enable(trace_json ? (_base_fn + "-trace-" + exec_time + ".json") : "");
+    }
+
+    string sock_type = SOCK_TYPE_DEFAULT;
+    if (!_cfg.getStr("sock_type", sock_type) || ((sock_type != "udp") && (sock_type != "tcp") && (sock_type != "unix"))) {
+        sock_type = SOCK_TYPE_DEFAULT;
+        LOG_WRN("Warning! Using default value for sock_type (%s).", sock_type.c_str());
+        _cfg.add("sock_type", sock_type);
+    }
+    int sock_port = SOCK_PORT_DEFAULT;
+    _do_sock_output = _decim_sock = false;
+    if (sock_type == "unix") {
+        string sock_path = SOCK_PATH_DEFAULT;
+        if (!_cfg.getStr("sock_path", sock_path)) {
+            LOG_WRN("Warning! Using default value for sock_path (%s).", sock_path.c_str());
+            _cfg.add("sock_path", sock_path);
+        }
+
+        _data_sock = make_unique<Recorder>(RecorderInterface::RecordType::SOCK_SERVER, "unix://" + sock_path, false, out_q_len, overflow);
+        if (!_data_sock->is_active()) {
+            LOG_ERR("Error! Unable to open output data socket (%s).", sock_path.c_str());
+            _active = false;
+            return;
+        }
+        _decim_sock = setDecimation(*_data_sock, "sock", !_out_bin, "FT, ");
+        _do_sock_output = true;
+    }
+    else if (_cfg.getInt("sock_port", sock_port) && (sock_port > 0)) {
+        string sock_host = SOCK_HOST_DEFAULT;
+        if (!_cfg.getStr("sock_host", sock_host)) {
+            LOG_WRN("Warning! Using default value for sock_host (%s).", sock_host.c_str());
+            _cfg.add("sock_host", sock_host);
+        }
+
+        if (sock_type == "tcp") {
+            _data_sock = make_unique<Recorder>(RecorderInterface::RecordType::SOCK_SERVER, "tcp://" + sock_host + ":" + std::to_string(sock_port), false, out_q_len, overflow);
+        }
+        else {
+            _data_sock = make_unique<Recorder>(RecorderInterface::RecordType::SOCK, sock_host + ":" + std::to_string(sock_port), false, out_q_len, overflow);
+        }
+        if (!_data_sock->is_active()) {
+            LOG_ERR("Error! Unable to open output data socket (%s:%d).", sock_host.c_str() ,sock_port);
+            _active = false;
+            return;
+        }
+        _decim_sock = setDecimation(*_data_sock, "sock", !_out_bin, "FT, ");
+        _do_sock_output = true;
+    }
+
+    string com_port = _cfg("com_port");
+    _do_com_output = _decim_com = false;
+    if (com_port.length() > 0) {
+        int com_baud = COM_BAUD_DEFAULT;
+        if (!_cfg.getInt("com_baud", com_baud)) {
+            LOG_WRN("Warning! Using default value for com_baud (%d).", com_baud);
+            _cfg.add("com_baud", com_baud);
+        }
+
+        _data_com = make_unique<Recorder>(RecorderInterface::RecordType::COM, com_port + "@" + std::to_string(com_baud), false, out_q_len, overflow);
+        if (!_data_com->is_active()) {
+            LOG_ERR("Error! Unable to open output data com port (%s@%d).", com_port.c_str(), com_baud);
+            _active = false;
+            return;
+        }
+        _decim_com = setDecimation(*_data_com, "com", true, "FT, ");
+        _do_com_output = true;
+    }
+
+    string shm_name = _cfg("shm_name");
+    if (shm_name.length() > 0) {
+        int shm_len = SHM_LEN_DEFAULT;
+        if (!_cfg.getInt("shm_len", shm_len) || (shm_len <= 0)) {
+            shm_len = SHM_LEN_DEFAULT;
+            LOG_WRN("Warning! Using default value for shm_len (%d).", shm_len);
+            _cfg.add("shm_len", shm_len);
+        }
+
+        _data_shm = make_unique<ShmRecorder>(shm_len);
+        if (!_data_shm->openRecord(shm_name)) {
+            LOG_ERR("Error! Unable to open output shared memory (%s).", shm_name.c_str());
+            _active = false;
+            return;
+        }
+    }
+
+    /// Latency.
+    _lat_budget_ms = LAT_BUDGET_MS_DEFAULT;
+    if (!_cfg.getDbl("lat_budget_ms", _lat_budget_ms)) {
+        LOG_WRN("Warning! Using default value for lat_budget_ms (%.1f).", _lat_budget_ms);
+        _cfg.add("lat_budget_ms", _lat_budget_ms);
+    }
+
+    /// Metrics.
+    int metrics_port = METRICS_PORT_DEFAULT;
+    string metrics_host = METRICS_HOST_DEFAULT, metrics_proto = METRICS_PROTO_DEFAULT, metrics_fmt = METRICS_FMT_DEFAULT;
+    int metrics_period_ms = METRICS_PERIOD_MS_DEFAULT;
+    if (_cfg.getInt("metrics_port", metrics_port) && (metrics_port > 0)) {
+        if (!_cfg.getStr("metrics_host", metrics_host)) {
+            LOG_WRN("Warning! Using default value for metrics_host (%s).", metrics_host.c_str());
+            _cfg.add("metrics_host", metrics_host);
+        }
+        if (!_cfg.getStr("metrics_proto", metrics_proto) || ((metrics_proto != "udp") && (metrics_proto != "tcp"))) {
+            metrics_proto = METRICS_PROTO_DEFAULT;
+            LOG_WRN("Warning! Using default value for metrics_proto (%s).", metrics_proto.c_str());
+            _cfg.add("metrics_proto", metrics_proto);
+        }
+        if (!_cfg.getStr("metrics_fmt", metrics_fmt) || ((metrics_fmt != "prom") && (metrics_fmt != "json"))) {
+            metrics_fmt = METRICS_FMT_DEFAULT;
+            LOG_WRN("Warning! Using default value for metrics_fmt (%s).", metrics_fmt.c_str());
+            _cfg.add("metrics_fmt", metrics_fmt);
+        }
+        if (!_cfg.getInt("metrics_period_ms", metrics_period_ms) || (metrics_period_ms <= 0)) {
+            metrics_period_ms = METRICS_PERIOD_MS_DEFAULT;
+            LOG_WRN("Warning! Using default value for metrics_period_ms (%d).", metrics_period_ms);
+            _cfg.add("metrics_period_ms", metrics_period_ms);
+        }
+    }
+
+    /// Display.
+    _do_display = DO_DISPLAY_DEFAULT;
+    if (!_cfg.getBool("do_display", _do_display)) {
+        LOG_WRN("Warning! Using default value for do_display (%d).", _do_display);
+        _cfg.add("do_display", _do_display ? "y" : "n");
+    }
+    _save_raw = SAVE_RAW_DEFAULT;
+    if (!source->isLive() || !_cfg.getBool("save_raw", _save_raw)) {
+        LOG_WRN("Warning! Using default value for save_raw (%d).", _save_raw);
+        _cfg.add("save_raw", _save_raw ? "y" : "n");
+    }
+    _save_debug = SAVE_DEBUG_DEFAULT;
+    if (!_cfg.getBool("save_debug", _save_debug)) {
+        LOG_WRN("Warning! Using default value for save_debug (%d).", _save_debug);
+        _cfg.add("save_debug", _save_debug ? "y" : "n");
+    }
+    if (_save_debug & !_do_display) {
+        LOG("Forcing do_display = true, becase save_debug == true.");
+        _do_display = true;
+    }
+
+    // do video stuff
+    if (_save_raw || _save_debug) {
+        // find codec
+        int fourcc = 0;
+        string cstr = _cfg("vid_codec"), fext;
+        for (auto codec : CODECS) {
+            if (cstr.compare(codec[0]) == 0) {  // found the codec
+                if (cstr.compare("raw") != 0) { // codec isn't RAW
+                    fourcc = VideoWriter::fourcc(codec[1][0], codec[1][1], codec[1][2], codec[1][3]);
+                }
+                fext = codec[2];
+            }
+        }
+        if (fext.empty()) {
+            // codec not found - use default
+            auto codec = CODECS[0];
+            cstr = codec[0];
+            if (cstr.compare("raw") != 0) { // codec isn't RAW
+                fourcc = VideoWriter::fourcc(codec[1][0], codec[1][1], codec[1][2], codec[1][3]);
+            }
+            fext = codec[2];
+            LOG_WRN("Warning! Using default value for vid_codec (%s).", cstr.c_str());
+            _cfg.add("vid_codec", cstr);
+        }
+
+        // raw input video
+        if (_save_raw) {
+            string vid_fn = _base_fn + "-raw-" + exec_time + "." + fext;
+            double fps = source->getFPS();
+            if (fps <= 0) {
+                fps = (src_fps > 0) ? src_fps : 25;   // if we can't get fps from source, then use fps from config or - if not specified - default to 25 fps.
+            }
+            LOG_DBG("Opening %s for video writing (%s %dx%d @ %f FPS)", vid_fn.c_str(), cstr.c_str(), source->getWidth(), source->getHeight(), fps);
+            _raw_vid.open(vid_fn, fourcc, fps, cv::Size(source->getWidth(), source->getHeight()));
+            if (!_raw_vid.isOpened()) {
+                LOG_ERR("Error! Unable to open raw output video (%s).", vid_fn.c_str());
+                _active = false;
+                return;
+            }
+        }
+
+        // debug output video
+        if (_save_debug) {
+            string vid_fn = _base_fn + "-dbg-" + exec_time + "." + fext;
+            double fps = source->getFPS();
+            if (fps <= 0) {
+                fps = (src_fps > 0) ? src_fps : 25;   // if we can't get fps from source, then use fps from config or - if not specified - default to 25 fps.
+            }
+            LOG_DBG("Opening %s for video writing (%s %dx%d @ %f FPS)", vid_fn.c_str(), cstr.c_str(), 4 * DRAW_CELL_DIM, 3 * DRAW_CELL_DIM, fps);
+            _debug_vid.open(vid_fn, fourcc, fps, cv::Size(4 * DRAW_CELL_DIM, 3 * DRAW_CELL_DIM));
+            if (!_debug_vid.isOpened()) {
+                LOG_ERR("Error! Unable to open debug output video (%s).", vid_fn.c_str());
+                _active = false;
+                return;
+            }
+        }
+
+        // create output file containing log lines corresponding to video frames, for synching video output
+        string fn = _base_fn + "-vidLogFrames-" + exec_time + ".txt";
+        _vid_frames = make_unique<Recorder>(RecorderInterface::RecordType::FILE, fn);
+        if (!_vid_frames->is_active()) {
+            LOG_ERR("Error! Unable to open output video frame number log file (%s).", fn.c_str());
+            _active = false;
+            return;
+        }
+    }
+
+    /// Frame source.
+    _frameGrabber = make_unique<FrameGrabber>(
+        source,
+        _remapper,
+        _roi_mask,
+        _thresh_ratio,
+        _thresh_win_pc,
+        _cfg("thr_rgb_tfrm"),
+        _thresh_mode,
+        (frame_policy == "latest") ? FrameGrabber::LATEST : (frame_policy == "unbounded") ? FrameGrabber::UNBOUNDED : FrameGrabber::BOUNDED,
+        frame_q_len,
+        max_frame_cnt,
+        (frame_q_wait == "block") ? WaitEvent::BLOCK : WaitEvent::SPIN_BLOCK,
+        proc_threads,
+        pool,
+        src_start
+    );
+    _frameGrabber->keepSourceFrames(_do_display || _save_raw);
+
+    /// Write all parameters back to config file (unless we've been given temporary overrides).
+    if (cfg_override.empty()) {
+        _cfg.write();
     }
 
+    /// Data.
+    reset();
+
+    // not reset in resetData because they are not affected by heading reset
+    _data.cnt = 0;
+    _data.intx = _data.inty = 0;
+    _err = 0;
+
+    /// Thread stuff.
+    _init = true;
+    _active = true;
+
+    if (_do_display) {
+        _window_name = _rig_name.empty() ? "FicTrac-debug" : ("FicTrac-debug (" + _rig_name + ")");
+        _drawThread = make_unique<std::thread>([this, tag = Logger::threadTag()] {
+            Logger::setThreadTag(tag);
+            processDrawQ();
+        });
+    }
+    // main processing thread
+    _thread = make_unique<std::thread>([this, tag = Logger::threadTag()] {
+        Logger::setThreadTag(tag);
+        process();
+    });
+
+    /// Pin threads.
+    if (!cpus.empty()) {
+        bool ok = true;
+        if (cpus.count("grab")) {
+            ok &= _frameGrabber->setAffinity(cpus["grab"]);
+        }
+        if (cpus.count("track")) {
+            ok &= SetThreadAffinity(*_thread, cpus["track"]);
+        }
+        if (cpus.count("write")) {
+            for (auto rec : { _data_log.get(), _data_sock.get(), _data_com.get(), _vid_frames.get() }) {
+                if (rec) { ok &= rec->setAffinity(cpus["write"]); }
+            }
+        }
+        if (cpus.count("draw") && _drawThread) {
+            ok &= SetThreadAffinity(*_drawThread, cpus["draw"]);
+        }
+        if (!ok) {
+            LOG_ERR("Error! Unable to set thread affinity!");
+        }
+
+        string topo;
+        for (auto& role : cpu_roles) {
+            if ((role == "draw") && !_drawThread) { continue; }
+            auto it = cpus.find(role);
+            topo += role + " " + ((it != cpus.end()) ? CpuListStr(it->second) : "any") + ", ";
+        }
+        LOG("Thread CPUs: %sprocess %s", topo.c_str(), proc_cpus.empty() ? "unknown" : CpuListStr(proc_cpus).c_str());
+    }
+
+    if (metrics_port > 0) {
+        _metrics = make_unique<MetricsPublisher>([this] { return getMetrics(); },
+            (metrics_proto == "tcp") ? MetricsPublisher::TCP : MetricsPublisher::UDP, metrics_host, metrics_port,
+            (metrics_fmt == "json") ? MetricsPublisher::JSON : MetricsPublisher::PROMETHEUS, metrics_period_ms);
+        if (!_metrics->is_active()) {
+            LOG_ERR("Error! Unable to open metrics output (%s %s:%d).", metrics_proto.c_str(), metrics_host.c_str(), metrics_port);
+        }
+    }
+}
+
+///
+/// Embedded tracker. Only the tracking state is set up: frames are pushed in through track().
+///
+Trackball::Trackball(const map<string, string>& cfg, int width, int height)
+    : _guess(0, 0, 0), _prev_log_ts(-1), _init(false), _reset(true), _clean_map(true), _trace(false),
+    _active(true), _kill(false), _do_reset(false)
+{
+    for (auto& kv : cfg) {
+        _cfg.add(kv.first, kv.second);
+    }
+
+    _rig_name = _cfg("rig_name");
+    Logger::ScopedTag log_tag(_rig_name.empty() ? Logger::threadTag() : _rig_name);
+
+    /// No display or outputs - data is returned to the caller.
+    _do_display = _save_raw = _save_debug = false;
+    _do_sock_output = _do_com_output = false;
+    _decim_log = _decim_sock = _decim_com = false;
+    _out_bin = _lat_cols = false;
+    _lat_budget_ms = LAT_BUDGET_MS_DEFAULT;
+    _nbad = 0;
+
+    if ((width <= 0) || (height <= 0) || !initTracking(width, height)) {
+        LOG_ERR("Error! Unable to initialise tracking for %dx%d frames.", width, height);
+        _active = false;
+        return;
+    }
+
+    /// Preprocessing only (no source, so no grab thread).
+    _frameGrabber = make_unique<FrameGrabber>(nullptr, _remapper, _roi_mask, _thresh_ratio, _thresh_win_pc, _cfg("thr_rgb_tfrm"), _thresh_mode);
+
+    /// Data.
+    reset();
+    _data.cnt = 0;
+    _data.intx = _data.inty = 0;
+    _err = 0;
+
+    _init = true;
+}
+
+///
+/// Camera models, sphere ROI and map, and optimisers, for source frames of the given size.
+///
+bool Trackball::initTracking(int width, int height)
+{
     /// Source camera model.
     double vfov = -1;
     if (!_cfg.getDbl("vfov", vfov) || (vfov <= 0)) {
         LOG_ERR("Error! Camera vertical FoV parameter specified in the config file (vfov) is invalid!");
-        _active = false;
-        return;
+        return false;
     }
     bool fisheye = false;
     if (_cfg.getBool("fisheye", fisheye) && fisheye) {
-        _src_model = CameraModel::createFisheye(source->getWidth(), source->getHeight(), vfov * CM_D2R / (double)source->getHeight(), 360 * CM_D2R);
+        _src_model = CameraModel::createFisheye(width, height, vfov * CM_D2R / (double)height, 360 * CM_D2R);
     }
     else {
         // default to rectilinear
-        _src_model = CameraModel::createRectilinear(source->getWidth(), source->getHeight(), vfov * CM_D2R);
+        _src_model = CameraModel::createRectilinear(width, height, vfov * CM_D2R);
     }
 
     /// Dimensions - quality defaults to 6 (remap_dim 60x60, sphere_dim 180x90).
@@ -177,14 +744,14 @@ Trackball::Trackball(string cfg_fn, string src_override)
         LOG_WRN("Warning! Resolution parameter specified in the config file (q_factor) is invalid! Using default value (%d).", q_factor);
         _cfg.add("q_factor", q_factor);
     }
-    _roi_w = _roi_h = std::min(10 * q_factor,source->getWidth());
+    _roi_w = _roi_h = std::min(10 * q_factor, width);
     _map_h = static_cast<int>(1.5 * _roi_h);
     _map_w = 2 * _map_h;
 
     /// Load sphere config and mask.
     bool reconfig = false;
     //_cfg.getBool("reconfig", reconfig); // ignore saved roi_c, roi_r, c2a_r, and c2a_t values and recompute from pixel coords - dangerous!!
-    Mat src_mask(source->getHeight(), source->getWidth(), CV_8UC1);
+    Mat src_mask(height, width, CV_8UC1);
     src_mask.setTo(Scalar::all(0));
     {
         // read pts from config file
@@ -240,8 +807,7 @@ Trackball::Trackball(string cfg_fn, string src_override)
         }
         else {
             LOG_ERR("Error! Sphere ROI configuration specified in config file (roi_circ, roi_c, roi_r) is invalid!");
-            _active = false;
-            return;
+            return false;
         }
     }
 
@@ -278,13 +844,11 @@ Trackball::Trackball(string cfg_fn, string src_override)
             }
             else {
                 LOG_ERR("Error! Camera-to-lab coordinate tranformation specified in config file (c2a_r) is invalid!");
-                _active = false;
-                return;
+                return false;
             }
         } else {
             LOG_ERR("Error! Camera-to-lab coordinate tranformation specified in config file (c2a_r) is invalid!");
-            _active = false;
-            return;
+            return false;
         }
     }
 
@@ -292,12 +856,12 @@ Trackball::Trackball(string cfg_fn, string src_override)
     double sphere_radPerPix = _sphere_rad * 2.0 / _roi_w;
     _roi_model = CameraModel::createFisheye(_roi_w, _roi_h, sphere_radPerPix, _sphere_rad * 2.0);
     _cam_to_roi = MatrixRemapTransform::createFromOmega(-roi_to_cam_r);
-    CameraRemapPtr remapper = CameraRemapPtr(new CameraRemap(_src_model, _roi_model, _cam_to_roi));
+    _remapper = CameraRemapPtr(new CameraRemap(_src_model, _roi_model, _cam_to_roi));
 
     /// ROI mask.
     _roi_mask.create(_roi_h, _roi_w, CV_8UC1);
     _roi_mask.setTo(cv::Scalar::all(255));
-    remapper->apply(src_mask, _roi_mask);
+    _remapper->apply(src_mask, _roi_mask);
 
     /// Surface mapping.
     _sphere_model = CameraModel::createEquiArea(_map_w, _map_h, CM_PI_2, -CM_PI, CM_PI, -2 * CM_PI);
@@ -314,254 +878,94 @@ Trackball::Trackball(string cfg_fn, string src_override)
             _sphere_template = cv::imread(sphere_template_fn, 0);
             if ((_sphere_template.cols != _map_w) || (_sphere_template.rows != _map_h)) {
                 LOG_ERR("Error! Sphere map template specified in the config file (sphere_map_fn) is invalid (%dx%d)!", _sphere_template.cols, _sphere_template.rows);
-                _active = false;
-                return;
-            }
-
-            /// Store initial sphere map.
-            _sphere_template.copyTo(_sphere_map);
-            _clean_map = false;
-
-            LOG("Loaded initial sphere template from %s.", sphere_template_fn.c_str());
-        }
-    }
-
-    /// Pre-calc view rays.
-    _p1s_lut = make_shared<vector<double>>(_roi_w * _roi_h * 3, 0);
-    for (int i = 0; i < _roi_h; i++) {
-        uint8_t* pmask = _roi_mask.ptr(i);
-        for (int j = 0; j < _roi_w; j++) {
-            if (pmask[j] < 255) { continue; }
-
-            double l[3] = { 0, 0, 0 };
-            _roi_model->pixelIndexToVector(j, i, l);
-            vec3normalise(l);
-
-            double* s = &(*_p1s_lut)[(i * _roi_w + j) * 3];
-            if (!intersectSphere(_r_d_ratio, l, s)) { pmask[j] = 128; }
-        }
-    }
-
-    /// Read config params.
-    double tol = OPT_TOL_DEFAULT;
-    if (!_cfg.getDbl("opt_tol", tol) || (tol <= 0)) {
-        LOG_WRN("Warning! Using default value for opt_tol (%f).", tol);
-        _cfg.add("opt_tol", tol);
-    }
-    double bound = OPT_BOUND_DEFAULT;
-    if (!_cfg.getDbl("opt_bound", bound) || (bound <= 0)) {
-        LOG_WRN("Warning! Using default value for opt_bound (%f).", bound);
-        _cfg.add("opt_bound", bound);
-    }
-    int max_evals = OPT_MAX_EVAL_DEFAULT;
-    if (!_cfg.getInt("opt_max_evals", max_evals) || (max_evals <= 0)) {
-        LOG_WRN("Warning! Using default value for opt_max_eval (%d).", max_evals);
-        _cfg.add("opt_max_evals", max_evals);
-    }
-    _do_global_search = OPT_GLOBAL_SEARCH_DEFAULT;
-    if (!_cfg.getBool("opt_do_global", _do_global_search)) {
-        LOG_WRN("Warning! Using default value for opt_do_global (%d).", _do_global_search);
-        _cfg.add("opt_do_global", _do_global_search ? "y" : "n");
-    }
-    _max_bad_frames = OPT_MAX_BAD_FRAMES_DEFAULT;
-    if (!_cfg.getInt("max_bad_frames", _max_bad_frames)) {
-        LOG_WRN("Warning! Using default value for max_bad_frames (%d).", _max_bad_frames);
-        _cfg.add("max_bad_frames", _max_bad_frames);
-    }
-    _error_thresh = -1;
-    if (!_cfg.getDbl("opt_max_err", _error_thresh) || (_error_thresh < 0)) {
-        LOG_WRN("Warning! No optimisation error threshold specified in config file (opt_max_err) - poor matches will not be dropped!");
-        _cfg.add("opt_max_err", _error_thresh);
-    }
-    double thresh_ratio = THRESH_RATIO_DEFAULT;
-    if (!_cfg.getDbl("thr_ratio", thresh_ratio)) {
-        LOG_WRN("Warning! Using default value for thr_ratio (%f).", thresh_ratio);
-        _cfg.add("thr_ratio", thresh_ratio);
-    }
-    double thresh_win_pc = THRESH_WIN_PC_DEFAULT;
-    if (!_cfg.getDbl("thr_win_pc", thresh_win_pc)) {
-        LOG_WRN("Warning! Using default value for thr_win_pc (%f).", thresh_win_pc);
-        _cfg.add("thr_win_pc", thresh_win_pc);
-    }
-
-    /// Init optimisers.
-    _localOpt = make_unique<Localiser>(
-        NLOPT_LN_BOBYQA, bound, tol, max_evals,
-        _sphere_model, _sphere_map,
-        _roi_mask, _p1s_lut);
-
-    _globalOpt = make_unique<Localiser>(
-        NLOPT_GN_CRS2_LM, CM_PI, tol, 1e5,
-        _sphere_model, _sphere_map,
-        _roi_mask, _p1s_lut);
-
-    /// Output.
-    string data_fn = _base_fn + "-" + exec_time + ".dat";
-    _data_log = make_unique<Recorder>(RecorderInterface::RecordType::FILE, data_fn);
-    if (!_data_log->is_active()) {
-        LOG_ERR("Error! Unable to open output data log file (%s).", data_fn.c_str());
-        _active = false;
-        return;
-    }
-
-    int sock_port = SOCK_PORT_DEFAULT;
-    _do_sock_output = false;
-    if (_cfg.getInt("sock_port", sock_port) && (sock_port > 0)) {
-        string sock_host = SOCK_HOST_DEFAULT;
-        if (!_cfg.getStr("sock_host", sock_host)) {
-            LOG_WRN("Warning! Using default value for sock_host (%s).", sock_host.c_str());
-            _cfg.add("sock_host", sock_host);
-        }
-
-        _data_sock = make_unique<Recorder>(RecorderInterface::RecordType::SOCK, sock_host + ":" + std::to_string(sock_port));
-        if (!_data_sock->is_active()) {
-            LOG_ERR("Error! Unable to open output data socket (%s:%d).", sock_host.c_str() ,sock_port);
-            _active = false;
-            return;
-        }
-        _do_sock_output = true;
-    }
-
-    string com_port = _cfg("com_port");
-    _do_com_output = false;
-    if (com_port.length() > 0) {
-        int com_baud = COM_BAUD_DEFAULT;
-        if (!_cfg.getInt("com_baud", com_baud)) {
-            LOG_WRN("Warning! Using default value for com_baud (%d).", com_baud);
-            _cfg.add("com_baud", com_baud);
-        }
-
-        _data_com = make_unique<Recorder>(RecorderInterface::RecordType::COM, com_port + "@" + std::to_string(com_baud));
-        if (!_data_com->is_active()) {
-            LOG_ERR("Error! Unable to open output data com port (%s@%d).", com_port.c_str(), com_baud);
-            _active = false;
-            return;
-        }
-        _do_com_output = true;
-    }
-
-    /// Display.
-    _do_display = DO_DISPLAY_DEFAULT;
-    if (!_cfg.getBool("do_display", _do_display)) {
-        LOG_WRN("Warning! Using default value for do_display (%d).", _do_display);
-        _cfg.add("do_display", _do_display ? "y" : "n");
-    }
-    _save_raw = SAVE_RAW_DEFAULT;
-    if (!source->isLive() || !_cfg.getBool("save_raw", _save_raw)) {
-        LOG_WRN("Warning! Using default value for save_raw (%d).", _save_raw);
-        _cfg.add("save_raw", _save_raw ? "y" : "n");
-    }
-    _save_debug = SAVE_DEBUG_DEFAULT;
-    if (!_cfg.getBool("save_debug", _save_debug)) {
-        LOG_WRN("Warning! Using default value for save_debug (%d).", _save_debug);
-        _cfg.add("save_debug", _save_debug ? "y" : "n");
-    }
-    if (_save_debug & !_do_display) {
-        LOG("Forcing do_display = true, becase save_debug == true.");
-        _do_display = true;
-    }
-    if (_do_display) {
-        _sphere_view.create(_map_h, _map_w, CV_8UC1);
-        _sphere_view.setTo(Scalar::all(128));
-    }
-
-    // do video stuff
-    if (_save_raw || _save_debug) {
-        // find codec
-        int fourcc = 0;
-        string cstr = _cfg("vid_codec"), fext;
-        for (auto codec : CODECS) {
-            if (cstr.compare(codec[0]) == 0) {  // found the codec
-                if (cstr.compare("raw") != 0) { // codec isn't RAW
-                    fourcc = VideoWriter::fourcc(codec[1][0], codec[1][1], codec[1][2], codec[1][3]);
-                }
-                fext = codec[2];
-            }
-        }
-        if (fext.empty()) {
-            // codec not found - use default
-            auto codec = CODECS[0];
-            cstr = codec[0];
-            if (cstr.compare("raw") != 0) { // codec isn't RAW
-                fourcc = VideoWriter::fourcc(codec[1][0], codec[1][1], codec[1][2], codec[1][3]);
-            }
-            fext = codec[2];
-            LOG_WRN("Warning! Using default value for vid_codec (%s).", cstr.c_str());
-            _cfg.add("vid_codec", cstr);
-        }
-
-        // raw input video
-        if (_save_raw) {
-            string vid_fn = _base_fn + "-raw-" + exec_time + "." + fext;
-            double fps = source->getFPS();
-            if (fps <= 0) {
-                fps = (src_fps > 0) ? src_fps : 25;   // if we can't get fps from source, then use fps from config or - if not specified - default to 25 fps.
-            }
-            LOG_DBG("Opening %s for video writing (%s %dx%d @ %f FPS)", vid_fn.c_str(), cstr.c_str(), source->getWidth(), source->getHeight(), fps);
-            _raw_vid.open(vid_fn, fourcc, fps, cv::Size(source->getWidth(), source->getHeight()));
-            if (!_raw_vid.isOpened()) {
-                LOG_ERR("Error! Unable to open raw output video (%s).", vid_fn.c_str());
-                _active = false;
-                return;
-            }
-        }
-
-        // debug output video
-        if (_save_debug) {
-            string vid_fn = _base_fn + "-dbg-" + exec_time + "." + fext;
-            double fps = source->getFPS();
-            if (fps <= 0) {
-                fps = (src_fps > 0) ? src_fps : 25;   // if we can't get fps from source, then use fps from config or - if not specified - default to 25 fps.
-            }
-            LOG_DBG("Opening %s for video writing (%s %dx%d @ %f FPS)", vid_fn.c_str(), cstr.c_str(), 4 * DRAW_CELL_DIM, 3 * DRAW_CELL_DIM, fps);
-            _debug_vid.open(vid_fn, fourcc, fps, cv::Size(4 * DRAW_CELL_DIM, 3 * DRAW_CELL_DIM));
-            if (!_debug_vid.isOpened()) {
-                LOG_ERR("Error! Unable to open debug output video (%s).", vid_fn.c_str());
-                _active = false;
-                return;
-            }
-        }
-
-        // create output file containing log lines corresponding to video frames, for synching video output
-        string fn = _base_fn + "-vidLogFrames-" + exec_time + ".txt";
-        _vid_frames = make_unique<Recorder>(RecorderInterface::RecordType::FILE, fn);
-        if (!_vid_frames->is_active()) {
-            LOG_ERR("Error! Unable to open output video frame number log file (%s).", fn.c_str());
-            _active = false;
-            return;
+                return false;
+            }
+
+            /// Store initial sphere map.
+            _sphere_template.copyTo(_sphere_map);
+            _clean_map = false;
+
+            LOG("Loaded initial sphere template from %s.", sphere_template_fn.c_str());
         }
     }
 
-    /// Frame source.
-    _frameGrabber = make_unique<FrameGrabber>(
-        source,
-        remapper,
-        _roi_mask,
-        thresh_ratio,
-        thresh_win_pc,
-        _cfg("thr_rgb_tfrm")
-    );
+    /// Pre-calc view rays.
+    _p1s_lut = make_shared<vector<double>>(_roi_w * _roi_h * 3, 0);
+    for (int i = 0; i < _roi_h; i++) {
+        uint8_t* pmask = _roi_mask.ptr(i);
+        for (int j = 0; j < _roi_w; j++) {
+            if (pmask[j] < 255) { continue; }
 
-    /// Write all parameters back to config file.
-    _cfg.write();
+            double l[3] = { 0, 0, 0 };
+            _roi_model->pixelIndexToVector(j, i, l);
+            vec3normalise(l);
 
-    /// Data.
-    reset();
+            double* s = &(*_p1s_lut)[(i * _roi_w + j) * 3];
+            if (!intersectSphere(_r_d_ratio, l, s)) { pmask[j] = 128; }
+        }
+    }
 
-    // not reset in resetData because they are not affected by heading reset
-    _data.cnt = 0;
-    _data.intx = _data.inty = 0;
-    _err = 0;
+    /// Read config params.
+    double tol = OPT_TOL_DEFAULT;
+    if (!_cfg.getDbl("opt_tol", tol) || (tol <= 0)) {
+        LOG_WRN("Warning! Using default value for opt_tol (%f).", tol);
+        _cfg.add("opt_tol", tol);
+    }
+    double bound = OPT_BOUND_DEFAULT;
+    if (!_cfg.getDbl("opt_bound", bound) || (bound <= 0)) {
+        LOG_WRN("Warning! Using default value for opt_bound (%f).", bound);
+        _cfg.add("opt_bound", bound);
+    }
+    int max_evals = OPT_MAX_EVAL_DEFAULT;
+    if (!_cfg.getInt("opt_max_evals", max_evals) || (max_evals <= 0)) {
+        LOG_WRN("Warning! Using default value for opt_max_eval (%d).", max_evals);
+        _cfg.add("opt_max_evals", max_evals);
+    }
+    _do_global_search = OPT_GLOBAL_SEARCH_DEFAULT;
+    if (!_cfg.getBool("opt_do_global", _do_global_search)) {
+        LOG_WRN("Warning! Using default value for opt_do_global (%d).", _do_global_search);
+        _cfg.add("opt_do_global", _do_global_search ? "y" : "n");
+    }
+    _max_bad_frames = OPT_MAX_BAD_FRAMES_DEFAULT;
+    if (!_cfg.getInt("max_bad_frames", _max_bad_frames)) {
+        LOG_WRN("Warning! Using default value for max_bad_frames (%d).", _max_bad_frames);
+        _cfg.add("max_bad_frames", _max_bad_frames);
+    }
+    _error_thresh = -1;
+    if (!_cfg.getDbl("opt_max_err", _error_thresh) || (_error_thresh < 0)) {
+        LOG_WRN("Warning! No optimisation error threshold specified in config file (opt_max_err) - poor matches will not be dropped!");
+        _cfg.add("opt_max_err", _error_thresh);
+    }
+    _thresh_ratio = THRESH_RATIO_DEFAULT;
+    if (!_cfg.getDbl("thr_ratio", _thresh_ratio)) {
+        LOG_WRN("Warning! Using default value for thr_ratio (%f).", _thresh_ratio);
+        _cfg.add("thr_ratio", _thresh_ratio);
+    }
+    _thresh_win_pc = THRESH_WIN_PC_DEFAULT;
+    if (!_cfg.getDbl("thr_win_pc", _thresh_win_pc)) {
+        LOG_WRN("Warning! Using default value for thr_win_pc (%f).", _thresh_win_pc);
+        _cfg.add("thr_win_pc", _thresh_win_pc);
+    }
+    string thresh_mode = THRESH_MODE_DEFAULT;
+    if (!_cfg.getStr("thr_mode", thresh_mode) || ((thresh_mode != "minmax") && (thresh_mode != "mean"))) {
+        thresh_mode = THRESH_MODE_DEFAULT;
+        LOG_WRN("Warning! Using default value for thr_mode (%s).", thresh_mode.c_str());
+        _cfg.add("thr_mode", thresh_mode);
+    }
+    _thresh_mode = (thresh_mode == "mean") ? AdaptiveThreshold::MEAN : AdaptiveThreshold::MINMAX;
 
-    /// Thread stuff.
-    _init = true;
-    _active = true;
+    /// Init optimisers.
+    _localOpt = make_unique<Localiser>(
+        NLOPT_LN_BOBYQA, bound, tol, max_evals,
+        _sphere_model, _sphere_map,
+        _roi_mask, _p1s_lut);
 
-    if (_do_display) {
-        _drawThread = make_unique<std::thread>(&Trackball::processDrawQ, this);
-    }
-    // main processing thread
-    _thread = make_unique<std::thread>(&Trackball::process, this);
+    _globalOpt = make_unique<Localiser>(
+        NLOPT_GN_CRS2_LM, CM_PI, tol, 1e5,
+        _sphere_model, _sphere_map,
+        _roi_mask, _p1s_lut);
+
+    return true;
 }
 
 ///
@@ -571,6 +975,8 @@ Trackball::~Trackball()
 {
     LOG("Closing sphere tracker");
 
+    _metrics.reset();
+
     _init = false;
     _active = false;
 
@@ -581,6 +987,96 @@ Trackball::~Trackball()
     if (_do_display && _drawThread && _drawThread->joinable()) {
         _drawThread->join();
     }
+
+    if (_trace) {
+        Trace::disable();
+    }
+}
+
+///
+/// Create synthetic frame source from config. Camera and sphere ROI parameters are shared with the tracker,
+/// so defaults are added to the config where necessary.
+///
+shared_ptr<SyntheticSource> Trackball::makeSyntheticSource()
+{
+    SyntheticSource::Params params;
+
+    vector<int> res;
+    if (!_cfg.getVecInt("synth_res", res) || (res.size() != 2)) {
+        res = { params.width, params.height };
+        LOG_WRN("Warning! Using default value for synth_res (%d %d).", res[0], res[1]);
+        _cfg.add("synth_res", res);
+    }
+    params.width = res[0];
+    params.height = res[1];
+
+    params.fps = SYNTH_FPS_DEFAULT;
+    if (!_cfg.getDbl("synth_fps", params.fps) || (params.fps <= 0)) {
+        params.fps = SYNTH_FPS_DEFAULT;
+        LOG_WRN("Warning! Using default value for synth_fps (%.1f).", params.fps);
+        _cfg.add("synth_fps", params.fps);
+    }
+    params.nframes = SYNTH_NFRAMES_DEFAULT;
+    if (!_cfg.getInt("synth_nframes", params.nframes)) {
+        LOG_WRN("Warning! Using default value for synth_nframes (%d).", params.nframes);
+        _cfg.add("synth_nframes", params.nframes);
+    }
+    int seed = 0;
+    if (!_cfg.getInt("synth_seed", seed)) {
+        LOG_WRN("Warning! Using default value for synth_seed (%d).", seed);
+        _cfg.add("synth_seed", seed);
+    }
+    params.seed = static_cast<unsigned int>(seed);
+
+    vector<double> omega;
+    if (!_cfg.getVecDbl("synth_omega", omega) || (omega.size() != 3)) {
+        omega = { params.omega[0], params.omega[1], params.omega[2] };
+        LOG_WRN("Warning! Using default value for synth_omega (%.2f %.2f %.2f).", omega[0], omega[1], omega[2]);
+        _cfg.add("synth_omega", omega);
+    }
+    params.omega.copy(omega.data());
+    if (!_cfg.getDbl("synth_omega_sd", params.omega_sd) || (params.omega_sd < 0)) {
+        params.omega_sd = 0;
+        LOG_WRN("Warning! Using default value for synth_omega_sd (%.2f).", params.omega_sd);
+        _cfg.add("synth_omega_sd", params.omega_sd);
+    }
+    _cfg.getStr("synth_omega_fn", params.omega_fn);
+    if (!_cfg.getDbl("synth_noise", params.noise) || (params.noise < 0)) {
+        params.noise = SyntheticSource::Params().noise;
+        LOG_WRN("Warning! Using default value for synth_noise (%.1f).", params.noise);
+        _cfg.add("synth_noise", params.noise);
+    }
+    if (!_cfg.getBool("synth_realtime", params.realtime)) {
+        LOG_WRN("Warning! Using default value for synth_realtime (%d).", params.realtime);
+        _cfg.add("synth_realtime", params.realtime ? "y" : "n");
+    }
+
+    /// Camera and sphere geometry (normally measured by configGui).
+    double vfov = SYNTH_VFOV_DEFAULT;
+    if (!_cfg.getDbl("vfov", vfov) || (vfov <= 0)) {
+        vfov = SYNTH_VFOV_DEFAULT;
+        LOG_WRN("Warning! Using default value for vfov (%.1f).", vfov);
+        _cfg.add("vfov", vfov);
+    }
+    params.vfov = vfov * CM_D2R;
+    _cfg.getBool("fisheye", params.fisheye);
+    vector<double> roi_c;
+    if (!_cfg.getVecDbl("roi_c", roi_c) || (roi_c.size() != 3) || !_cfg.getDbl("roi_r", params.roi_r)) {
+        roi_c = { 0, 0, 1 };
+        params.roi_r = SYNTH_ROI_R_DEFAULT;
+        LOG_WRN("Warning! Using default values for roi_c (%.1f %.1f %.1f) and roi_r (%.2f).", roi_c[0], roi_c[1], roi_c[2], params.roi_r);
+        _cfg.add("roi_c", roi_c);
+        _cfg.add("roi_r", params.roi_r);
+    }
+    params.roi_c.copy(roi_c.data());
+    vector<double> c2a_r;
+    if (!_cfg.getVecDbl("c2a_r", c2a_r) || (c2a_r.size() != 3)) {
+        c2a_r = { 0, 0, 0 };
+        LOG_WRN("Warning! Using default value for c2a_r (%.1f %.1f %.1f).", c2a_r[0], c2a_r[1], c2a_r[2]);
+        _cfg.add("c2a_r", c2a_r);
+    }
+
+    return make_shared<SyntheticSource>(params);
 }
 
 ///
@@ -592,6 +1088,8 @@ void Trackball::resetData()
     new_data.cnt = _data.cnt;       // preserve cnt across resets (but reset seq)
     new_data.intx = _data.intx;     // can preserve intx/y because they're not affected by heading reset
     new_data.inty = _data.inty;
+    new_data.t_grab = _data.t_grab; // current frame's latency stamps
+    new_data.t_deq = _data.t_deq;
 
     _data = new_data;
 }
@@ -611,6 +1109,7 @@ void Trackball::reset()
     }
 
     resetData();
+    _path.reset();
 
     /// Drawing.
     if (_do_display) {
@@ -634,60 +1133,40 @@ void Trackball::process()
     } else {
         LOG_DBG("Set processing thread priority to HIGH!");
     }
+    Trace::setThreadName(_rig_name.empty() ? "tracker" : (_rig_name + ".tracker"));
 
     /// Sphere tracking loop.
-    int nbad = 0;
-    double t0 = ts_ms();
-    double t1, t2, t3, t4, t5, t6;
-    double t1avg = 0, t2avg = 0, t3avg = 0, t4avg = 0, t5avg = 0, t6avg = 0;
+    _nbad = 0;
     double tfirst = -1, tlast = 0;
-    while (!_kill && _active && _frameGrabber->getNextFrameSet(_src_frame, _roi_frame, _data.ts, _data.ms)) {
-        t1 = ts_ms();
-
-        PRINT("");
-        LOG("Frame %d", _data.cnt);
-
-        /// Handle reset request
-        if (_do_reset) {
-            nbad = 0;
-            reset();
-        }
-
-        /// Localise current view of sphere.
-        if (!doSearch(_do_global_search)) {
-            t2 = t3 = t4 = t5 = ts_ms();
-            LOG_WRN("Warning! Could not match current sphere orientation to within error threshold (%f).\nNo data will be output for this frame!", _error_thresh);
-            nbad++;
+    double prev_tend = -1, prev_ts = -1, fps_avg = 0, tstatus = -1;
+    static const int zone_frame = Trace::zoneId("track.frame");
+    while (!_kill && _active) {
+        TraceZone frame_zone(zone_frame);
+        {
+            TRACE_ZONE("track.grab");
+            if (!_frameGrabber->getFrameSet(_src_frame, _src_fmt, _roi_frame, _data.ts, _data.ms, _data.t_grab)) {
+                frame_zone.cancel();
+                break;
+            }
         }
-        else {
-            /// Clear reset flag.
-            _reset = false;
+        _data.t_deq = Trace::now();
 
-            t2 = ts_ms();
-            updateSphere();
-            t3 = ts_ms();
-            updatePath();
-            t4 = ts_ms();
-            logData();  // only output good data
-            t5 = ts_ms();
-            nbad = 0;
-        }
+        if (Logger::verbosity() <= Logger::INF) { PRINT(""); }  // separates per-frame messages on screen
+        LOG("Frame %d", _data.cnt);
 
-        /// Handle failed localisation.
-        if ((_max_bad_frames >= 0) && (nbad > _max_bad_frames)) {
-            nbad = 0;
-            reset();
-        } else {
-            _data.seq++;
-        }
+        trackFrame(nullptr);
 
         if (_do_display) {
+            TRACE_ZONE("track.disp");
             auto data = make_shared<DrawData>();
             data->log_frame = _data.cnt;
-            data->src_frame = _src_frame.clone();
-            data->roi_frame = _roi_frame.clone();
+            // grabber never reuses frames it has handed over, so no need to copy them
+            data->src_frame = _src_frame;
+            data->src_fmt = _src_fmt;
+            data->roi_frame = _roi_frame;
             data->sphere_map = _sphere_map.clone();
-            data->sphere_view = _sphere_view.clone();
+            data->sphere_view_roi = _sphere_view_roi;
+            data->sphere_view_R = _sphere_view_R;
             data->dr_roi = _data.dr_roi;
             data->R_roi = _data.R_roi.clone();
             data->R_roi_hist = _R_roi_hist;
@@ -695,39 +1174,42 @@ void Trackball::process()
 
             updateCanvasAsync(data);
         }
-        t6 = ts_ms();
+        double tend = ts_ms();
 
-        /// Timing.
-        if (_data.cnt > 0) {     // skip first frame (often global search...)
-            t1avg += t1 - t0;
-            t2avg += t2 - t1;
-            t3avg += t3 - t2;
-            t4avg += t4 - t3;
-            t5avg += t5 - t4;
-            t6avg += t6 - t5;
-
-            // opt evals
-            _data.evals_avg += _nevals;
-        }
-        LOG("Timing grab/opt/map/plot/log/disp: %.1f / %.1f / %.1f / %.1f / %.1f / %.1f ms",
-            t1 - t0, t2 - t1, t3 - t2, t4 - t3, t5 - t4, t6 - t5);
-        static double prev_t6 = t6;
-        double fps_out = (t6 - prev_t6) > 0 ? 1000 / (t6 - prev_t6) : 0;
-        static double fps_avg = fps_out;
+        /// Statistics.
+        double fps_out = ((prev_tend > 0) && (tend > prev_tend)) ? 1000 / (tend - prev_tend) : 0;
         fps_avg += 0.25 * (fps_out - fps_avg);
-        static double prev_ts = _data.ts;
-        double fps_in = (_data.ts - prev_ts) > 0 ? 1000 / (_data.ts - prev_ts) : 0;
-        LOG("Average frame rate [in/out]: %.1f [%.1f / %.1f] fps", fps_avg, fps_in, fps_out);
-        prev_t6 = t6;
+        double fps_in = ((prev_ts > 0) && (_data.ts > prev_ts)) ? 1000 / (_data.ts - prev_ts) : 0;
+        {
+            lock_guard<mutex> l(_timing_mutex);
+            if (tfirst >= 0) { _timing.elapsed_ms = tend - tfirst; }
+            _timing.fps_in = fps_in;
+            _timing.fps_out = fps_out;
+        }
+
+        /// Periodic status (at most once per second).
+        if ((tstatus < 0) || (tend - tstatus >= 1000)) {
+            tstatus = tend;
+            double p50, p99;
+            {
+                lock_guard<mutex> l(_timing_mutex);
+                p50 = _timing.lat_opt.percentile(50);
+                p99 = _timing.lat_opt.percentile(99);
+            }
+            LOG("Average frame rate [in/out]: %.1f [%.1f / %.1f] fps", fps_avg, fps_in, fps_out);
+            FrameGrabber::Stats fstats = _frameGrabber->getStats();
+            LOG("Frame queue depth [now/max]: %zd / %zd, dropped: %lu", fstats.q_depth, fstats.q_depth_max, fstats.dropped);
+            LOG("Latency grab->opt [now/p50/p99]: %.2f / %.2f / %.2f ms", (_data.t_opt - _data.t_grab) / 1e6, p50, p99);
+        }
+        prev_tend = tend;
         prev_ts = _data.ts;
 
         /// Always increment frame counter.
         _data.cnt++;
 
-        t0 = ts_ms();
-        if (tfirst < 0) { tfirst = t0; }
+        if (tfirst < 0) { tfirst = tend; }
+        tlast = tend;
     }
-    tlast = t0;
 
     LOG_DBG("Stopped sphere tracking loop!");
 
@@ -736,9 +1218,28 @@ void Trackball::process()
     if (_data.cnt > 1) {
         PRINT("\n----------------------------------------------------------------------------");
         LOG("Trackball timing:");
-        LOG("Average grab/opt/map/plot/log/disp time: %.1f / %.1f / %.1f / %.1f / %.1f / %.1f ms",
-            t1avg / (_data.cnt - 1), t2avg / (_data.cnt - 1), t3avg / (_data.cnt - 1), t4avg / (_data.cnt - 1), t5avg / (_data.cnt - 1), t6avg / (_data.cnt - 1));
+        if (_trace) { Trace::report(); }
         LOG("Average fps: %.2f", 1000. * (_data.cnt - 1) / (tlast - tfirst));
+        FrameGrabber::Stats fstats = _frameGrabber->getStats();
+        LOG("Frames grabbed/dropped: %lu / %lu (%.1f%%), max frame queue depth: %zd",
+            fstats.grabbed, fstats.dropped, fstats.grabbed > 0 ? 100. * fstats.dropped / fstats.grabbed : 0., fstats.q_depth_max);
+
+        PRINT("");
+        Timing timing = getTiming();
+        LOG("Latency from grab (ms): %-20s %10s %8s %8s %8s %8s", "stage", "count", "mean", "p50", "p99", "max");
+        auto log_lat = [](const string& name, const LatencyHist& h) {
+            LOG("                        %-20s %10llu %8.3f %8.3f %8.3f %8.3f", name.c_str(), static_cast<unsigned long long>(h.count()),
+                h.mean(), h.percentile(50), h.percentile(99), h.max());
+        };
+        log_lat("dequeue", timing.lat_deq);
+        log_lat("opt", timing.lat_opt);
+        for (auto& w : timing.lat_write) { log_lat("write." + w.first, w.second); }
+        if (_lat_budget_ms > 0) {
+            LOG("Latency budget (%.2f ms) exceeded: %lu / %lu frames", _lat_budget_ms, timing.lat_over, timing.nframes);
+        }
+        for (auto& d : timing.out_dropped) {
+            if (d.second > 0) { LOG_WRN("Warning! %lu output lines were dropped (%s).", d.second, d.first.c_str()); }
+        }
 
         PRINT("");
         LOG("Optimiser test data:");
@@ -749,19 +1250,172 @@ void Trackball::process()
     _active = false;
 }
 
+///
+/// Embedded tracking: preprocess and track one frame in the caller's thread.
+///
+bool Trackball::track(const Mat& frame, PIXEL_FORMAT fmt, double ts, DataRecord& rec)
+{
+    if (!_init || _thread) { return false; }    // threaded trackers track their own source
+
+    _data.t_grab = _data.t_deq = Trace::now();
+    _data.ts = ts;
+    _data.ms = ms_since_midnight();
+    if (!_frameGrabber->preprocessFrame(frame, fmt, _roi_frame)) { return false; }
+
+    bool found = trackFrame(&rec);
+
+    _data.cnt++;
+    return found;
+}
+
+///
+/// Track the current frame (the per-frame step of both the tracking loop and embedded tracking).
+/// Good data is returned in rec if given, otherwise it is written to the configured outputs.
+///
+bool Trackball::trackFrame(DataRecord* rec)
+{
+    /// Handle reset request
+    if (_do_reset) {
+        _nbad = 0;
+        reset();
+    }
+
+    /// Localise current view of sphere.
+    bool found;
+    {
+        TRACE_ZONE("track.opt");
+        found = doSearch(_do_global_search);
+    }
+    _data.t_opt = Trace::now();
+    double lat_deq = (_data.t_deq - _data.t_grab) / 1e6;
+    double lat_opt = (_data.t_opt - _data.t_grab) / 1e6;
+    bool over = (_lat_budget_ms > 0) && (lat_opt > _lat_budget_ms);
+    if (over) {
+        LOG_WRN("Warning! Latency budget exceeded (%.2f > %.2f ms)!", lat_opt, _lat_budget_ms);
+    }
+    if (!found) {
+        LOG_WRN("Warning! Could not match current sphere orientation to within error threshold (%f).\nNo data will be output for this frame!", _error_thresh);
+        _nbad++;
+    }
+    else {
+        /// Clear reset flag.
+        _reset = false;
+
+        {
+            TRACE_ZONE("track.map");
+            updateSphere();
+        }
+        {
+            TRACE_ZONE("track.path");
+            updatePath();
+        }
+        {
+            TRACE_ZONE("track.log");
+            // only output good data
+            if (rec) { makeRecord(*rec); }
+            else { logData(); }
+        }
+        _nbad = 0;
+    }
+
+    /// Handle failed localisation.
+    bool bad = _nbad > 0;
+    if ((_max_bad_frames >= 0) && (_nbad > _max_bad_frames)) {
+        _nbad = 0;
+        reset();
+    } else {
+        _data.seq++;
+    }
+
+    /// Statistics.
+    {
+        lock_guard<mutex> l(_timing_mutex);
+        if (_data.cnt > 0) {     // skip first frame (often global search...)
+            _timing.evals.add(_nevals);
+            _data.evals_avg += _nevals;
+        }
+        _timing.nframes = _data.cnt + 1;
+        if (bad) { _timing.nbad++; }
+        _timing.lat_deq.add(lat_deq);
+        _timing.lat_opt.add(lat_opt);
+        if (over) { _timing.lat_over++; }
+        _timing.err = _err;
+    }
+    return found;
+}
+
+///
+/// Copy of the tracking loop timing statistics.
+///
+Trackball::Timing Trackball::getTiming()
+{
+    lock_guard<mutex> l(_timing_mutex);
+    Timing timing = _timing;
+    if (_frameGrabber) { timing.grabber = _frameGrabber->getStats(); }
+    if (_data_log) {
+        timing.lat_write["file"] = _data_log->getLatency();
+        timing.out_dropped["file"] = _data_log->dropped();
+    }
+    if (_data_sock) {
+        timing.lat_write["sock"] = _data_sock->getLatency();
+        timing.out_dropped["sock"] = _data_sock->dropped();
+    }
+    if (_data_com) {
+        timing.lat_write["com"] = _data_com->getLatency();
+        timing.out_dropped["com"] = _data_com->dropped();
+    }
+    return timing;
+}
+
+///
+/// Snapshot of tracking statistics for the metrics publisher.
+///
+MetricsPublisher::Metrics Trackball::getMetrics()
+{
+    Timing timing = getTiming();
+
+    MetricsPublisher::Metrics m;
+    m.push_back({ "frames", {}, static_cast<double>(timing.nframes) });
+    m.push_back({ "bad_frames", {}, static_cast<double>(timing.nbad) });
+    m.push_back({ "fps_in", {}, timing.fps_in });
+    m.push_back({ "fps_out", {}, timing.fps_out });
+    m.push_back({ "opt_error", {}, timing.err });
+    m.push_back({ "evals_per_frame", {}, timing.evals.mean() });
+    m.push_back({ "frames_grabbed", {}, static_cast<double>(timing.grabber.grabbed) });
+    m.push_back({ "frames_dropped", {}, static_cast<double>(timing.grabber.dropped) });
+    m.push_back({ "frame_q_depth", {}, static_cast<double>(timing.grabber.q_depth) });
+    m.push_back({ "frame_q_depth_max", {}, static_cast<double>(timing.grabber.q_depth_max) });
+    m.push_back({ "latency_budget_exceeded", {}, static_cast<double>(timing.lat_over) });
+
+    auto add_hist = [&m](const string& name, const string& stage, const LatencyHist& h) {
+        m.push_back({ name, { { "stage", stage }, { "stat", "mean" } }, h.mean() });
+        m.push_back({ name, { { "stage", stage }, { "stat", "p50" } }, h.percentile(50) });
+        m.push_back({ name, { { "stage", stage }, { "stat", "p99" } }, h.percentile(99) });
+        m.push_back({ name, { { "stage", stage }, { "stat", "max" } }, h.max() });
+    };
+    if (_trace) {
+        for (auto& z : Trace::histograms()) { add_hist("stage_ms", z.first, z.second); }
+    }
+    add_hist("latency_ms", "dequeue", timing.lat_deq);
+    add_hist("latency_ms", "opt", timing.lat_opt);
+    for (auto& w : timing.lat_write) { add_hist("latency_ms", "write." + w.first, w.second); }
+    for (auto& d : timing.out_dropped) { m.push_back({ "output_dropped", { { "output", d.first } }, static_cast<double>(d.second) }); }
+
+    return m;
+}
+
 ///
 ///
 ///
 bool Trackball::doSearch(bool allow_global = false)
 {
     /// Maintain a low-pass filtered rotation to use as guess.
-    static CmPoint64f guess(0, 0, 0);
-    if (_reset) { guess = CmPoint64f(0, 0, 0); }
+    if (_reset) { _guess = CmPoint64f(0, 0, 0); }
 
     /// Run optimisation and save result.
     _nevals = 0;
     if (!_reset) {
-        _data.dr_roi = guess;
+        _data.dr_roi = _guess;
         _err = _localOpt->search(_roi_frame, _data.R_roi, _data.dr_roi);  // _dr_roi contains optimal rotation
         _nevals = _localOpt->getNumEval();
     }
@@ -801,9 +1455,9 @@ bool Trackball::doSearch(bool allow_global = false)
     LOG_DBG("Current sphere orientation:\t%.3f %.3f %.3f", _data.r_roi[0], _data.r_roi[1], _data.r_roi[2]);
 
     if (!bad_frame) {
-        guess = 0.9 * _data.dr_roi + 0.1 * guess;
+        _guess = 0.9 * _data.dr_roi + 0.1 * _guess;
     } else {
-        guess = CmPoint64f(0,0,0);
+        _guess = CmPoint64f(0,0,0);
     }
 
     return !bad_frame;
@@ -814,24 +1468,47 @@ bool Trackball::doSearch(bool allow_global = false)
 ///
 void Trackball::updateSphere()
 {
-    double* m = reinterpret_cast<double*>(_data.R_roi.data); // absolute orientation (3d mat) in ROI frame
-
+    /// Sphere view is drawn lazily on the drawing thread, just remember what to draw.
     if (_do_display) {
-        _sphere_view.setTo(Scalar::all(128));
+        _sphere_view_roi = _roi_frame;
+        _sphere_view_R = _data.R_roi.clone();
+    }
+
+    int good = 0;
+    int cnt = updateSphereMap(_roi_frame, _roi_mask, *_p1s_lut, _data.R_roi, _sphere_model, _sphere_map, good);
+    
+    if (cnt > 0) {
+        _clean_map = false;
+        LOG_DBG("Sphere ROI match overlap: %.1f%%", 100 * good / static_cast<double>(cnt));
     }
+    else {
+        LOG_DBG("Sphere ROI match overlap: 0%%");
+    }
+}
+
+///
+/// Accumulate thresholded ROI pixels into the sphere map at orientation R_roi.
+/// Returns the number of ROI pixels tested; good is set to the number that overlapped previously seen map tiles.
+///
+int Trackball::updateSphereMap(const Mat& roi_frame, const Mat& roi_mask, const vector<double>& p1s_lut,
+    const Mat& R_roi, const CameraModelPtr& sphere_model, Mat& sphere_map, int& good)
+{
+    const double* m = reinterpret_cast<const double*>(R_roi.data); // absolute orientation (3d mat) in ROI frame
+    const int roi_w = roi_mask.cols, roi_h = roi_mask.rows;
 
     double p2s[3];
-    int cnt = 0, good = 0;
+    int cnt = 0;
     int px = 0, py = 0;
-    for (int i = 0; i < _roi_h; i++) {
-        const uint8_t* pmask = _roi_mask.ptr(i);
-        const uint8_t* proi = _roi_frame.ptr(i);
-        for (int j = 0; j < _roi_w; j++) {
+    good = 0;
+    for (int i = 0; i < roi_h; i++) {
+        const uint8_t* pmask = roi_mask.ptr(i);
+        const uint8_t* proi = roi_frame.ptr(i);
+        for (int j = 0; j < roi_w; j++) {
             if (pmask[j] < 255) { continue; }
             cnt++;
 
             // rotate point about rotation axis (sphere coords)
-            double* v = &(*_p1s_lut)[(i * _roi_w + j) * 3];
+            const double* v = &p1s_lut[(i * roi_w + j) * 3];
             //p2s[0] = m[0] * v[0] + m[1] * v[1] + m[2] * v[2];
             //p2s[1] = m[3] * v[0] + m[4] * v[1] + m[5] * v[2];
             //p2s[2] = m[6] * v[0] + m[7] * v[1] + m[8] * v[2];
@@ -842,8 +1519,8 @@ void Trackball::updateSphere()
 
 
             // map vector in sphere coords to pixel
-            if (!_sphere_model->vectorToPixelIndex(p2s, px, py)) { continue; }
-            uint8_t& map = _sphere_map.data[py * _sphere_map.step + px];
+            if (!sphere_model->vectorToPixelIndex(p2s, px, py)) { continue; }
+            uint8_t& map = sphere_map.data[py * sphere_map.step + px];
 
             // update map tile
             if ((map == 0) || (map == 255)) {
@@ -856,19 +1533,9 @@ void Trackball::updateSphere()
                 good++;
                 map = (proi[j] == 255) ? (map + 1) : (map - 1);
             }
-
-            // display
-            if (_do_display) { _sphere_view.at<uint8_t>(py, px) = proi[j]; }
         }
     }
-    
-    if (cnt > 0) {
-        _clean_map = false;
-        LOG_DBG("Sphere ROI match overlap: %.1f%%", 100 * good / static_cast<double>(cnt));
-    }
-    else {
-        LOG_DBG("Sphere ROI match overlap: 0%%");
-    }
+    return cnt;
 }
 
 ///
@@ -928,11 +1595,19 @@ void Trackball::updatePath()
     //Maths::ANGLE_AXIS_FROM_MAT(Rcam, Rv);
 
 
-    // running speed, radians/frame (-ve rotation around x-axis causes y-axis translation & vice-versa!!)
-    _data.velx = _data.dr_lab[1];
-    _data.vely = -_data.dr_lab[0];
-    _data.step_mag = sqrt(_data.velx * _data.velx + _data.vely * _data.vely);  // magnitude (radians) of ball rotation excluding turning (change in heading)
-    
+    // running speed, direction, heading and fictive path
+    const PathIntegrator::State& p = _path.update(_data.dr_lab);
+    _data.velx = p.velx;
+    _data.vely = p.vely;
+    _data.step_mag = p.step_mag;
+    _data.step_dir = p.step_dir;
+    _data.intx = p.intx;
+    _data.inty = p.inty;
+    _data.heading = p.heading;
+    _data.posx = p.posx;
+    _data.posy = p.posy;
+    _data.ang_dist = p.ang_dist;
+
     // test data
     if (_data.cnt > 0) {
         _data.dist += _data.step_mag;
@@ -943,43 +1618,6 @@ void Trackball::updatePath()
         _data.step_var += delta * delta2;  // running variance (Welford's alg)
     }
 
-    // running direction
-    _data.step_dir = atan2(_data.vely, _data.velx);
-    if (_data.step_dir < 0) { _data.step_dir += 360 * CM_D2R; }
-
-    // integrated x/y pos (optical mouse style)
-    _data.intx += _data.velx;
-    _data.inty += _data.vely;
-
-    // integrate bee heading
-    _data.heading -= _data.dr_lab[2];
-    while (_data.heading < 0) { _data.heading += 360 * CM_D2R; }
-    while (_data.heading >= 360 * CM_D2R) { _data.heading -= 360 * CM_D2R; }
-    _data.ang_dist += abs(_data.dr_lab[2]);
-
-    // integrate 2d position
-    {
-        const int steps = 4;	// increasing this doesn't help much
-        double step = _data.step_mag / steps;
-        static double prev_heading = 0;
-        if (_reset) { prev_heading = 0; }
-        double heading_step = (_data.heading - prev_heading);
-        while (heading_step >= 180 * CM_D2R) { heading_step -= 360 * CM_D2R; }
-        while (heading_step < -180 * CM_D2R) { heading_step += 360 * CM_D2R; }
-        heading_step /= steps;  // do after wrapping above
-
-        // super-res integration
-        CmPoint64f dir(_data.velx, _data.vely, 0);
-        dir.normalise();
-        dir.rotateAboutNorm(CmPoint(0, 0, 1), prev_heading + heading_step / 2.0);
-        for (int i = 0; i < steps; i++) {
-            _data.posx += step * dir[0];
-            _data.posy += step * dir[1];
-            dir.rotateAboutNorm(CmPoint(0, 0, 1), heading_step);
-        }
-        prev_heading = _data.heading;
-    }
-
     if (_do_display) {
         // update pos hist (in ROI-space!)
         _R_roi_hist.push_back(_data.R_roi.clone());
@@ -993,59 +1631,111 @@ void Trackball::updatePath()
     }
 }
 
+///
+///
+///
+void Trackball::makeRecord(DataRecord& rec)
+{
+    if (_prev_log_ts < 0) { _prev_log_ts = _data.ts; }
+
+    rec.cnt = _data.cnt;
+    for (int i = 0; i < 3; i++) {
+        rec.dr_cam[i] = _data.dr_cam[i];
+        rec.dr_lab[i] = _data.dr_lab[i];
+        rec.r_cam[i] = _data.r_cam[i];
+        rec.r_lab[i] = _data.r_lab[i];
+    }
+    rec.err = _err;
+    rec.posx = _data.posx;
+    rec.posy = _data.posy;
+    rec.heading = _data.heading;
+    rec.step_dir = _data.step_dir;
+    rec.step_mag = _data.step_mag;
+    rec.intx = _data.intx;
+    rec.inty = _data.inty;
+    rec.ts = _data.ts;
+    rec.seq = _data.seq;
+    rec.dts = _data.ts - _prev_log_ts;
+    rec.ms = _data.ms;
+    rec.lat_deq = (_data.t_deq - _data.t_grab) / 1e6;
+    rec.lat_opt = (_data.t_opt - _data.t_grab) / 1e6;
+    rec.lat_out = (Trace::now() - _data.t_grab) / 1e6;
+
+    _prev_log_ts = _data.ts;    // caution - be sure that this time delta corresponds to deltas for step size, rotation rate, etc!!
+}
+
 ///
 ///
 ///
 bool Trackball::logData()
 {
-    std::stringstream ss;
-    ss.precision(14);
-
-    static double prev_ts = _data.ts;
-
-    // frame_count
-    ss << _data.cnt << ", ";
-    // rel_vec_cam[3] | error
-    ss << _data.dr_cam[0] << ", " << _data.dr_cam[1] << ", " << _data.dr_cam[2] << ", " << _err << ", ";
-    // rel_vec_world[3]
-    ss << _data.dr_lab[0] << ", " << _data.dr_lab[1] << ", " << _data.dr_lab[2] << ", ";
-    // abs_vec_cam[3]
-    ss << _data.r_cam[0] << ", " << _data.r_cam[1] << ", " << _data.r_cam[2] << ", ";
-    // abs_vec_world[3]
-    ss << _data.r_lab[0] << ", " << _data.r_lab[1] << ", " << _data.r_lab[2] << ", ";
-    // integrated xpos | integrated ypos | integrated heading
-    ss << _data.posx << ", " << _data.posy << ", " << _data.heading << ", ";
-    // direction (radians) | speed (radians/frame)
-    ss << _data.step_dir << ", " << _data.step_mag << ", ";
-    // integrated x movement | integrated y movement (mouse output equivalent)
-    ss << _data.intx << ", " << _data.inty << ", ";
-    // timestamp (ms since epoch) | sequence number | delta ts (ms since last frame) | timestamp (ms since midnight)
-    ss << _data.ts << ", " << _data.seq << ", " << (_data.ts - prev_ts) << ", " << _data.ms << std::endl;
-
-    prev_ts = _data.ts;     // caution - be sure that this time delta corresponds to deltas for step size, rotation rate, etc!!
-
-    // async i/o
+    DataRecord rec;
+    makeRecord(rec);
+
+    // shared memory is written synchronously (no syscalls), ahead of the queued outputs
     bool ret = true;
+    if (_data_shm) {
+        ret &= _data_shm->writeRecord(string_view(reinterpret_cast<const char*>(&rec), sizeof(rec)));
+    }
+
+    // async i/o - each format is written once and the same buffer is queued on every output
+    // (decimated outputs are sent the binary record and format it themselves)
+    bool need_txt = (!_out_bin && (!_decim_log || (_do_sock_output && !_decim_sock))) || (_do_com_output && !_decim_com);
+    bool need_bin = _out_bin || _decim_log || _decim_sock || _decim_com;
+    shared_ptr<string> txt, bin;
+    if (need_txt) {
+        txt = getOutputBuffer();
+        txt->resize(4 + DataRecord::TEXT_MAX);
+        memcpy(&(*txt)[0], "FT, ", 4);  // socket/serial prefix, skipped for the log file
+        txt->resize(4 + rec.formatText(&(*txt)[4], DataRecord::TEXT_MAX, _lat_cols));
+    }
+    if (need_bin) {
+        bin = getOutputBuffer();
+        bin->assign(reinterpret_cast<const char*>(&rec), sizeof(rec));
+    }
     if (_do_sock_output) {
-        ret &= _data_sock->addMsg("FT, " + ss.str());
+        ret &= _data_sock->addMsg((_out_bin || _decim_sock) ? bin : txt, 0, _data.t_grab);
     }
     if (_do_com_output) {
-        ret &= _data_com->addMsg("FT, " + ss.str());
+        ret &= _data_com->addMsg(_decim_com ? bin : txt, 0, _data.t_grab);
+    }
+    if (_out_bin || _decim_log) {
+        ret &= _data_log->addMsg(bin, 0, _data.t_grab);
+    }
+    else {
+        ret &= _data_log->addMsg(txt, 4, _data.t_grab);
     }
-    ret &= _data_log->addMsg(ss.str());
     return ret;
 }
 
+///
+/// Reuse an output buffer that no recorder still holds, so that logging doesn't allocate once the pool is warm.
+///
+shared_ptr<string> Trackball::getOutputBuffer()
+{
+    for (auto& buf : _out_bufs) {
+        if (buf.use_count() == 1) {
+            atomic_thread_fence(memory_order_acquire);  // pairs with the recorder thread releasing its reference
+            buf->clear();
+            return buf;
+        }
+    }
+    auto buf = make_shared<string>();
+    buf->reserve(4 + DataRecord::TEXT_MAX);
+    if (_out_bufs.size() < OUT_BUF_POOL_MAX) { _out_bufs.push_back(buf); }
+    return buf;
+}
+
 ///
 ///
 ///
 double Trackball::testRotation(const double x[3])
 {
-    static double lmat[9];
+    double lmat[9];
     CmPoint64f tmp(x[0], x[1], x[2]);
     tmp.omegaToMatrix(lmat);                    // relative rotation in camera frame
     double* rmat = (double*)_data.R_roi.data;  // pre-multiply to orientation matrix
-    static double m[9];                         // absolute orientation in camera frame
+    double m[9];                                // absolute orientation in camera frame
 
     m[0] = lmat[0] * rmat[0] + lmat[1] * rmat[3] + lmat[2] * rmat[6];
     m[1] = lmat[0] * rmat[1] + lmat[1] * rmat[4] + lmat[2] * rmat[7];
@@ -1210,6 +1900,13 @@ void Trackball::processDrawQ()
         LOG_ERR("Error! Unable to set thread priority!");
     }
 
+    Trace::setThreadName(_rig_name.empty() ? "draw" : (_rig_name + ".draw"));
+
+    {
+        lock_guard<mutex> ld(display_mutex);
+        display_rigs++;
+    }
+
     /// Get a un/lockable lock.
     unique_lock<mutex> l(_drawMutex);
 
@@ -1234,21 +1931,62 @@ void Trackball::processDrawQ()
         l.unlock();
 
         /// Draw canvas unlocked.
-        drawCanvas(data);
+        {
+            TRACE_ZONE("draw.canvas");
+            drawCanvas(data);
+        }
 
         l.lock();
     }
     l.unlock();
 
+    {
+        lock_guard<mutex> ld(display_mutex);
+        display_rigs--;
+    }
+
     LOG_DBG("Finished processing drawing queue.");
 }
 
+///
+/// Map thresholded ROI onto sphere surface, for display.
+///
+void Trackball::drawSphereView(const Mat& roi_frame, const Mat& R_roi, Mat& sphere_view)
+{
+    sphere_view.create(_map_h, _map_w, CV_8UC1);
+    sphere_view.setTo(Scalar::all(128));
+    if (roi_frame.empty() || R_roi.empty()) { return; }
+
+    const double* m = reinterpret_cast<const double*>(R_roi.data); // absolute orientation (3d mat) in ROI frame
+
+    double p2s[3];
+    int px = 0, py = 0;
+    for (int i = 0; i < _roi_h; i++) {
+        const uint8_t* pmask = _roi_mask.ptr(i);
+        const uint8_t* proi = roi_frame.ptr(i);
+        for (int j = 0; j < _roi_w; j++) {
+            if (pmask[j] < 255) { continue; }
+
+            // rotate point about rotation axis (sphere coords) - see updateSphere()
+            const double* v = &(*_p1s_lut)[(i * _roi_w + j) * 3];
+            p2s[0] = m[0] * v[0] + m[3] * v[1] + m[6] * v[2];
+            p2s[1] = m[1] * v[0] + m[4] * v[1] + m[7] * v[2];
+            p2s[2] = m[2] * v[0] + m[5] * v[1] + m[8] * v[2];
+
+            // map vector in sphere coords to pixel
+            if (!_sphere_model->vectorToPixelIndex(p2s, px, py)) { continue; }
+            sphere_view.data[py * sphere_view.step + px] = proi[j];
+        }
+    }
+}
+
 ///
 ///
 ///
 void Trackball::drawCanvas(shared_ptr<DrawData> data)
 {
-    static Mat canvas(3 * DRAW_CELL_DIM, 4 * DRAW_CELL_DIM, CV_8UC3);
+    Mat& canvas = _draw.canvas;
+    canvas.create(3 * DRAW_CELL_DIM, 4 * DRAW_CELL_DIM, CV_8UC3);
     canvas.setTo(Scalar::all(0));
 
     /// Unpack current data.
@@ -1256,60 +1994,82 @@ void Trackball::drawCanvas(shared_ptr<DrawData> data)
     Mat& roi_frame = data->roi_frame;
     CmPoint64f& dr_roi = data->dr_roi;
     Mat& R_roi = data->R_roi;
-    Mat& sphere_view = data->sphere_view;
+    Mat sphere_view;
+    drawSphereView(data->sphere_view_roi, data->sphere_view_R, sphere_view);
     Mat& sphere_map = data->sphere_map;
     deque<Mat>& R_roi_hist = data->R_roi_hist;
     deque<CmPoint64f>& pos_heading_hist = data->pos_heading_hist;
     unsigned int log_frame = data->log_frame;
 
     /// Draw source image.
-    double radPerPix = _sphere_rad * 3.0 / (2 * DRAW_CELL_DIM);
-    static CameraModelPtr draw_camera = CameraModel::createFisheye(
-        2 * DRAW_CELL_DIM, 2 * DRAW_CELL_DIM, radPerPix, 360 * CM_D2R);
-    static CameraRemapPtr draw_remapper = CameraRemapPtr(new CameraRemap(
-        _src_model, draw_camera, _cam_to_roi));
+    if (!_draw.remapper) {
+        double radPerPix = _sphere_rad * 3.0 / (2 * DRAW_CELL_DIM);
+        _draw.camera = CameraModel::createFisheye(
+            2 * DRAW_CELL_DIM, 2 * DRAW_CELL_DIM, radPerPix, 360 * CM_D2R);
+        _draw.remapper = CameraRemapPtr(new CameraRemap(
+            _src_model, _draw.camera, _cam_to_roi));
+    }
+    CameraModelPtr& draw_camera = _draw.camera;
+    CameraRemapPtr& draw_remapper = _draw.remapper;
         
     Mat draw_input = canvas(Rect(0, 0, 2 * DRAW_CELL_DIM, 2 * DRAW_CELL_DIM));
-    draw_remapper->apply(src_frame, draw_input);
+    Mat src_bgr;
+    if ((data->src_fmt == PIXEL_MONO8) && !_save_raw) {
+        // only colour convert the (small) remapped image
+        Mat draw_grey;
+        draw_remapper->apply(src_frame, draw_grey);
+        cv::cvtColor(draw_grey, draw_input, cv::COLOR_GRAY2BGR);
+    }
+    else {
+        FrameSource::toBGR(src_frame, data->src_fmt, src_bgr);
+        draw_remapper->apply(src_bgr, draw_input);
+    }
 
     /// Sphere warping.
-    static Mat mapX(_roi_h, _roi_w, CV_32FC1);
+    Mat& mapX = _draw.mapX;
+    mapX.create(_roi_h, _roi_w, CV_32FC1);
     mapX.setTo(Scalar::all(-1));
-    static Mat mapY(_roi_h, _roi_w, CV_32FC1);
+    Mat& mapY = _draw.mapY;
+    mapY.create(_roi_h, _roi_w, CV_32FC1);
     mapY.setTo(Scalar::all(-1));
     makeSphereRotMaps(_roi_model, mapX, mapY, _roi_mask, _r_d_ratio, dr_roi);
 
     BasicRemapper warper(_roi_w, _roi_h, mapX, mapY);
-    static Mat prev_roi = roi_frame;   // no copy!
-    static Mat warp_roi(_roi_h, _roi_w, CV_8UC1);
+    if (_draw.prev_roi.empty()) { _draw.prev_roi = roi_frame; }   // no copy!
+    Mat& warp_roi = _draw.warp_roi;
+    warp_roi.create(_roi_h, _roi_w, CV_8UC1);
     warp_roi.setTo(Scalar::all(0));
-    warper.apply(prev_roi, warp_roi);
-    prev_roi = roi_frame;  // no copy!
+    warper.apply(_draw.prev_roi, warp_roi);
+    _draw.prev_roi = roi_frame;  // no copy!
 
     /// Diff image.
-    static Mat diff_roi(_roi_h, _roi_w, CV_8UC1);
+    Mat& diff_roi = _draw.diff_roi;
     cv::absdiff(roi_frame, warp_roi, diff_roi);
 
     /// Draw thresholded ROI.
-    static Mat resize_roi(DRAW_CELL_DIM, DRAW_CELL_DIM, CV_8UC1);
+    Mat& resize_roi = _draw.resize_roi;
+    resize_roi.create(DRAW_CELL_DIM, DRAW_CELL_DIM, CV_8UC1);
     cv::resize(roi_frame, resize_roi, resize_roi.size());
     Mat draw_roi = canvas(Rect(2 * DRAW_CELL_DIM, 0, DRAW_CELL_DIM, DRAW_CELL_DIM));
     cv::cvtColor(resize_roi, draw_roi, cv::COLOR_GRAY2BGR);
 
     /// Draw warped diff ROI.
-    static Mat resize_diff(DRAW_CELL_DIM, DRAW_CELL_DIM, CV_8UC1);
+    Mat& resize_diff = _draw.resize_diff;
+    resize_diff.create(DRAW_CELL_DIM, DRAW_CELL_DIM, CV_8UC1);
     cv::resize(diff_roi, resize_diff, resize_diff.size());
     Mat draw_diff = canvas(Rect(3 * DRAW_CELL_DIM, 0, DRAW_CELL_DIM, DRAW_CELL_DIM));
     cv::cvtColor(resize_diff, draw_diff, cv::COLOR_GRAY2BGR);
 
     /// Draw current sphere view.
-    static Mat resize_view(DRAW_CELL_DIM, 2 * DRAW_CELL_DIM, CV_8UC1);
+    Mat& resize_view = _draw.resize_view;
+    resize_view.create(DRAW_CELL_DIM, 2 * DRAW_CELL_DIM, CV_8UC1);
     cv::resize(sphere_view, resize_view, resize_view.size());
     Mat draw_view = canvas(Rect(2 * DRAW_CELL_DIM, 1 * DRAW_CELL_DIM, 2 * DRAW_CELL_DIM, DRAW_CELL_DIM));
     cv::cvtColor(resize_view, draw_view, cv::COLOR_GRAY2BGR);
 
     /// Draw current sphere map.
-    static Mat resize_map(DRAW_CELL_DIM, 2 * DRAW_CELL_DIM, CV_8UC1);
+    Mat& resize_map = _draw.resize_map;
+    resize_map.create(DRAW_CELL_DIM, 2 * DRAW_CELL_DIM, CV_8UC1);
     cv::resize(sphere_map, resize_map, resize_map.size());
     Mat draw_map = canvas(Rect(2 * DRAW_CELL_DIM, 2 * DRAW_CELL_DIM, 2 * DRAW_CELL_DIM, DRAW_CELL_DIM));
     cv::cvtColor(resize_map, draw_map, cv::COLOR_GRAY2BGR);
@@ -1436,8 +2196,19 @@ void Trackball::drawCanvas(shared_ptr<DrawData> data)
         255, 255, 0);
 
     /// Display
-    cv::imshow("FicTrac-debug", canvas);
-    uint16_t key = cv::waitKey(1);
+    uint16_t key;
+    {
+        lock_guard<mutex> l(display_mutex);
+        cv::imshow(_window_name, canvas);
+        key = cv::waitKey(1);
+        if ((display_rigs > 1) && ((key == 0x1B) || (key == 0x52))) {
+            if (!display_keys_warned) {
+                LOG_WRN("Warning! Keyboard shortcuts are disabled while several rigs are displayed (use ctrl-c to stop all rigs).");
+                display_keys_warned = true;
+            }
+            key = 0;
+        }
+    }
     if (key == 0x1B) {  // esc
         LOG("Exiting");
         terminate();
@@ -1448,7 +2219,7 @@ void Trackball::drawCanvas(shared_ptr<DrawData> data)
     }
 
     if (_save_raw) {
-        _raw_vid.write(src_frame);
+        _raw_vid.write(src_bgr);
     }
     if (_save_debug) {
         _debug_vid.write(canvas);
@@ -1490,7 +2261,7 @@ bool Trackball::writeTemplate(std::string fn)
 {
     if (!_init) { return false; }
     
-    string template_fn = _base_fn + "-template.png";
+    string template_fn = fn.empty() ? (_base_fn + "-template.png") : fn;
 
     bool ret = cv::imwrite(template_fn, _sphere_map);
     if (!ret) {
@@ -0,0 +1,94 @@
+/// FicTrac http://rjdmoore.net/fictrac/
+/// \file       Tracker.cpp
+/// \brief      Embeddable tracker (libfictrac): frames are pushed in by the caller and tracked in-process.
+/// \author     Richard Moore
+/// \copyright  CC BY-NC-SA 3.0
+
+#include "Tracker.h"
+
+#include "Trackball.h"
+#include "Logger.h"
+
+using namespace std;
+
+///
+///
+///
+Tracker::Tracker(const map<string, string>& cfg, int width, int height)
+    : _width(width), _height(height)
+{
+    /// Log to the console (or the caller's sink), without a log file or writer thread.
+    if (!Logger::direct()) { Logger::setDirect(); }
+
+    _tracker = make_unique<Trackball>(cfg, width, height);
+}
+
+///
+///
+///
+Tracker::~Tracker()
+{}
+
+///
+///
+///
+void Tracker::setLogSink(LogSink sink)
+{
+    if (!sink) {
+        Logger::setDirect();
+        return;
+    }
+    Logger::setDirect([sink](Logger::LogLevel lvl, const char* msg) { sink(static_cast<int>(lvl), msg); });
+}
+
+///
+///
+///
+bool Tracker::isOpen() const
+{
+    return _tracker->isActive();
+}
+
+///
+///
+///
+bool Tracker::track(const uint8_t* data, size_t stride, PIXEL_FORMAT fmt, double ts, DataRecord& rec)
+{
+    if (!data || !isOpen()) { return false; }
+
+    /// Wrap the caller's buffer (no copy).
+    cv::Mat frame(_height, _width, (fmt == PIXEL_BGR8) ? CV_8UC3 : CV_8UC1, const_cast<uint8_t*>(data), stride);
+    if (!_tracker->track(frame, fmt, ts, rec)) { return false; }
+
+    if (_cb) { _cb(rec); }
+    return true;
+}
+
+///
+///
+///
+bool Tracker::track(const uint8_t* data, size_t stride, PIXEL_FORMAT fmt, double ts)
+{
+    DataRecord rec;
+    return track(data, stride, fmt, ts, rec);
+}
+
+///
+///
+///
+void Tracker::reset()
+{
+    _tracker->requestReset();
+}
+
+///
+///
+///
+bool Tracker::writeTemplate(const string& fn)
+{
+    if (fn.empty()) {
+        LOG_ERR("Error! No sphere template file name given.");
+        return false;
+    }
+    return _tracker->writeTemplate(fn);
+}
@@ -88,7 +88,7 @@ void drawCircle_camModel(Mat& img, const CameraModelPtr cam_model, const CmPoint
 ///
 void histStretch(Mat& grey)
 {
-	static int hist[256];
+	int hist[256];
 	memset(hist, 0, 256*sizeof(int));
     
     /// Construct histogram.
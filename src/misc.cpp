@@ -10,11 +10,15 @@
 
 #ifdef __linux__ 
 // linux inludes
+#include <sys/resource.h>   // getrusage
+#include <pthread.h>        // pthread_setaffinity_np
+#include <sched.h>          // cpu_set_t
 #elif _WIN32
 #include <windows.h>
+#include <psapi.h>          // GetProcessMemoryInfo
 #endif
 
-
+#include <algorithm>
 #include <cstdio>
 
 ///
@@ -83,3 +87,89 @@ bool SetThreadNormalPriority()
     return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
 #endif
 }
+
+///
+/// Pin thread to the given logical CPUs. Fails if any of them can't be used by this process.
+///
+bool SetThreadAffinity(std::thread& thread, const std::vector<int>& cpus)
+{
+    if (cpus.empty()) { return false; }
+#ifdef __linux__ 
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if ((cpu < 0) || (cpu >= CPU_SETSIZE)) { return false; }
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#elif _WIN32
+    /// Only the first 64 CPUs (processor group 0) can be selected.
+    /// See https://docs.microsoft.com/en-us/windows/win32/procthread/processor-groups
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus) {
+        if ((cpu < 0) || (cpu >= static_cast<int>(8 * sizeof(mask)))) { return false; }
+        mask |= static_cast<DWORD_PTR>(1) << cpu;
+    }
+    return SetThreadAffinityMask(thread.native_handle(), mask) != 0;
+#endif
+}
+
+///
+/// Logical CPUs this process may run on (e.g. as restricted by taskset or a cgroup cpuset).
+///
+std::vector<int> GetProcessCpus()
+{
+    std::vector<int> cpus;
+#ifdef __linux__ 
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) { return cpus; }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) { cpus.push_back(cpu); }
+    }
+#elif _WIN32
+    DWORD_PTR proc_mask = 0, sys_mask = 0;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &proc_mask, &sys_mask)) { return cpus; }
+    for (int cpu = 0; cpu < static_cast<int>(8 * sizeof(proc_mask)); cpu++) {
+        if (proc_mask & (static_cast<DWORD_PTR>(1) << cpu)) { cpus.push_back(cpu); }
+    }
+#endif
+    return cpus;
+}
+
+///
+/// Compact CPU list string, with consecutive CPUs as ranges (e.g. "0-3,6").
+///
+std::string CpuListStr(const std::vector<int>& cpus)
+{
+    std::vector<int> sorted(cpus);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    std::string str;
+    for (size_t i = 0; i < sorted.size(); ) {
+        size_t j = i;
+        while ((j + 1 < sorted.size()) && (sorted[j + 1] == sorted[j] + 1)) { j++; }
+        if (!str.empty()) { str += ","; }
+        str += std::to_string(sorted[i]);
+        if (j > i) { str += "-" + std::to_string(sorted[j]); }
+        i = j + 1;
+    }
+    return str;
+}
+
+///
+/// Peak resident set size of this process (bytes).
+///
+size_t GetPeakRSS()
+{
+#ifdef __linux__ 
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) { return 0; }
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;     // ru_maxrss is in kB
+#elif _WIN32
+    PROCESS_MEMORY_COUNTERS info;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &info, sizeof(info))) { return 0; }
+    return static_cast<size_t>(info.PeakWorkingSetSize);
+#endif
+}